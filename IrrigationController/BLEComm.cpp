@@ -43,7 +43,8 @@ class MyCharacteristicCallbacks : public BLECharacteristicCallbacks {
     
     // Check if it's a simple command: <node> <command>
     int space = payload.indexOf(' ');
-    if (space > 0 && !payload.startsWith("SCH|") && !payload.startsWith("{")) {
+    if (space > 0 && !payload.startsWith("SCH|") && !payload.startsWith("{") &&
+        !payload.startsWith("NODE")) {
       // It's a simple command like "1 PING"
       int node = payload.substring(0, space).toInt();
       String cmd = payload.substring(space + 1);
@@ -30,6 +30,7 @@
 
 // ========== Buffer Sizes ==========
 #define LORA_BUFFER_SIZE 256
+#define LORA_RX_RING_SLOTS 8          // Packets buffered between processIncoming() passes
 #define INCOMING_QUEUE_SIZE 10
 
 // ========== Pin Definitions ==========
@@ -80,6 +81,155 @@
 #define LORA_MAX_RETRIES 3
 #define ACK_TIMEOUT_MS 5000
 #define LORA_ACK_TIMEOUT_MS 5000
+#define LORA_TX_TIMEOUT_MS 3000       // Give up on a TxDone that never arrives
+
+// Radio health: a radio that stops raising interrupts (stuck IRQ, brown-out)
+// is re-initialised when it looks wedged
+#define LORA_HEALTH_RADIO_FAULTS 2          // TxDone/CadDone missed in a row
+#define LORA_HEALTH_ACK_TIMEOUTS 8          // ACK timeouts in a row (any nodes) with nothing received
+#define LORA_HEALTH_RX_SILENCE_MS 1800000   // Nothing received this long, once anything was
+#define LORA_HEALTH_MIN_GAP_MS 60000        // Between recoveries; doubles while nothing is heard
+#define LORA_HEALTH_MAX_GAP_MS 3600000
+
+// Channel plan (Hz). Node N is served on channel N % LORA_CHANNEL_COUNT - the
+// node firmware applies the same rule to the same table. Uplinks that aren't
+// replies (STAT, AUTO_CLOSE) always go out on the home channel, where the
+// gateway listens when it has nothing in flight. Channels are >= 350 kHz
+// apart so 125 kHz signals don't overlap.
+#define LORA_CHANNEL_COUNT 5
+#define LORA_CHANNEL_PLAN { RF_FREQUENCY, 865402500UL, 865985000UL, 866350000UL, 866750000UL }
+#define LORA_HOME_CHANNEL 0
+
+// Listen-before-talk: channel activity detection before every transmission,
+// binary exponential backoff with jitter after busy channels and timeouts
+#define LORA_CAD_ENABLED 1
+#define LORA_CAD_TIMEOUT_MS 50        // CadDone backstop (CAD itself takes ~2 symbols)
+#define LORA_CAD_MAX_DEFERRALS 5      // Transmit anyway after this many busy checks
+#define LORA_BACKOFF_BASE_MS 300      // First backoff window
+#define LORA_BACKOFF_MAX_MS 5000      // Backoff window cap
+
+// Airtime budget (token bucket refilled continuously at the hourly rate)
+// Lower-priority traffic must leave a reserve in the bucket for schedule steps
+#define LORA_AIRTIME_BUDGET_MS_PER_HOUR 360000  // 10% duty cycle
+#define LORA_AIRTIME_BURST_MS 60000             // Bucket capacity
+#define LORA_AIRTIME_OPERATOR_RESERVE_MS 10000  // Operator sends leave this much
+#define LORA_AIRTIME_DIAG_RESERVE_MS 30000      // Diagnostics leave this much
+#define LORA_AIRTIME_BULK_RESERVE_MS 40000      // Firmware fragments leave this much
+
+// Radio arbitration: strict priority by class, re-decided whenever an
+// attempt ends. An operator or diagnostic command waiting this long moves
+// up one class, so scheduler retries can't starve operator commands.
+#define LORA_PRIO_AGING_MS 20000
+
+// Adaptive data rate: per-node SF/TX power picked from uplink SNR history.
+// Nodes boot on LORA_SPREADING_FACTOR/TX_OUTPUT_POWER and must return there
+// on their own after losing contact; the gateway does the same after
+// LORA_ADR_FALLBACK_TIMEOUTS consecutive ACK timeouts. ACKs come back on the
+// node's own data rate; unsolicited uplinks (STAT, AUTO_CLOSE) stay on the default.
+#define LORA_ADR_ENABLED 1
+#define LORA_ADR_MIN_SF 7
+#define LORA_ADR_MAX_SF 12
+#define LORA_ADR_MIN_POWER 2          // dBm
+#define LORA_ADR_MARGIN_DB 10         // SNR kept above the demodulation floor
+#define LORA_ADR_HOLD_MS 600000       // Minimum time between changes per node
+#define LORA_ADR_FALLBACK_TIMEOUTS 2
+#define LORA_LINK_HISTORY 8           // SNR/RSSI samples per node (ADR needs a full window)
+#define LORA_LINK_BINS 8              // Histogram bins: SNR 5 dB wide, RSSI 10 dB wide
+
+// TDMA uplinks: the gateway broadcasts a beacon (time + slot map) on the home
+// channel every LORA_BEACON_INTERVAL_MS. A node with a slot sends its STAT in
+// it, counted from the end of the beacon; the rest of the superframe is the
+// command window. Diagnostic and bulk traffic doesn't start inside the slot
+// window; schedule and operator commands do. A slot whose owner stays silent
+// for LORA_TDMA_RELEASE_MISSES superframes goes back to the free pool.
+#define LORA_BEACON_ENABLED 1
+#define LORA_BEACON_INTERVAL_MS 120000
+#define LORA_TDMA_FIRST_SLOT_MS 2000  // Slot 0 starts this long after the beacon
+#define LORA_TDMA_SLOT_MS 1000        // One SF10 STAT (~400 ms) plus guard time
+#define LORA_TDMA_SLOTS 64
+#define LORA_TDMA_RELEASE_MISSES 5
+
+// Uplink duplicate suppression: a node's retransmitted STAT/AUTO_CLOSE is
+// dropped if the same (node, SEQ/MID or payload hash) was seen within the window
+#define LORA_DUP_CACHE_SLOTS 32
+#define LORA_DUP_WINDOW_MS 60000
+
+// Binary frames (LoRaFrame.h) go to nodes that have sent one or put "F=B" in
+// an ASCII frame; everyone else keeps getting the ASCII format
+#define LORA_BINARY_FRAMES 1
+
+// Relay forwarding for nodes out of direct range. The gateway routes through
+// a designated relay when the direct link is weak, stale or failing; the
+// relay reports the RSSI it heard the node at, which picks the best relay.
+#define LORA_RELAY_ENABLED 1
+#define LORA_RELAY_NODES ""                // Relay node IDs, e.g. "7,12"
+#define LORA_ROUTE_DIRECT_MIN_RSSI -120    // dBm, weaker direct links use a relay
+#define LORA_ROUTE_STALE_MS 3600000        // Direct link unheard this long counts as lost
+#define LORA_ROUTE_FAILS 2                 // Timeouts before giving up on a path
+
+// Sleepy (battery) nodes only listen for a short window after each uplink.
+// Commands wait in their mailbox and go out in the window after the node's
+// next frame; a node can also announce itself with "RXW=<ms>" in a STAT.
+#define LORA_SLEEPY_NODES ""               // Sleepy node IDs, e.g. "5,9"
+#define LORA_SLEEPY_RX_DELAY_MS 0          // Window opens this long after the uplink
+#define LORA_SLEEPY_RX_WINDOW_MS 2000      // Default window length
+#define LORA_SLEEPY_DEADLINE_MS 3600000    // Mailbox commands expire after this
+#define LORA_SLEEPY_PLAN_AHEAD_MS 3600000  // Schedule steps are mailed this early
+
+// Per-node retransmit timeout (Jacobson/Karels RTT estimation)
+// LORA_ACK_TIMEOUT_MS is used until a node has its first RTT sample
+#define LORA_MAX_NODES 256            // Node IDs index per-node tables directly
+#define LORA_RTO_MIN_MS 500           // ACK airtime + node turnaround floor
+#define LORA_RTO_MAX_MS 10000
+
+// Transaction table (commands in flight, keyed by MID)
+#define LORA_MAX_TXNS 24              // Enough for a CLOSE sweep over a full sequence
+#define LORA_TXN_TYPE_LEN 21          // cmdType up to 20 chars
+#define LORA_TXN_SCHED_LEN 51         // schedId up to 50 chars
+#define LORA_TXN_MAX_REQUESTERS 4     // Callers sharing one coalesced command
+#define MANUAL_CMD_SLOTS 8            // Serial/BLE/SMS commands awaiting a LoRa result
+#define LORA_MAX_GROUPS 4             // Group commands in flight (one per channel/SF)
+#define LORA_GROUP_SLOT_GUARD_MS 60   // Added to the ACK airtime for each reply slot
+#define MSG_ID_BLOCK_SIZE 256         // MIDs reserved per NVS write
+
+// Packet capture (LoRaCapture.h) - off at boot, CAPTURE FILE|SERIAL|OFF|CLEAR
+// on the console. "CAP|<hex>" lines typed or pasted on the console are appended
+// to the file, so a serial capture from another gateway can be loaded.
+// REPLAY runs the file back through the RX path.
+#define LORA_CAPTURE_PATH "/lora.cap"
+#define LORA_CAPTURE_MAX_BYTES 262144 // Capture stops when the file reaches this
+#define LORA_REPLAY_TX_RING 16        // Replayed commands kept for ACK matching
+
+// ========== Firmware Update over LoRa (FUOTA) ==========
+// Images on LittleFS are multicast per channel/SF to the target nodes as
+// bulk-class fragments with one XOR parity fragment per FEC span, then each
+// node is queried for what it still misses and only those gaps are resent
+#define LORA_FUOTA_FRAG_SIZE 128      // Payload bytes per fragment
+#define LORA_FUOTA_FEC_SPAN 8         // Data fragments per parity fragment
+#define LORA_FUOTA_MAX_FRAGS 4096     // Largest image: 512 KB at 128 B
+#define LORA_FUOTA_SETUP_REPEATS 3    // SETUP/END are sent this many times
+#define LORA_FUOTA_REPLY_MS 1500      // Listen window after a QUERY
+#define LORA_FUOTA_QUERY_TRIES 3      // Unanswered QUERYs before a node fails
+#define LORA_FUOTA_MAX_ROUNDS 5       // Repair rounds before remaining nodes fail
+
+// ========== Node Registry ==========
+// Every frame heard from a node refreshes its entry; only nodes that have been
+// quiet get a diagnostic PING, backing off while they stay silent
+#define NODE_POLL_QUIET_MS 900000     // Quiet time before the first PING (15 min)
+#define NODE_POLL_MAX_MS 3600000      // Backoff ceiling between PINGs (1 h)
+#define NODE_DOWN_POLLS 3             // Unanswered PINGs before a node is down
+#define NODE_POLL_CHECK_MS 5000       // How often the registry looks for due polls
+
+// JOIN: a node without an address sends "JOIN|HW=<hex ID>,VC=<valves>,SEN=<a;b>"
+// on the home channel and gets "JACC|HW=..,N=<address>,G=<gateway>" back.
+// The offer becomes its address once the node talks with it (a STAT right
+// after joining); the mapping is kept on LittleFS, so a node that joins
+// again gets the same address.
+#define NODE_JOIN_ADDR_MIN 1          // Address pool - gateways with overlapping
+#define NODE_JOIN_ADDR_MAX 254        //   coverage get ranges of their own
+#define NODE_JOIN_OFFER_MS 600000     // An unused offer returns to the pool after this
+#define NODE_JOIN_REUSE_MS 604800000  // With the pool full, a joined node silent this long gives up its address
+#define NODE_JOIN_PATH "/nodes.csv"
 
 // ========== WiFi Settings ==========
 #define WIFI_SSID "sekarfarm"
@@ -114,6 +264,12 @@
 // ========== Modem Settings ==========
 #define MODEM_APN "airtelgprs.com"
 #define DEFAULT_SIM_APN MODEM_APN
+#define MODEM_AT_QUEUE_SLOTS 8        // AT commands waiting behind the one in flight
+#define MODEM_AT_LINE_MAX 1024        // Longest response line kept (+QMTRECV payloads)
+#define MODEM_AT_GUARD_MS 1000        // After a timeout, late results are dropped this long
+#define MODEM_RESTART_SETTLE_MS 6000  // Reconfigure no sooner than this after RDY
+#define MODEM_CFG_PAUSE_MS 500        // Between closing old MQTT state and the next step
+#define MQTT_PUBLISH_BACKLOG 64       // Publishes waiting for an AT queue slot
 
 // ========== SMS Settings ==========
 #define SMS_ALERT_PHONE_1 "+919944272647"
@@ -156,6 +312,7 @@
 #define PUMP_OFF_DELAY_DEFAULT_MS 3000
 #define LAST_CLOSE_DELAY_MS_DEFAULT 2000
 #define VALVE_OPEN_DELAY_MS 500
+#define NODE_MAX_VALVES 4             // Valves per node (STAT V1..V4), 1-8
 #define SAVE_PROGRESS_INTERVAL_MS 60000  // Save schedule progress every 60 seconds
 
 // ========== System Settings ==========
@@ -0,0 +1,372 @@
+// FuotaManager.cpp
+#include "FuotaManager.h"
+
+extern void publishStatus(const String &msg);
+
+FuotaManager::FuotaManager() : phase(FUOTA_IDLE), imageSize(0), imageCrc(0), fragCount(0),
+                               parityCount(0), session(0), channel(0), sf(0), power(0),
+                               cursor(0), round(0), queryNode(0), queryFrom(0), queryTries(0),
+                               queryAnswered(false), fragmentsSent(0), repairsSent(0), startedAt(0) {
+  memset(nodeState, 0, sizeof(nodeState));
+  memset(missing, 0, sizeof(missing));
+}
+
+// ========== Start / Abort ==========
+bool FuotaManager::start(const String &path, const uint8_t *nodes, int count) {
+  if (phase != FUOTA_IDLE) {
+    Serial.println("[FUOTA] ❌ Update already running");
+    return false;
+  }
+
+  image = LittleFS.open(path, "r");
+  if (!image) {
+    Serial.println("[FUOTA] ❌ Cannot open " + path);
+    return false;
+  }
+  imageSize = image.size();
+  uint32_t frags = (imageSize + LORA_FUOTA_FRAG_SIZE - 1) / LORA_FUOTA_FRAG_SIZE;
+  if (imageSize == 0 || frags > LORA_FUOTA_MAX_FRAGS) {
+    Serial.printf("[FUOTA] ❌ Image size %u not supported\n", imageSize);
+    image.close();
+    return false;
+  }
+  fragCount = (uint16_t)frags;
+  parityCount = (fragCount + LORA_FUOTA_FEC_SPAN - 1) / LORA_FUOTA_FEC_SPAN;
+
+  // Nodes check the whole image against this before applying it
+  uint8_t buf[LORA_FUOTA_FRAG_SIZE];
+  size_t n;
+  imageCrc = 0;
+  image.seek(0);
+  while ((n = image.read(buf, sizeof(buf))) > 0) {
+    imageCrc = loraCrc32(imageCrc, buf, n);
+  }
+
+  memset(nodeState, 0, sizeof(nodeState));
+  int targets = 0;
+  for (int i = 0; i < count; i++) {
+    uint8_t node = nodes[i];
+    if (node == 0 || nodeState[node] != FUOTA_NODE_NONE) continue;
+    if (!loraComm.nodeBinary(node)) {
+      Serial.printf("[FUOTA] ⚠ Node %u hasn't sent a binary frame yet, skipped\n", node);
+      continue;
+    }
+    nodeState[node] = FUOTA_NODE_PENDING;
+    targets++;
+  }
+  if (targets == 0) {
+    Serial.println("[FUOTA] ❌ No target nodes");
+    image.close();
+    return false;
+  }
+
+  imagePath = path;
+  fragmentsSent = 0;
+  repairsSent = 0;
+  startedAt = millis();
+  loraComm.setUplinkHandler(onStatus, this);
+  Serial.printf("[FUOTA] %s: %u bytes, %u fragments + %u parity, CRC %08X, %d nodes\n",
+                path.c_str(), imageSize, fragCount, parityCount, imageCrc, targets);
+  return startSession();
+}
+
+void FuotaManager::abort() {
+  if (phase == FUOTA_IDLE) return;
+  Serial.println("[FUOTA] Update aborted");
+  image.close();
+  loraComm.setUplinkHandler(nullptr, nullptr);
+  phase = FUOTA_IDLE;
+}
+
+bool FuotaManager::isRunning() {
+  return phase != FUOTA_IDLE;
+}
+
+// Next session: every pending node on the first pending node's channel/SF
+bool FuotaManager::startSession() {
+  int first = 0;
+  for (int n = 1; n < LORA_MAX_NODES && first == 0; n++) {
+    if (nodeState[n] == FUOTA_NODE_PENDING) first = n;
+  }
+  if (first == 0) return false;
+
+  loraComm.nodeProfile(first, channel, sf, power);
+  int members = 0;
+  for (int n = first; n < LORA_MAX_NODES; n++) {
+    if (nodeState[n] != FUOTA_NODE_PENDING) continue;
+    uint8_t ch, nodeSf;
+    int8_t nodePower;
+    loraComm.nodeProfile(n, ch, nodeSf, nodePower);
+    if (ch != channel || nodeSf != sf) continue;
+    if (nodePower > power) power = nodePower;
+    nodeState[n] = FUOTA_NODE_ACTIVE;
+    members++;
+  }
+
+  session = (session == 0xFF) ? 1 : session + 1;
+  memset(missing, 0, sizeof(missing));
+  cursor = 0;
+  round = 0;
+  phase = FUOTA_SETUP;
+  Serial.printf("[FUOTA] Session %u: %d nodes on ch%u SF%u\n", session, members, channel, sf);
+  return true;
+}
+
+void FuotaManager::finishSession() {
+  if (startSession()) return;
+  finish();
+}
+
+void FuotaManager::finish() {
+  int done = 0, failed = 0;
+  for (int n = 1; n < LORA_MAX_NODES; n++) {
+    if (nodeState[n] == FUOTA_NODE_DONE) done++;
+    else if (nodeState[n] == FUOTA_NODE_FAILED) failed++;
+  }
+  image.close();
+  loraComm.setUplinkHandler(nullptr, nullptr);
+  phase = FUOTA_IDLE;
+
+  Serial.printf("[FUOTA] ✓ Finished in %lu min: %d updated, %d failed, %u fragments + %u repairs\n",
+                (millis() - startedAt) / 60000UL, done, failed, fragmentsSent, repairsSent);
+  publishStatus("EVT|FUOTA|OK=" + String(done) + "|FAIL=" + String(failed));
+}
+
+// ========== Fragments ==========
+// Data fragment, or the XOR of its span for parity indexes
+bool FuotaManager::readFragment(uint16_t index, uint8_t *out, size_t &len) {
+  if (index < fragCount) {
+    uint32_t offset = (uint32_t)index * LORA_FUOTA_FRAG_SIZE;
+    len = imageSize - offset;
+    if (len > LORA_FUOTA_FRAG_SIZE) len = LORA_FUOTA_FRAG_SIZE;
+    return image.seek(offset) && image.read(out, len) == len;
+  }
+
+  uint16_t first = (uint16_t)(index - fragCount) * LORA_FUOTA_FEC_SPAN;
+  uint8_t data[LORA_FUOTA_FRAG_SIZE];
+  memset(out, 0, LORA_FUOTA_FRAG_SIZE);
+  len = LORA_FUOTA_FRAG_SIZE;
+  for (uint16_t i = first; i < first + LORA_FUOTA_FEC_SPAN && i < fragCount; i++) {
+    size_t dataLen;
+    if (!readFragment(i, data, dataLen)) return false;
+    for (size_t b = 0; b < dataLen; b++) out[b] ^= data[b];
+  }
+  return true;
+}
+
+bool FuotaManager::sendFragment(uint16_t index) {
+  uint8_t payload[LORA_FUOTA_FRAG_SIZE];
+  size_t payloadLen;
+  if (!readFragment(index, payload, payloadLen)) {
+    Serial.printf("[FUOTA] ❌ Image read failed at fragment %u\n", index);
+    abort();
+    return false;
+  }
+
+  uint8_t frame[LORA_BUFFER_SIZE];
+  size_t len = loraFragEncode(frame, sizeof(frame), session, index, payload, payloadLen);
+  return len > 0 && loraComm.sendBulk(frame, (uint16_t)len, channel, sf, power);
+}
+
+// ========== Main Loop ==========
+// Hands LoRaComm one bulk frame at a time; it goes out when the radio and
+// the airtime budget allow
+void FuotaManager::loop() {
+  if (phase == FUOTA_IDLE) return;
+  if (phase == FUOTA_QUERY) {
+    runQuery();
+    return;
+  }
+  if (!loraComm.bulkIdle()) return;
+
+  uint8_t frame[LORA_BUFFER_SIZE];
+  size_t len;
+
+  switch (phase) {
+    case FUOTA_SETUP: {
+      if (cursor >= LORA_FUOTA_SETUP_REPEATS) {
+        cursor = 0;
+        phase = FUOTA_SEND;
+        return;
+      }
+      int first = -1, last = -1;
+      for (int n = 1; n < LORA_MAX_NODES; n++) {
+        if (nodeState[n] != FUOTA_NODE_ACTIVE) continue;
+        if (first < 0) first = n;
+        last = n;
+      }
+      uint8_t bitmap[LORA_GROUP_MAX_BITMAP];
+      memset(bitmap, 0, sizeof(bitmap));
+      for (int n = first; n <= last; n++) {
+        if (nodeState[n] == FUOTA_NODE_ACTIVE) bitmap[(n - first) / 8] |= 1 << ((n - first) % 8);
+      }
+
+      LoRaFuotaSetup s;
+      s.session = session;
+      s.imageSize = imageSize;
+      s.imageCrc = imageCrc;
+      s.fragSize = LORA_FUOTA_FRAG_SIZE;
+      s.fragCount = fragCount;
+      s.fecSpan = LORA_FUOTA_FEC_SPAN;
+      s.base = (uint8_t)first;
+      s.bitmapLen = (uint8_t)((last - first) / 8 + 1);
+      s.bitmap = bitmap;
+      len = loraFuotaSetupEncode(frame, sizeof(frame), s);
+      if (len > 0 && loraComm.sendBulk(frame, (uint16_t)len, channel, sf, power)) cursor++;
+      return;
+    }
+
+    case FUOTA_SEND:
+      if (cursor >= fragCount + parityCount) {
+        Serial.printf("[FUOTA] Session %u: all fragments sent, querying nodes\n", session);
+        nextQueryNode(0);
+        phase = FUOTA_QUERY;
+        return;
+      }
+      if (sendFragment(cursor)) {
+        cursor++;
+        fragmentsSent++;
+      }
+      return;
+
+    case FUOTA_REPAIR:
+      while (cursor < fragCount && !(missing[cursor / 8] & (1 << (cursor % 8)))) cursor++;
+      if (cursor >= fragCount) {
+        memset(missing, 0, sizeof(missing));
+        nextQueryNode(0);
+        phase = FUOTA_QUERY;
+        return;
+      }
+      if (sendFragment(cursor)) {
+        cursor++;
+        repairsSent++;
+      }
+      return;
+
+    case FUOTA_END:
+      if (cursor >= LORA_FUOTA_SETUP_REPEATS) {
+        finishSession();
+        return;
+      }
+      len = loraFuotaEndEncode(frame, sizeof(frame), session, imageCrc);
+      if (len > 0 && loraComm.sendBulk(frame, (uint16_t)len, channel, sf, power)) cursor++;
+      return;
+
+    default:
+      return;
+  }
+}
+
+// ========== Missing-Fragment Collection ==========
+void FuotaManager::nextQueryNode(int after) {
+  queryNode = 0;
+  for (int n = after + 1; n < LORA_MAX_NODES; n++) {
+    if (nodeState[n] == FUOTA_NODE_ACTIVE) {
+      queryNode = n;
+      break;
+    }
+  }
+  queryFrom = 0;
+  queryTries = 0;
+  queryAnswered = false;
+}
+
+// One QUERY per node and reply window; once every node has answered,
+// repair the union of the gaps or finish the session
+void FuotaManager::runQuery() {
+  if (queryNode == 0) {
+    bool gaps = false;
+    for (size_t i = 0; i < sizeof(missing) && !gaps; i++) gaps = missing[i] != 0;
+
+    if (gaps && ++round > LORA_FUOTA_MAX_ROUNDS) {
+      for (int n = 1; n < LORA_MAX_NODES; n++) {
+        if (nodeState[n] != FUOTA_NODE_ACTIVE) continue;
+        nodeState[n] = FUOTA_NODE_FAILED;
+        Serial.printf("[FUOTA] ✗ Node %d still incomplete after %d rounds\n", n, LORA_FUOTA_MAX_ROUNDS);
+      }
+      gaps = false;
+    }
+    cursor = 0;
+    if (gaps) {
+      Serial.printf("[FUOTA] Session %u: repair round %u\n", session, round);
+      phase = FUOTA_REPAIR;
+    } else {
+      phase = FUOTA_END;
+    }
+    return;
+  }
+
+  if (!loraComm.bulkIdle()) return;  // QUERY queued or reply window open
+
+  if (queryTries >= LORA_FUOTA_QUERY_TRIES && !queryAnswered) {
+    Serial.printf("[FUOTA] ✗ Node %d not answering\n", queryNode);
+    nodeState[queryNode] = FUOTA_NODE_FAILED;
+    nextQueryNode(queryNode);
+    return;
+  }
+
+  uint8_t frame[LORA_BUFFER_SIZE];
+  size_t len = loraFuotaQueryEncode(frame, sizeof(frame), session, (uint8_t)queryNode, queryFrom);
+  if (len > 0 && loraComm.sendBulk(frame, (uint16_t)len, channel, sf, power, LORA_FUOTA_REPLY_MS)) {
+    queryTries++;
+    queryAnswered = false;
+  }
+}
+
+void FuotaManager::onStatus(const uint8_t *frame, uint16_t len, int16_t rssi, void *ctx) {
+  FuotaManager *self = (FuotaManager *)ctx;
+  LoRaFuotaStatus st;
+  if (!loraFuotaStatusDecode(frame, len, st)) return;
+  if (self->phase != FUOTA_QUERY || st.session != self->session || st.node != self->queryNode) return;
+
+  if (st.missing == 0) {
+    Serial.printf("[FUOTA] ✓ Node %u has the complete image\n", st.node);
+    self->nodeState[st.node] = FUOTA_NODE_DONE;
+    self->nextQueryNode(st.node);
+    return;
+  }
+
+  uint16_t inWindow = 0;
+  uint32_t end = st.start;
+  for (int i = 0; i < st.bitmapLen * 8; i++) {
+    uint32_t idx = (uint32_t)st.start + i;
+    if (idx >= self->fragCount) break;
+    end = idx + 1;
+    if (st.bitmap[i / 8] & (1 << (i % 8))) {
+      self->missing[idx / 8] |= 1 << (idx % 8);
+      inWindow++;
+    }
+  }
+  Serial.printf("[FUOTA] Node %u misses %u fragments\n", st.node, st.missing);
+
+  // Bitmap didn't cover everything - ask for the next window
+  if (inWindow < st.missing && end < self->fragCount) {
+    self->queryFrom = (uint16_t)end;
+    self->queryTries = 0;
+    self->queryAnswered = true;
+    return;
+  }
+  self->nextQueryNode(st.node);
+}
+
+// ========== Reporting ==========
+String FuotaManager::report() {
+  if (phase == FUOTA_IDLE) return "idle";
+
+  static const char *const names[] = { "idle", "setup", "send", "query", "repair", "end" };
+  int active = 0, pending = 0, done = 0, failed = 0;
+  for (int n = 1; n < LORA_MAX_NODES; n++) {
+    switch (nodeState[n]) {
+      case FUOTA_NODE_ACTIVE: active++; break;
+      case FUOTA_NODE_PENDING: pending++; break;
+      case FUOTA_NODE_DONE: done++; break;
+      case FUOTA_NODE_FAILED: failed++; break;
+      default: break;
+    }
+  }
+  return imagePath + " " + names[phase] + " session=" + String(session) +
+         " round=" + String(round) + " frags=" + String(fragmentsSent) + "/" +
+         String(fragCount + parityCount) + " repairs=" + String(repairsSent) +
+         " nodes active/pending/done/failed=" + String(active) + "/" + String(pending) + "/" +
+         String(done) + "/" + String(failed) + " elapsed=" + String((millis() - startedAt) / 1000) + "s";
+}
\ No newline at end of file
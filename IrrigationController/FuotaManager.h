@@ -0,0 +1,77 @@
+// FuotaManager.h - Firmware update distribution to nodes over LoRa
+#ifndef FUOTA_MANAGER_H
+#define FUOTA_MANAGER_H
+
+#include "Config.h"
+#include "LoRaComm.h"
+#include <LittleFS.h>
+
+// One session covers the target nodes sharing a channel/SF; sessions run
+// back to back until every target is done or failed
+enum FuotaPhase {
+  FUOTA_IDLE,
+  FUOTA_SETUP,       // Announcing the session to its nodes
+  FUOTA_SEND,        // Multicasting data and parity fragments
+  FUOTA_QUERY,       // Collecting missing-fragment bitmaps node by node
+  FUOTA_REPAIR,      // Resending fragments some node still misses
+  FUOTA_END          // Telling the nodes to verify and apply
+};
+
+enum FuotaNodeState {
+  FUOTA_NODE_NONE,
+  FUOTA_NODE_PENDING,    // Waiting for its channel/SF session
+  FUOTA_NODE_ACTIVE,     // In the current session
+  FUOTA_NODE_DONE,
+  FUOTA_NODE_FAILED
+};
+
+class FuotaManager {
+private:
+  FuotaPhase phase;
+  File image;
+  String imagePath;
+  uint32_t imageSize;
+  uint32_t imageCrc;
+  uint16_t fragCount;        // Data fragments
+  uint16_t parityCount;
+  uint8_t session;
+
+  uint8_t nodeState[LORA_MAX_NODES];
+  uint8_t channel;           // Profile of the current session
+  uint8_t sf;
+  int8_t power;
+
+  uint16_t cursor;           // Next fragment (SEND/REPAIR) or repeat count (SETUP/END)
+  uint8_t round;
+  uint8_t missing[LORA_FUOTA_MAX_FRAGS / 8];  // Union of what queried nodes miss
+
+  int queryNode;
+  uint16_t queryFrom;
+  uint8_t queryTries;
+  bool queryAnswered;
+
+  uint32_t fragmentsSent;
+  uint32_t repairsSent;
+  unsigned long startedAt;
+
+  bool readFragment(uint16_t index, uint8_t *out, size_t &len);
+  bool sendFragment(uint16_t index);
+  bool startSession();
+  void runQuery();
+  void nextQueryNode(int after);
+  void finishSession();
+  void finish();
+  static void onStatus(const uint8_t *frame, uint16_t len, int16_t rssi, void *ctx);
+
+public:
+  FuotaManager();
+  bool start(const String &path, const uint8_t *nodes, int count);
+  void abort();
+  void loop();
+  bool isRunning();
+  String report();
+};
+
+extern FuotaManager fuota;
+
+#endif
\ No newline at end of file
@@ -12,6 +12,8 @@
 #include "ModemSMS.h"         // NEW: SMS module
 #include "BLEComm.h"
 #include "ScheduleManager.h"
+#include "FuotaManager.h"
+#include "NodeRegistry.h"
 
 // ========== Global Variable Definitions ==========
 SystemConfig sysConfig;
@@ -41,6 +43,8 @@ ModemMQTT mqtt;               // NEW: MQTT instance
 ModemSMS sms;                 // NEW: SMS instance
 BLEComm bleComm;
 ScheduleManager scheduleMgr;
+FuotaManager fuota;
+NodeRegistry nodeRegistry;
 
 TwoWire WireRTC = TwoWire(1);
 RTC_DS3231 rtc;
@@ -128,6 +132,118 @@ void sendSMSNotification(const String &message, const String &alertKey = "") {
   #endif
 }
 
+// ========== Manual LoRa Commands ==========
+// Serial/BLE/SMS node commands are queued on the LoRa transaction table and
+// answered from the completion callback, so the loop keeps running and
+// identical commands from several transports share one transmission
+enum ManualCommandSource { CMD_SRC_SERIAL, CMD_SRC_BLE, CMD_SRC_SMS };
+
+struct ManualCommand {
+  bool used;
+  ManualCommandSource source;
+  char cmd[LORA_TXN_TYPE_LEN];
+  char sender[24];            // SMS reply number
+};
+
+ManualCommand manualCommands[MANUAL_CMD_SLOTS];
+
+void onManualCommandResult(uint32_t mid, int node, LoRaTxnStatus status, void *ctx) {
+  ManualCommand *m = (ManualCommand *)ctx;
+  String cmd = String(m->cmd);
+  bool ok = (status == LORA_TXN_ACKED);
+  bool replaced = (status == LORA_TXN_SUPERSEDED);
+  
+  switch (m->source) {
+    case CMD_SRC_SERIAL:
+      if (ok) {
+        Serial.println("[Serial] ✓✓✓ SUCCESS ✓✓✓");
+        if (cmd == "OPEN" || cmd == "CLOSE") nodeRegistry.noteValve(node, 1, cmd == "OPEN");
+        // Publish manual command success (important event)
+        publishStatus("EVT|CMD|N=" + String(node) + "|C=" + cmd + "|OK");
+      } else if (replaced) {
+        Serial.printf("[Serial] Node %d %s replaced by a newer command\n", node, cmd.c_str());
+      } else {
+        Serial.println("[Serial] ✗✗✗ FAILED ✗✗✗");
+        // Publish manual command failure (important event)
+        publishStatus("ERR|CMD|N=" + String(node) + "|C=" + cmd + "|FAIL");
+
+        // Send SMS alert for failed commands (with rate limiting)
+        sendSMSNotification("ALERT: LoRa command failed. Node: " +
+                            String(node) + ", Cmd: " + cmd,
+                            "LORA_FAIL_N" + String(node));
+      }
+      break;
+      
+    case CMD_SRC_BLE: {
+      String response;
+      if (ok) {
+        response = "OK|Node " + String(node) + " responded";
+        if (cmd == "OPEN" || cmd == "CLOSE") nodeRegistry.noteValve(node, 1, cmd == "OPEN");
+        Serial.println("[BLE Handler] ✓ Success");
+      } else if (replaced) {
+        response = "FAIL|Node " + String(node) + " superseded";
+      } else {
+        response = "FAIL|Node " + String(node) + " timeout";
+        Serial.println("[BLE Handler] ✗ Failed");
+      }
+      #if ENABLE_BLE
+      bleComm.notify(response);
+      #endif
+      break;
+    }
+      
+    case CMD_SRC_SMS: {
+      String response;
+      if (ok) {
+        Serial.println("[SMS] ✓✓✓ LoRa SUCCESS ✓✓✓");
+        response = "Node " + String(node) + " OK: " + cmd;
+        if (cmd == "OPEN" || cmd == "CLOSE") nodeRegistry.noteValve(node, 1, cmd == "OPEN");
+      } else if (replaced) {
+        response = "Node " + String(node) + " " + cmd + " replaced by a newer command";
+      } else {
+        Serial.println("[SMS] ✗✗✗ LoRa TIMEOUT ✗✗✗");
+        response = "Node " + String(node) + " TIMEOUT";
+      }
+      sms.sendSMS(String(m->sender), response);
+      Serial.println("[SMS] Response: " + response);
+      break;
+    }
+  }
+  
+  m->used = false;
+}
+
+// Returns false if the command couldn't be queued
+bool queueManualCommand(ManualCommandSource source, int node, const String &cmd,
+                        const String &sender = "") {
+  ManualCommand *m = nullptr;
+  for (int i = 0; i < MANUAL_CMD_SLOTS; i++) {
+    if (!manualCommands[i].used) {
+      m = &manualCommands[i];
+      break;
+    }
+  }
+  if (m == nullptr) {
+    Serial.println("[LoRa] ❌ Too many manual commands pending");
+    return false;
+  }
+  
+  m->used = true;
+  m->source = source;
+  strncpy(m->cmd, cmd.c_str(), LORA_TXN_TYPE_LEN - 1);
+  m->cmd[LORA_TXN_TYPE_LEN - 1] = '\0';
+  strncpy(m->sender, sender.c_str(), sizeof(m->sender) - 1);
+  m->sender[sizeof(m->sender) - 1] = '\0';
+  
+  uint32_t mid = loraComm.sendAsync(cmd, node, "", 0, 0, onManualCommandResult, m,
+                                    LoRaComm::commandPriority(cmd));
+  if (mid == 0) {
+    m->used = false;
+    return false;
+  }
+  return true;
+}
+
 // ========== Process SMS Commands ==========
 void processSMSCommands() {
   #if ENABLE_SMS_COMMANDS
@@ -161,194 +277,199 @@ void processSMSCommands() {
   Serial.println("[SMS] checkNewMessages() returned: " + String(hasNewMessages ? "TRUE" : "FALSE"));
 
   if (hasNewMessages) {
-    // Get actual message indices (not sequential like 1,2,3 but actual indices like 34,35,etc)
-    std::vector<int> indices = sms.getUnreadIndices();
-    Serial.println("[SMS] 📨 Processing " + String(indices.size()) + " unread message(s)");
-
-    // Process each message by actual index
-    for (int index : indices) {
-      SMSMessage msg;
-
-      // Try to read the message
-      if (sms.readSMS(index, msg)) {
-        Serial.println("\n[SMS] ==================");
-        Serial.println("[SMS] From: " + msg.sender);
-        Serial.println("[SMS] Time: " + msg.timestamp);
-        Serial.println("[SMS] Message: " + msg.message);
-        
-        // Process command
-        String cmd = msg.message;
-        cmd.trim();
-        cmd.toUpperCase();
-        
-        String response = "";
-        
-        // STATUS command
-        if (cmd == "STATUS") {
-          response = "System OK. ";
-          response += "MQTT: " + String(mqtt.isConnected() ? "ON" : "OFF") + ", ";
-          response += "LoRa: " + String(loraInitialized ? "ON" : "OFF");
-          if (scheduleRunning) {
-            response += ", Schedule: RUNNING";
-          }
-        }
-        // SCHEDULES command
-        else if (cmd == "SCHEDULES") {
-          response = "Schedules: ";
-          int enabledCount = 0;
-          for (auto &sch : schedules) {
-            if (sch.enabled) enabledCount++;
-          }
-          response += String(enabledCount) + "/" + String(schedules.size()) + " enabled";
-        }
-        // START command (for testing)
-        else if (cmd.startsWith("START ")) {
-          String schedId = cmd.substring(6);
-          schedId.trim();
-          response = "Starting schedule: " + schedId;
-          // Trigger schedule logic here
-        }
-        // STOP command
-        else if (cmd == "STOP") {
-          scheduleRunning = false;
-          scheduleLoaded = false;
-          response = "All schedules stopped";
-          publishStatus("EVT|SMS_CMD|STOP");
+    // Messages arrive already read - ModemSMS fetches each +CMTI index with
+    // a queued AT+CMGR from processBackground(), and deletes unreadable ones
+    Serial.println("[SMS] 📨 Processing read message(s)");
+
+    SMSMessage msg;
+    while (sms.takeMessage(msg)) {
+      Serial.println("\n[SMS] ==================");
+      Serial.println("[SMS] From: " + msg.sender);
+      Serial.println("[SMS] Time: " + msg.timestamp);
+      Serial.println("[SMS] Message: " + msg.message);
+      
+      // Process command
+      String cmd = msg.message;
+      cmd.trim();
+      cmd.toUpperCase();
+      
+      String response = "";
+      
+      // STATUS command
+      if (cmd == "STATUS") {
+        response = "System OK. ";
+        response += "MQTT: " + String(mqtt.isConnected() ? "ON" : "OFF") + ", ";
+        response += "LoRa: " + String(loraInitialized ? "ON" : "OFF");
+        if (scheduleRunning) {
+          response += ", Schedule: RUNNING";
         }
-        // ENABLE SMS
-        else if (cmd == "SMS ON") {
-          ENABLE_SMS_BROADCAST = true;
-          response = "SMS alerts enabled";
+        #if ENABLE_LORA
+        if (loraInitialized) {
+          response += ", RTT: " + loraComm.rttReport(3);
+          response += ", Air left: " + String(loraComm.airtimeBudgetMs()) + "ms";
+          response += ", Nodes: " + nodeRegistry.summary();
         }
-        // DISABLE SMS
-        else if (cmd == "SMS OFF") {
-          ENABLE_SMS_BROADCAST = false;
-          response = "SMS alerts disabled";
+        #endif
+      }
+      // SCHEDULES command
+      else if (cmd == "SCHEDULES") {
+        response = "Schedules: ";
+        int enabledCount = 0;
+        for (auto &sch : schedules) {
+          if (sch.enabled) enabledCount++;
         }
-        // NODE command - send LoRa command
-        // Supports two formats:
-        // 1. "NODE <id> <command>" - e.g., "NODE 1 PING"
-        // 2. "<id> <command>" - e.g., "1 PING" (same as serial commands)
-        else if (cmd.startsWith("NODE ") || (cmd.length() > 0 && isdigit(cmd.charAt(0)))) {
-          int nodeId = 0;
-          String nodeCmd = "";
-
-          // Parse command format
-          if (cmd.startsWith("NODE ")) {
-            // Format: NODE <id> <command>
-            int space1 = cmd.indexOf(' ', 5);
-            if (space1 > 0) {
-              String nodeStr = cmd.substring(5, space1);
-              nodeCmd = cmd.substring(space1 + 1);
-              nodeId = nodeStr.toInt();
-            }
-          } else {
-            // Format: <id> <command>
-            int space1 = cmd.indexOf(' ');
-            if (space1 > 0) {
-              String nodeStr = cmd.substring(0, space1);
-              nodeCmd = cmd.substring(space1 + 1);
-              nodeId = nodeStr.toInt();
-            }
+        response += String(enabledCount) + "/" + String(schedules.size()) + " enabled";
+      }
+      // START command (for testing)
+      else if (cmd.startsWith("START ")) {
+        String schedId = cmd.substring(6);
+        schedId.trim();
+        response = "Starting schedule: " + schedId;
+        // Trigger schedule logic here
+      }
+      // STOP command
+      else if (cmd == "STOP") {
+        scheduleRunning = false;
+        scheduleLoaded = false;
+        response = "All schedules stopped";
+        publishStatus("EVT|SMS_CMD|STOP");
+      }
+      // ENABLE SMS
+      else if (cmd == "SMS ON") {
+        ENABLE_SMS_BROADCAST = true;
+        response = "SMS alerts enabled";
+      }
+      // DISABLE SMS
+      else if (cmd == "SMS OFF") {
+        ENABLE_SMS_BROADCAST = false;
+        response = "SMS alerts disabled";
+      }
+      // NODE command - send LoRa command
+      // Supports two formats:
+      // 1. "NODE <id> <command>" - e.g., "NODE 1 PING"
+      // 2. "<id> <command>" - e.g., "1 PING" (same as serial commands)
+      else if (cmd.startsWith("NODE ") || (cmd.length() > 0 && isdigit(cmd.charAt(0)))) {
+        int nodeId = 0;
+        String nodeCmd = "";
+
+        // Parse command format
+        if (cmd.startsWith("NODE ")) {
+          // Format: NODE <id> <command>
+          int space1 = cmd.indexOf(' ', 5);
+          if (space1 > 0) {
+            String nodeStr = cmd.substring(5, space1);
+            nodeCmd = cmd.substring(space1 + 1);
+            nodeId = nodeStr.toInt();
           }
+        } else {
+          // Format: <id> <command>
+          int space1 = cmd.indexOf(' ');
+          if (space1 > 0) {
+            String nodeStr = cmd.substring(0, space1);
+            nodeCmd = cmd.substring(space1 + 1);
+            nodeId = nodeStr.toInt();
+          }
+        }
 
-          // Execute command if valid
-          if (nodeId > 0 && nodeId <= 255 && nodeCmd.length() > 0) {
-            #if ENABLE_LORA
-            if (loraInitialized) {
-              Serial.println("[SMS] ==================");
-              Serial.println("[SMS] ✓ Command parsed successfully");
-              Serial.println("[SMS]   Node ID: " + String(nodeId));
-              Serial.println("[SMS]   Command: " + nodeCmd);
-              Serial.println("[SMS] → Sending via LoRa...");
-
-              bool result = loraComm.sendWithAck(nodeCmd, nodeId, "", 0, 0);
-
-              if (result) {
-                Serial.println("[SMS] ✓✓✓ LoRa SUCCESS ✓✓✓");
-                response = "Node " + String(nodeId) + " OK: " + nodeCmd;
-              } else {
-                Serial.println("[SMS] ✗✗✗ LoRa TIMEOUT ✗✗✗");
-                response = "Node " + String(nodeId) + " TIMEOUT";
-              }
-            } else {
-              Serial.println("[SMS] ❌ LoRa NOT initialized!");
-              Serial.println("[SMS]   loraInitialized = false");
-              response = "LoRa not available";
+        // Execute command if valid
+        if (nodeId > 0 && nodeId <= 255 && nodeCmd.length() > 0) {
+          #if ENABLE_LORA
+          if (loraInitialized) {
+            Serial.println("[SMS] ==================");
+            Serial.println("[SMS] ✓ Command parsed successfully");
+            Serial.println("[SMS]   Node ID: " + String(nodeId));
+            Serial.println("[SMS]   Command: " + nodeCmd);
+            Serial.println("[SMS] → Sending via LoRa...");
+
+            // Reply is sent once the node answers (onManualCommandResult)
+            if (!queueManualCommand(CMD_SRC_SMS, nodeId, nodeCmd, msg.sender)) {
+              response = "Node " + String(nodeId) + " busy, try again";
             }
-            #else
-            Serial.println("[SMS] ❌ LoRa DISABLED in Config.h");
-            Serial.println("[SMS]   ENABLE_LORA is not set");
-            response = "LoRa disabled";
-            #endif
           } else {
-            Serial.println("[SMS] ❌ Invalid command parameters:");
-            Serial.println("[SMS]   NodeID: " + String(nodeId) + " (valid: 1-255)");
-            Serial.println("[SMS]   Command: '" + nodeCmd + "' (length: " + String(nodeCmd.length()) + ")");
-            response = "Format: <id> <cmd> OR NODE <id> <cmd>";
+            Serial.println("[SMS] ❌ LoRa NOT initialized!");
+            Serial.println("[SMS]   loraInitialized = false");
+            response = "LoRa not available";
           }
-        }
-        // HELP command
-        else if (cmd == "HELP") {
-          response = "Commands: STATUS, SCHEDULES, STOP, SMS ON/OFF, <id> <cmd> (e.g., 1 PING), HELP";
-        }
-        // Unknown command
-        else {
-          response = "Unknown command. Send HELP for list.";
-        }
-        
-        // Send response
-        if (response.length() > 0) {
-          sms.sendSMS(msg.sender, response);
-          Serial.println("[SMS] Response: " + response);
-        }
-        
-        // Delete processed message
-        sms.deleteSMS(msg.index);
-        
-        Serial.println("[SMS] ==================\n");
-
-        // Publish SMS command event
-        publishStatus("EVT|SMS_CMD|" + cmd);
-      } else {
-        // Failed to read message (likely PDU mode or other error)
-        Serial.println("[SMS] ⚠ Failed to read message at index " + String(index));
-
-        // If reconfiguration is needed, re-queue for retry after reconfiguration
-        if (sms.needsReconfiguration()) {
-          sms.requeueMessage(index);
-          Serial.println("[SMS] → Message will be retried after reconfiguration");
+          #else
+          Serial.println("[SMS] ❌ LoRa DISABLED in Config.h");
+          Serial.println("[SMS]   ENABLE_LORA is not set");
+          response = "LoRa disabled";
+          #endif
         } else {
-          // Unknown error - still try to delete to avoid infinite loop
-          Serial.println("[SMS] ⚠ Deleting unreadable message");
-          sms.deleteSMS(index);
+          Serial.println("[SMS] ❌ Invalid command parameters:");
+          Serial.println("[SMS]   NodeID: " + String(nodeId) + " (valid: 1-255)");
+          Serial.println("[SMS]   Command: '" + nodeCmd + "' (length: " + String(nodeCmd.length()) + ")");
+          response = "Format: <id> <cmd> OR NODE <id> <cmd>";
         }
       }
+      // HELP command
+      else if (cmd == "HELP") {
+        response = "Commands: STATUS, SCHEDULES, STOP, SMS ON/OFF, <id> <cmd> (e.g., 1 PING), HELP";
+      }
+      // Unknown command
+      else {
+        response = "Unknown command. Send HELP for list.";
+      }
+      
+      // Send response
+      if (response.length() > 0) {
+        sms.sendSMS(msg.sender, response);
+        Serial.println("[SMS] Response: " + response);
+      }
+      
+      // Delete processed message
+      sms.deleteSMS(msg.index);
+      
+      Serial.println("[SMS] ==================\n");
+
+      // Publish SMS command event
+      publishStatus("EVT|SMS_CMD|" + cmd);
     }
   }
   #endif
 }
 
+// ========== Gateway Status (Serial) ==========
+void printGatewayStatus() {
+  Serial.println("[Status] LoRa: " + String(loraInitialized ? "ON" : "OFF"));
+  #if ENABLE_LORA
+  if (loraInitialized) {
+    Serial.println("[Status] LoRa pending transactions: " + String(loraComm.pendingCount()));
+    Serial.println("[Status] LoRa RTT srtt/rttvar/rto (ms): " + loraComm.rttReport());
+    Serial.println("[Status] LoRa links: " + loraComm.linkReport());
+    Serial.println("[Status] LoRa channel: " + loraComm.statsReport());
+    Serial.println("[Status] LoRa radio (recoveries irq/acks/silence): " + loraComm.healthReport());
+    Serial.println("[Status] LoRa airtime: " + loraComm.airtimeReport());
+    Serial.println("[Status] LoRa classes: " + loraComm.priorityReport());
+    Serial.println("[Status] LoRa capture: " + loraComm.captureReport());
+    Serial.println("[Status] LoRa sleepy mailboxes: " + loraComm.mailboxReport());
+    Serial.println("[Status] FUOTA: " + fuota.report());
+    Serial.println("[Status] Nodes: " + nodeRegistry.summary());
+    Serial.println("[Status] LoRa TDMA beacon " + loraComm.slotReport());
+  }
+  #endif
+  #if ENABLE_MODEM
+  Serial.println("[Status] Modem AT: " + ModemBase::atReport());
+  #endif
+  #if ENABLE_MQTT
+  Serial.println("[Status] MQTT: " + String(mqtt.isConnected() ? "CONNECTED" : "DISCONNECTED") +
+                 " publish " + mqtt.publishReport());
+  #endif
+  Serial.println("[Status] Schedule: " + String(scheduleRunning ? "RUNNING" : "IDLE") +
+                 " (" + String(scheduleMgr.phaseName(scheduleMgr.getPhase())) + ")");
+}
+
 // ========== BLE Command Handler Callback ==========
 void handleBLECommand(int node, String command) {
   Serial.printf("[BLE Handler] Node=%d, Command=%s\n", node, command.c_str());
   
   #if ENABLE_LORA
   if (loraInitialized) {
-    bool result = loraComm.sendWithAck(command, node, "", 0, 0);
-    
-    String response;
-    if (result) {
-      response = "OK|Node " + String(node) + " responded";
-      Serial.println("[BLE Handler] ✓ Success");
-    } else {
-      response = "FAIL|Node " + String(node) + " timeout";
-      Serial.println("[BLE Handler] ✗ Failed");
+    if (!queueManualCommand(CMD_SRC_BLE, node, command)) {
+      #if ENABLE_BLE
+      bleComm.notify("FAIL|Node " + String(node) + " queue full");
+      #endif
     }
-    
-    #if ENABLE_BLE
-    bleComm.notify(response);
-    #endif
   } else {
     #if ENABLE_BLE
     bleComm.notify("ERROR|LoRa not initialized");
@@ -363,6 +484,7 @@ void handleBLECommand(int node, String command) {
 
 // ========== Setup ==========
 void setup() {
+  Serial.setRxBufferSize(1024);  // Pasted "CAP|<hex>" lines run to ~550 characters
   Serial.begin(115200);
   delay(1000);
   
@@ -414,6 +536,7 @@ void setup() {
   delay(500);
   if (loraComm.init()) {
     loraInitialized = true;
+    nodeRegistry.begin();
     Serial.println("      ✓ LoRa OK");
   } else {
     Serial.println("      ❌ LoRa FAILED");
@@ -445,6 +568,12 @@ void setup() {
     #if ENABLE_SMS
     Serial.println("      → Configuring SMS...");
     if (sms.configure()) {
+      while (sms.isConfiguring()) {  // Runs through the AT engine's callbacks
+        sms.processBackground();
+        delay(1);
+      }
+    }
+    if (sms.isReady()) {
       Serial.println("      ✓ SMS configured");
     } else {
       Serial.println("      ❌ SMS configuration failed");
@@ -457,10 +586,14 @@ void setup() {
     #if ENABLE_MQTT
     Serial.println("      → Configuring MQTT...");
     if (mqtt.configure()) {
+      // Subscribes to MQTT_TOPIC_COMMANDS as its last step
+      while (mqtt.isConfiguring()) {
+        mqtt.processBackground();
+        delay(1);
+      }
+    }
+    if (mqtt.isConnected()) {
       Serial.println("      ✓ MQTT configured");
-      // Subscribe to command topics
-      mqtt.subscribe(MQTT_TOPIC_COMMANDS);
-      Serial.println("      ✓ Subscribed to commands");
     } else {
       Serial.println("      ❌ MQTT configuration failed");
     }
@@ -501,6 +634,17 @@ void setup() {
   if (loraInitialized) {
     Serial.println("Ready for commands!");
     Serial.println("Serial Commands:");
+    Serial.println("  STATUS - Gateway status and LoRa link stats");
+    Serial.println("  LINK <node> - SNR/RSSI histograms for a node");
+    Serial.println("  NODES - Liveness, battery, firmware and valves of every node");
+    Serial.println("  NODE <node> - The same for one node");
+    Serial.println("  NODE FORGET <node> - Release a joined node's address (remote: add ,TOK=<token>)");
+    Serial.println("  CAPTURE FILE|SERIAL|OFF - Record LoRa TX/RX frames");
+    Serial.println("  CAPTURE CLEAR - Delete the capture file");
+    Serial.println("  CAP|<hex> - Append a record from a serial capture to the file");
+    Serial.println("  REPLAY - Replay the capture file through the RX path");
+    Serial.println("  FUOTA <path> <nodes> - Update node firmware (e.g. FUOTA /fw/node.bin 1-50)");
+    Serial.println("  FUOTA ABORT - Stop a firmware update");
     Serial.println("  <node> <command>");
     Serial.println("Examples:");
     Serial.println("  1 PING");
@@ -553,6 +697,8 @@ void loop() {
   #if ENABLE_LORA
   if (loraInitialized) {
     loraComm.processIncoming();
+    fuota.loop();
+    nodeRegistry.loop();
   }
   #endif
   
@@ -561,17 +707,13 @@ void loop() {
   mqtt.processBackground();
 
   // Check if MQTT needs reconfiguration after modem restart
-  // Note: needsReconfiguration() now handles throttling and attempt limiting
+  // Note: needsReconfiguration() handles throttling and attempt limiting, and
+  // waits for +QIND: SMS DONE and MODEM_RESTART_SETTLE_MS after RDY. The
+  // sequence itself runs from processBackground().
   if (mqtt.needsReconfiguration()) {
-    Serial.println("[Main] ⚠ MQTT needs reconfiguration, waiting for modem...");
-    // Wait for modem to be fully initialized (detected via +QIND: SMS DONE)
-    // This typically takes 5-6 seconds after RDY
-    delay(6000);
-    if (mqtt.configure()) {
-      Serial.println("[Main] ✓ MQTT reconfigured successfully");
-    } else {
+    Serial.println("[Main] ⚠ MQTT needs reconfiguration");
+    if (!mqtt.configure()) {
       Serial.println("[Main] ❌ MQTT reconfiguration failed (will retry with backoff)");
-      // Don't block here - let SMS reconfigure too
     }
   }
   #endif
@@ -581,17 +723,12 @@ void loop() {
   sms.processBackground();
 
   // Check if SMS needs reconfiguration after modem restart
-  // SMS reconfiguration happens independently of MQTT status
-  if (sms.needsReconfiguration()) {
-    Serial.println("[Main] ⚠ SMS needs reconfiguration, waiting for modem...");
-    // Wait for modem to be fully initialized (detected via +QIND: SMS DONE)
-    // This typically takes 5-6 seconds after RDY
-    delay(6000);
-    if (sms.configure()) {
-      Serial.println("[Main] ✓ SMS reconfigured successfully");
-    } else {
+  // SMS reconfiguration happens independently of MQTT status, once the modem
+  // has settled after RDY; the sequence runs from processBackground()
+  if (sms.reconfigureDue()) {
+    Serial.println("[Main] ⚠ SMS needs reconfiguration");
+    if (!sms.configure()) {
       Serial.println("[Main] ❌ SMS reconfiguration failed");
-      // Don't block here - continue with other tasks
     }
   }
   #endif
@@ -614,8 +751,80 @@ void loop() {
       Serial.println("\n[Serial] ==================");
       Serial.println("[Serial] Input: " + line);
       
+      // Gateway status
+      if (line.equalsIgnoreCase("STATUS")) {
+        printGatewayStatus();
+      }
+      // Link quality histograms for one node
+      else if (line.startsWith("LINK ")) {
+        int node = line.substring(5).toInt();
+        Serial.println("[Status] Node " + String(node) + " link: " + loraComm.linkHistogram(node));
+      }
+      // Node registry - FORGET rewrites flash, so the queue only takes it with a token
+      else if (line.startsWith("NODE FORGET ")) {
+        int node = line.substring(12).toInt();
+        if (!nodeRegistry.forget(node)) Serial.printf("[Nodes] Node %d has no joined address\n", node);
+      }
+      else if (line.equalsIgnoreCase("NODES") || line.startsWith("NODE ")) {
+        incomingQueue.enqueue(line + ",SRC=SERIAL");
+      }
+      // Packet capture
+      else if (line.equalsIgnoreCase("CAPTURE FILE")) {
+        loraComm.setCapture(LORA_CAPTURE_FILE);
+      }
+      else if (line.equalsIgnoreCase("CAPTURE SERIAL")) {
+        loraComm.setCapture(LORA_CAPTURE_SERIAL);
+      }
+      else if (line.equalsIgnoreCase("CAPTURE OFF")) {
+        loraComm.setCapture(LORA_CAPTURE_OFF);
+      }
+      else if (line.equalsIgnoreCase("CAPTURE CLEAR")) {
+        if (!loraComm.clearCapture()) Serial.println("[Serial] ✗ Could not delete the capture file");
+      }
+      // Capture records pasted from another gateway's "CAPTURE SERIAL" output
+      else if (line.startsWith("CAP|")) {
+        loraComm.importCapture(line.substring(4));
+      }
+      // Firmware update: FUOTA <path> <nodes>, nodes like "1-20,25,31"
+      else if (line.equalsIgnoreCase("FUOTA ABORT")) {
+        fuota.abort();
+      }
+      else if (line.startsWith("FUOTA ")) {
+        String args = line.substring(6);
+        args.trim();
+        int space = args.indexOf(' ');
+        uint8_t nodes[LORA_MAX_NODES];
+        int count = 0;
+        if (space > 0) {
+          String list = args.substring(space + 1);
+          int pos = 0;
+          while (pos < (int)list.length()) {
+            int comma = list.indexOf(',', pos);
+            if (comma < 0) comma = list.length();
+            String item = list.substring(pos, comma);
+            int dash = item.indexOf('-');
+            int from = item.toInt();
+            int to = (dash > 0) ? item.substring(dash + 1).toInt() : from;
+            for (int n = from; n <= to && n < LORA_MAX_NODES && count < LORA_MAX_NODES; n++) {
+              if (n > 0) nodes[count++] = (uint8_t)n;
+            }
+            pos = comma + 1;
+          }
+        }
+        if (count == 0 || !fuota.start(args.substring(0, space), nodes, count)) {
+          Serial.println("[Serial] ✗ Usage: FUOTA <path> <nodes>, e.g. FUOTA /fw/node.bin 1-50");
+        }
+      }
+      // Replay the capture file through the RX path (benchmark)
+      else if (line.equalsIgnoreCase("REPLAY")) {
+        if (scheduleRunning) {
+          Serial.println("[Serial] ✗ Not while a schedule is running");
+        } else {
+          Serial.println("[Replay] " + loraComm.replayCapture());
+        }
+      }
       // Check if it's a schedule
-      if (line.startsWith("SCH|") || line.startsWith("{")) {
+      else if (line.startsWith("SCH|") || line.startsWith("{")) {
         Serial.println("[Serial] Schedule detected, queuing...");
         if (line.indexOf("SRC=") < 0) line += ",SRC=SERIAL";
         incomingQueue.enqueue(line);
@@ -635,21 +844,8 @@ void loop() {
             #if ENABLE_LORA
             if (loraInitialized) {
               Serial.println("[Serial] Sending via LoRa...");
-              bool result = loraComm.sendWithAck(cmd, node, "", 0, 0);
-              
-              if (result) {
-                Serial.println("[Serial] ✓✓✓ SUCCESS ✓✓✓");
-                // Publish manual command success (important event)
-                publishStatus("EVT|CMD|N=" + String(node) + "|C=" + cmd + "|OK");
-              } else {
-                Serial.println("[Serial] ✗✗✗ FAILED ✗✗✗");
-                // Publish manual command failure (important event)
-                publishStatus("ERR|CMD|N=" + String(node) + "|C=" + cmd + "|FAIL");
-
-                // Send SMS alert for failed commands (with rate limiting)
-                sendSMSNotification("ALERT: LoRa command failed. Node: " +
-                                    String(node) + ", Cmd: " + cmd,
-                                    "LORA_FAIL_N" + String(node));
+              if (!queueManualCommand(CMD_SRC_SERIAL, node, cmd)) {
+                Serial.println("[Serial] ✗ Could not queue command");
               }
             } else {
               Serial.println("[Serial] ✗ LoRa not initialized");
@@ -678,90 +874,53 @@ void loop() {
     Serial.println("\n[Queue] ==================");
     Serial.println("[Queue] Processing: " + msg);
     
-    // Handle STAT messages from nodes
-    if (msg.startsWith("STAT|")) {
-      Serial.println("[Queue] ✓✓✓ TELEMETRY ✓✓✓");
-      
-      int nPos = msg.indexOf("N=");
-      if (nPos >= 0) {
-        int comma = msg.indexOf(',', nPos);
-        String nodeIdStr = msg.substring(nPos + 2, comma > 0 ? comma : msg.length());
-        int nodeId = nodeIdStr.toInt();
-        
-        Serial.printf("[Queue] Node %d Telemetry:\n", nodeId);
-        
-        // Parse battery
-        if (msg.indexOf("BATT=") >= 0) {
-          int battPos = msg.indexOf("BATT=");
-          int battEnd = msg.indexOf(',', battPos);
-          String battStr = msg.substring(battPos + 5, battEnd > 0 ? battEnd : msg.length());
-          Serial.println("[Queue]   Battery: " + battStr + "%");
-          
-          // Publish low battery warning (important event)
-          int battPct = battStr.toInt();
-          if (battPct < 20) {
-            publishStatus("WARN|LOW_BATT|N=" + String(nodeId) + "|BATT=" + battStr);
-            // Send SMS alert for low battery (with rate limiting to avoid spam)
-            sendSMSNotification("WARN: Low battery on Node " + String(nodeId) +
-                                " - " + battStr + "%",
-                                "LOW_BATT_N" + String(nodeId));
-          }
-        }
-        
-        // Parse battery voltage
-        if (msg.indexOf("BV=") >= 0) {
-          int bvPos = msg.indexOf("BV=");
-          int bvEnd = msg.indexOf(',', bvPos);
-          String bvStr = msg.substring(bvPos + 3, bvEnd > 0 ? bvEnd : msg.length());
-          Serial.println("[Queue]   Batt Voltage: " + bvStr + "V");
-        }
-        
-        // Parse solar
-        if (msg.indexOf("SOLV=") >= 0) {
-          int solPos = msg.indexOf("SOLV=");
-          int solEnd = msg.indexOf(',', solPos);
-          String solStr = msg.substring(solPos + 5, solEnd > 0 ? solEnd : msg.length());
-          Serial.println("[Queue]   Solar: " + solStr + "V");
-        }
-        
-        // Parse valve states
-        for (int i = 1; i <= 4; i++) {
-          String vKey = "V" + String(i) + "=";
-          if (msg.indexOf(vKey) >= 0) {
-            int vPos = msg.indexOf(vKey);
-            int vEnd = msg.indexOf(',', vPos);
-            String vStr = msg.substring(vPos + vKey.length(), vEnd > 0 ? vEnd : msg.length());
-            Serial.println("[Queue]   Valve " + String(i) + ": " + vStr);
-          }
+    // STAT, AUTO_CLOSE and JOIN from nodes
+    if (nodeRegistry.handleMessage(msg)) {
+      // Handled by the registry
+    }
+    // Releasing an address from BLE/MQTT/LoRa needs the source's token, as a schedule does
+    else if (msg.startsWith("NODE FORGET ")) {
+      if (!verifyTokenForSrc(msg, extractKeyVal(msg, "_FROM"))) {
+        Serial.println("❌ Auth failed for: " + extractSrc(msg));
+      } else {
+        int node = msg.substring(12).toInt();
+        if (!nodeRegistry.forget(node)) Serial.printf("[Nodes] Node %d has no joined address\n", node);
+      }
+    }
+    // Node registry queries: "NODES" or "NODE <n>", answered on the asking transport
+    else if (msg.startsWith("NODES") || msg.startsWith("NODE ")) {
+      String src = extractSrc(msg);
+      int comma = msg.indexOf(',');
+      String query = msg.substring(0, comma > 0 ? comma : msg.length());
+
+      std::vector<String> lines;
+      if (query.startsWith("NODES")) {
+        lines.push_back("NODES|" + nodeRegistry.summary());
+        for (int n = 1; n < LORA_MAX_NODES; n++) {
+          if (nodeRegistry.isKnown(n)) lines.push_back(nodeRegistry.nodeReport(n));
         }
-        
-        // Parse moisture sensors
-        for (int i = 1; i <= 4; i++) {
-          String mKey = "M" + String(i) + "=";
-          if (msg.indexOf(mKey) >= 0) {
-            int mPos = msg.indexOf(mKey);
-            int mEnd = msg.indexOf(',', mPos);
-            String mStr = msg.substring(mPos + mKey.length(), mEnd > 0 ? mEnd : msg.length());
-            Serial.println("[Queue]   Moisture " + String(i) + ": " + mStr + "%");
-          }
+      } else {
+        lines.push_back(nodeRegistry.nodeReport(query.substring(5).toInt()));
+      }
+
+      int failed = 0;
+      for (auto &l : lines) {
+        if (src == "BT") {
+          #if ENABLE_BLE
+          if (!bleComm.notify(l)) failed++;
+          #endif
+        } else if (src == "MQTT") {
+          #if ENABLE_MQTT
+          // Backlogged, and fed to the AT queue as it drains
+          if (!mqtt.publish(MQTT_TOPIC_TELEMETRY, l)) failed++;
+          #endif
+        } else {
+          Serial.println("[Nodes] " + l);
         }
       }
-    }
-    // Handle AUTO_CLOSE
-    else if (msg.startsWith("AUTO_CLOSE|")) {
-      Serial.println("[Queue] ✓✓✓ AUTO_CLOSE ✓✓✓");
-      Serial.println("[Queue] " + msg);
-      
-      // Parse node ID
-      int nPos = msg.indexOf("N=");
-      String nodeStr = "";
-      if (nPos >= 0) {
-        int comma = msg.indexOf(',', nPos);
-        nodeStr = msg.substring(nPos + 2, comma > 0 ? comma : msg.length());
+      if (failed > 0) {
+        Serial.printf("[Nodes] ❌ %d of %d report lines not sent\n", failed, (int)lines.size());
       }
-      
-      // Publish auto-close event (important event - keep this)
-      publishStatus("EVT|AUTO_CLOSE|N=" + nodeStr);
     }
     // Handle schedules
     else if (msg.indexOf("SCH|") >= 0 || msg.startsWith("{")) {
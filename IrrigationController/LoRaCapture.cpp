@@ -0,0 +1,73 @@
+// LoRaCapture.cpp - Packet capture record codec
+#include "LoRaCapture.h"
+#include <string.h>
+
+size_t loraCaptureEncode(uint8_t *buf, size_t cap, const LoRaCaptureRecord &r) {
+  if (cap < LORA_CAP_HEADER_LEN + (size_t)r.len) return 0;
+
+  buf[0] = LORA_CAP_MAGIC;
+  buf[1] = r.kind;
+  buf[2] = r.outcome;
+  buf[3] = (uint8_t)(r.at);
+  buf[4] = (uint8_t)(r.at >> 8);
+  buf[5] = (uint8_t)(r.at >> 16);
+  buf[6] = (uint8_t)(r.at >> 24);
+  buf[7] = (uint8_t)(r.rssi);
+  buf[8] = (uint8_t)((uint16_t)r.rssi >> 8);
+  buf[9] = (uint8_t)r.snr;
+  buf[10] = r.channel;
+  buf[11] = r.sf;
+  buf[12] = r.len;
+  if (r.len > 0) memcpy(buf + LORA_CAP_HEADER_LEN, r.data, r.len);
+  return LORA_CAP_HEADER_LEN + r.len;
+}
+
+size_t loraCaptureDecode(const uint8_t *buf, size_t len, LoRaCaptureRecord &r) {
+  if (len < LORA_CAP_HEADER_LEN || buf[0] != LORA_CAP_MAGIC) return 0;
+  if (len < LORA_CAP_HEADER_LEN + (size_t)buf[12]) return 0;
+
+  r.kind = buf[1];
+  r.outcome = buf[2];
+  r.at = (uint32_t)buf[3] | ((uint32_t)buf[4] << 8) |
+         ((uint32_t)buf[5] << 16) | ((uint32_t)buf[6] << 24);
+  r.rssi = (int16_t)((uint16_t)buf[7] | ((uint16_t)buf[8] << 8));
+  r.snr = (int8_t)buf[9];
+  r.channel = buf[10];
+  r.sf = buf[11];
+  r.len = buf[12];
+  r.data = buf + LORA_CAP_HEADER_LEN;
+  return LORA_CAP_HEADER_LEN + r.len;
+}
+
+static int hexDigit(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+size_t loraCaptureFromHex(const char *hex, uint8_t *buf, size_t cap) {
+  size_t n = 0;
+  for (; hex[0] != '\0' && hex[1] != '\0'; hex += 2) {
+    int hi = hexDigit(hex[0]);
+    int lo = hexDigit(hex[1]);
+    if (hi < 0 || lo < 0 || n == cap) return 0;
+    buf[n++] = (uint8_t)((hi << 4) | lo);
+  }
+  return hex[0] == '\0' ? n : 0;
+}
+
+const char *loraCaptureOutcomeName(uint8_t outcome) {
+  switch (outcome) {
+    case LORA_CAP_TX_DONE: return "done";
+    case LORA_CAP_TX_TIMEOUT: return "txTimeout";
+    case LORA_CAP_RX_ACK: return "ack";
+    case LORA_CAP_RX_ACK_STRAY: return "stray";
+    case LORA_CAP_RX_QUEUED: return "queued";
+    case LORA_CAP_RX_DUP: return "dup";
+    case LORA_CAP_RX_BAD: return "bad";
+    case LORA_CAP_RX_IGNORED: return "ignored";
+    case LORA_CAP_RX_HANDLER: return "handler";
+    default: return "?";
+  }
+}
\ No newline at end of file
@@ -0,0 +1,67 @@
+// LoRaCapture.h - Packet capture record codec
+// Plain C types only so host tools can read captures with the same code.
+//
+// A capture is a plain concatenation of records (multi-byte fields
+// little-endian):
+//   [0]      LORA_CAP_MAGIC
+//   [1]      kind (LoRaCaptureKind)
+//   [2]      outcome (LoRaCaptureOutcome)
+//   [3..6]   millis() at the event (TX: start of transmission)
+//   [7..8]   RSSI dBm (0 for TX)
+//   [9]      SNR dB (0 for TX)
+//   [10]     channel index
+//   [11]     spreading factor
+//   [12]     frame length n
+//   [13..]   frame bytes exactly as sent/received (relay envelope included)
+// Streamed over Serial, each record is one "CAP|<hex>" line.
+#ifndef LORA_CAPTURE_H
+#define LORA_CAPTURE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define LORA_CAP_MAGIC 0xCA
+#define LORA_CAP_HEADER_LEN 13
+
+enum LoRaCaptureKind {
+  LORA_CAP_TX = 1,
+  LORA_CAP_RX = 2
+};
+
+enum LoRaCaptureOutcome {
+  LORA_CAP_TX_DONE = 1,
+  LORA_CAP_TX_TIMEOUT = 2,
+  LORA_CAP_RX_ACK = 3,          // Completed a transaction
+  LORA_CAP_RX_ACK_STRAY = 4,    // ACK/NAK that matched nothing pending
+  LORA_CAP_RX_QUEUED = 5,       // Handed to incomingQueue
+  LORA_CAP_RX_DUP = 6,          // Dropped as a retransmission
+  LORA_CAP_RX_BAD = 7,          // Failed decode/CRC
+  LORA_CAP_RX_IGNORED = 8,      // Beacons, relay copies, empty frames
+  LORA_CAP_RX_HANDLER = 9       // Passed to the registered uplink handler
+};
+
+// Decoded record; data points into the capture buffer
+struct LoRaCaptureRecord {
+  uint8_t kind;
+  uint8_t outcome;
+  uint32_t at;
+  int16_t rssi;
+  int8_t snr;
+  uint8_t channel;
+  uint8_t sf;
+  uint8_t len;
+  const uint8_t *data;
+};
+
+// Returns the encoded length, 0 if it doesn't fit in cap
+size_t loraCaptureEncode(uint8_t *buf, size_t cap, const LoRaCaptureRecord &r);
+
+// Returns the bytes consumed, 0 if buf doesn't start with a whole record
+size_t loraCaptureDecode(const uint8_t *buf, size_t len, LoRaCaptureRecord &r);
+
+// Hex digits of a "CAP|<hex>" line to bytes; 0 if malformed or over cap
+size_t loraCaptureFromHex(const char *hex, uint8_t *buf, size_t cap);
+
+const char *loraCaptureOutcomeName(uint8_t outcome);
+
+#endif // LORA_CAPTURE_H
\ No newline at end of file
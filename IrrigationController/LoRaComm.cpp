@@ -3,48 +3,137 @@
 
 // Static member initialization
 char LoRaComm::txBuffer[LORA_BUFFER_SIZE];
-char LoRaComm::rxBuffer[LORA_BUFFER_SIZE];
 char LoRaComm::rxBufferSafe[LORA_BUFFER_SIZE];
-volatile bool LoRaComm::rxFlag = false;
+LoRaRxSlot LoRaComm::rxRing[LORA_RX_RING_SLOTS];
+volatile uint8_t LoRaComm::rxHead = 0;
+volatile uint8_t LoRaComm::rxTail = 0;
+volatile uint32_t LoRaComm::rxDropped = 0;
 volatile bool LoRaComm::txDoneFlag = false;
-volatile uint16_t LoRaComm::rxSize = 0;
-int16_t LoRaComm::lastRssi = 0;
-int8_t LoRaComm::lastSnr = 0;
-String LoRaComm::lastRxMessage = "";
+volatile bool LoRaComm::txTimeoutFlag = false;
+volatile bool LoRaComm::cadDoneFlag = false;
+volatile bool LoRaComm::cadActivity = false;
+volatile uint32_t LoRaComm::rxErrors = 0;
 
 static RadioEvents_t RadioEvents;
+static const uint32_t channelPlan[LORA_CHANNEL_COUNT] = LORA_CHANNEL_PLAN;
 
-LoRaComm::LoRaComm() {}
+LoRaComm::LoRaComm() : rxErrorsSeen(0), cadMid(0), cadStartedAt(0), txBusy(false), txStartedAt(0), onAirMid(0),
+                       rxDroppedReported(0), txLen(0), lastRssi(0), lastSnr(0),
+                       radioChannel(0), radioSf(0), radioPower(0), adrChanges(0), adrFallbacks(0),
+                       cadChecks(0), cadBusy(0), cadForced(0), retryBackoffs(0),
+                       coalesced(0), superseded(0),
+                       airtimeTokensUs((uint32_t)LORA_AIRTIME_BURST_MS * 1000UL),
+                       airtimeRefillAt(0), airtimeHourStart(0), beaconHourMs(0), beaconLastHourMs(0),
+                       airtimeDeferrals(0), airtimeRefusals(0), preemptions(0), agedPromotions(0),
+                       beaconSlots(0), beaconSeq(0), beaconDueAt(0), beaconAt(0), beaconOnAir(false),
+                       dupHits(0), dupMisses(0),
+                       bulkLen(0), bulkChannel(0), bulkSf(0), bulkPower(0), bulkListenMs(0),
+                       bulkListenUntil(0), bulkSent(0), uplinkHandler(nullptr), uplinkCtx(nullptr),
+                       seenHandler(nullptr), seenCtx(nullptr),
+                       captureMode(LORA_CAPTURE_OFF), captureBytes(0), captureRecords(0),
+                       radioAliveAt(0), lastRxAt(0), radioFaults(0), ackTimeoutStreak(0),
+                       recoveredAt(0), recoveryGapMs(LORA_HEALTH_MIN_GAP_MS), hangSince(0),
+                       recoveredCount(0), recoverLastMs(0), recoverMaxMs(0),
+                       tableFull(0), mailboxSent(0), mailboxExpired(0) {
+  memset(txns, 0, sizeof(txns));
+  memset(groups, 0, sizeof(groups));
+  memset(recoveries, 0, sizeof(recoveries));
+  memset(channelTx, 0, sizeof(channelTx));
+  memset(dupCache, 0, sizeof(dupCache));
+  memset(slotOwner, 0, sizeof(slotOwner));
+  memset(slotStats, 0, sizeof(slotStats));
+  memset(airtimeHourMs, 0, sizeof(airtimeHourMs));
+  memset(airtimeLastHourMs, 0, sizeof(airtimeLastHourMs));
+  memset(classStats, 0, sizeof(classStats));
+  initLinks();
+}
+
+// Whether a comma-separated ID list from Config.h names node
+static bool idListHas(const char *ids, int node) {
+  while (*ids) {
+    if (atoi(ids) == node) return true;
+    const char *comma = strchr(ids, ',');
+    if (comma == NULL) break;
+    ids = comma + 1;
+  }
+  return false;
+}
+
+void LoRaComm::initLinks() {
+  for (int i = 0; i < LORA_MAX_NODES; i++) defaultLink((uint8_t)i);
+}
+
+// Fresh link state; the caller applies the relay and sleepy designations
+void LoRaComm::defaultLink(uint8_t node) {
+  LoRaNodeLink &l = links[node];
+  memset(&l, 0, sizeof(l));
+  l.rto = LORA_ACK_TIMEOUT_MS;
+  l.channel = node % LORA_CHANNEL_COUNT;
+  l.sf = LORA_SPREADING_FACTOR;
+  l.power = TX_OUTPUT_POWER;
+  l.pendingSf = LORA_SPREADING_FACTOR;
+  l.pendingPower = TX_OUTPUT_POWER;
+  l.slot = LORA_NO_SLOT;
+}
+
+// Programs the radio from scratch and starts RX on the home channel - at
+// boot, and again to bring back a wedged radio
+void LoRaComm::configureRadio() {
+  //static RadioEvents_t RadioEvents;  // CRITICAL: Must be static!
+  RadioEvents.TxDone = onTxDone;
+  RadioEvents.TxTimeout = onTxTimeout;
+  RadioEvents.RxDone = onRxDone;
+  RadioEvents.CadDone = onCadDone;
+  RadioEvents.RxError = onRxError;
+
+  Radio.Init(&RadioEvents);
+  
+  radioSf = 0;  // Force a full configuration
+  radioChannel = LORA_HOME_CHANNEL;
+  Radio.SetChannel(channelPlan[LORA_HOME_CHANNEL]);
+  applyHomeProfile();
+  
+  Radio.Rx(0);
+}
 
 // ========== Interrupt Handlers ==========
+// Keep these short: no Serial, no heap. processIncoming() does the logging.
 void LoRaComm::onTxDone(void) {
-  Serial.println("[LoRa] TX Done");
   txDoneFlag = true;
   Radio.Rx(0);
 }
 
 void LoRaComm::onTxTimeout(void) {
-  Serial.println("[LoRa] TX Timeout");
-  txDoneFlag = true;
+  txTimeoutFlag = true;
   Radio.Rx(0);
 }
 
+void LoRaComm::onCadDone(bool channelActivityDetected) {
+  cadActivity = channelActivityDetected;
+  cadDoneFlag = true;
+}
+
+void LoRaComm::onRxError(void) {
+  rxErrors++;  // CRC/header error - usually a collision
+}
+
 void LoRaComm::onRxDone(uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr) {
-  // Validate payload pointer and size
-  if (payload == nullptr || size == 0) {
-    Serial.println("[LoRa] ⚠ Invalid payload in onRxDone");
+  if (payload == nullptr || size == 0) return;
+
+  uint8_t next = (rxHead + 1) % LORA_RX_RING_SLOTS;
+  if (next == rxTail) {
+    rxDropped++;  // Ring full - keep the older packets
     return;
   }
 
   if (size >= LORA_BUFFER_SIZE) size = LORA_BUFFER_SIZE - 1;
-  memcpy(rxBuffer, payload, size);
-  rxBuffer[size] = '\0';
-  lastRxMessage = String(rxBuffer);
-  rxSize = size;
-  rxFlag = true;
-  lastRssi = rssi;
-  lastSnr = snr;
-  Serial.printf("[LoRa] RX: %s (RSSI=%d, SNR=%d)\n", rxBuffer, rssi, snr);
+  LoRaRxSlot &slot = rxRing[rxHead];
+  memcpy(slot.data, payload, size);
+  slot.size = size;
+  slot.rssi = rssi;
+  slot.snr = snr;
+  slot.rxAt = millis();
+  rxHead = next;
 }
 
 // ========== Initialize LoRa ==========
@@ -52,54 +141,143 @@ bool LoRaComm::init() {
   Serial.println("[LoRa] Initializing...");
 
   Mcu.begin(HELTEC_BOARD, SLOW_CLK_TPYE);
-
-  //static RadioEvents_t RadioEvents;  // CRITICAL: Must be static!
-  RadioEvents.TxDone = onTxDone;
-  RadioEvents.TxTimeout = onTxTimeout;
-  RadioEvents.RxDone = onRxDone;
-
-  Radio.Init(&RadioEvents);
-  Radio.SetChannel(RF_FREQUENCY);
+  configureRadio();
   
-  Radio.SetTxConfig(MODEM_LORA, TX_OUTPUT_POWER, 0, LORA_BANDWIDTH,
-                    LORA_SPREADING_FACTOR, LORA_CODINGRATE,
-                    LORA_PREAMBLE_LENGTH, LORA_FIX_LENGTH_PAYLOAD_ON,
-                    true, 0, 0, LORA_IQ_INVERSION_ON, 3000);
+#if LORA_RELAY_ENABLED
+  const char *relayIds = LORA_RELAY_NODES;
+  while (*relayIds) {
+    int id = atoi(relayIds);
+    if (id > 0 && id < LORA_MAX_NODES) {
+      links[id].relay = true;
+      Serial.printf("[LoRa] Node %d is a relay\n", id);
+    }
+    const char *comma = strchr(relayIds, ',');
+    if (comma == NULL) break;
+    relayIds = comma + 1;
+  }
+#endif
   
-  Radio.SetRxConfig(MODEM_LORA, LORA_BANDWIDTH, LORA_SPREADING_FACTOR,
-                    LORA_CODINGRATE, 0, LORA_PREAMBLE_LENGTH,
-                    LORA_SYMBOL_TIMEOUT, LORA_FIX_LENGTH_PAYLOAD_ON,
-                    0, true, 0, 0, LORA_IQ_INVERSION_ON, true);
+  const char *sleepyIds = LORA_SLEEPY_NODES;
+  while (*sleepyIds) {
+    int id = atoi(sleepyIds);
+    if (id > 0 && id < LORA_MAX_NODES) {
+      links[id].rxWindowMs = LORA_SLEEPY_RX_WINDOW_MS;
+      Serial.printf("[LoRa] Node %d is sleepy (%u ms window)\n", id, LORA_SLEEPY_RX_WINDOW_MS);
+    }
+    const char *comma = strchr(sleepyIds, ',');
+    if (comma == NULL) break;
+    sleepyIds = comma + 1;
+  }
   
-  Radio.Rx(0);
+  beaconDueAt = millis() + LORA_BEACON_INTERVAL_MS / 4;  // Let nodes be heard once first
   
   Serial.println("[LoRa] Init OK, listening...");
   return true;
 }
 
+// Program channel/SF/power for the next exchange. The caller puts the radio
+// back into RX, CAD or TX afterwards.
+void LoRaComm::applyRadioProfile(uint8_t channel, uint8_t sf, int8_t power) {
+  if (channel != radioChannel) {
+    Radio.SetChannel(channelPlan[channel]);
+    radioChannel = channel;
+  }
+  if (sf == radioSf && power == radioPower) return;
+  
+  Radio.SetTxConfig(MODEM_LORA, power, 0, LORA_BANDWIDTH,
+                    sf, LORA_CODINGRATE,
+                    LORA_PREAMBLE_LENGTH, LORA_FIX_LENGTH_PAYLOAD_ON,
+                    true, 0, 0, LORA_IQ_INVERSION_ON, 3000);
+  
+  if (sf != radioSf) {
+    Radio.SetRxConfig(MODEM_LORA, LORA_BANDWIDTH, sf,
+                      LORA_CODINGRATE, 0, LORA_PREAMBLE_LENGTH,
+                      LORA_SYMBOL_TIMEOUT, LORA_FIX_LENGTH_PAYLOAD_ON,
+                      0, true, 0, 0, LORA_IQ_INVERSION_ON, true);
+  }
+  
+  radioSf = sf;
+  radioPower = power;
+  DEBUG_LORA_PRINTLN(String("[LoRa] Radio SF") + sf + " @ " + power + " dBm");
+}
+
+// Home channel at the default data rate - where unsolicited uplinks arrive
+void LoRaComm::applyHomeProfile() {
+  applyRadioProfile(LORA_HOME_CHANNEL, LORA_SPREADING_FACTOR, TX_OUTPUT_POWER);
+}
+
+// Radio already tuned the way talking to node (through its relay) needs
+bool LoRaComm::onProfileOf(uint8_t node) {
+  LoRaNodeLink &l = links[firstHop(node)];
+  return l.channel == radioChannel && l.sf == radioSf;
+}
+
 // ========== Send LoRa Packet ==========
-void LoRaComm::sendRaw(const String &cmd) {
-  snprintf(txBuffer, LORA_BUFFER_SIZE, "%s", cmd.c_str());
-  Serial.printf("[LoRa] TX: %s\n", txBuffer);
+// Starts the transmission and returns; completion arrives via onTxDone()
+bool LoRaComm::sendRaw(const uint8_t *frame, uint16_t len) {
+  if (txBusy) return false;
   
-  txDoneFlag = false;
-  Radio.Send((uint8_t *)txBuffer, strlen(txBuffer));
+  if (len >= LORA_BUFFER_SIZE) len = LORA_BUFFER_SIZE - 1;
+  memcpy(txBuffer, frame, len);
+  txBuffer[len] = '\0';
+  txLen = len;
   
-  // Wait for TX to complete
-  unsigned long start = millis();
-  while (!txDoneFlag && (millis() - start < 3000)) {
-    delay(10);
-    Radio.IrqProcess();
+  LoRaFrame f;
+  if (loraFrameDecode(frame, len, f)) {
+    Serial.printf("[LoRa] TX: [bin %uB] %s MID=%u N=%u I=%u\n",
+                  len, loraOpName(f.op), f.mid, f.node, f.step);
+  } else if (loraFrameIsBinary(frame, len)) {
+    DEBUG_LORA_PRINTLN(String("[LoRa] TX: [bin ") + len + "B] type " + frame[1]);
+  } else {
+    Serial.printf("[LoRa] TX: %s\n", txBuffer);
   }
   
-  if (!txDoneFlag) {
+  txDoneFlag = false;
+  txTimeoutFlag = false;
+  txBusy = true;
+  txStartedAt = millis();
+  Radio.Send((uint8_t *)txBuffer, len);
+  return true;
+}
+
+// Pick up TxDone/TxTimeout signalled by the radio callbacks
+void LoRaComm::updateTxState() {
+  if (!txBusy) return;
+  
+  bool timedOut = txTimeoutFlag || (!txDoneFlag && millis() - txStartedAt >= LORA_TX_TIMEOUT_MS);
+  if (!txDoneFlag && !timedOut) return;
+  
+  if (txDoneFlag) {
+    DEBUG_LORA_PRINTLN("[LoRa] TX Done");
+    noteRadioAlive(false);
+  } else {
     Serial.println("[LoRa] ⚠ TX didn't complete in time");
+    radioFaults++;
+    Radio.Rx(0);
   }
+  captureFrame(LORA_CAP_TX, txDoneFlag ? LORA_CAP_TX_DONE : LORA_CAP_TX_TIMEOUT, txStartedAt,
+               (const uint8_t *)txBuffer, txLen, 0, 0);
+  
+  if (beaconOnAir) {
+    beaconOnAir = false;
+    beaconAt = millis();  // Slots count from here
+  }
+  
+  // ACK timeout runs from the end of the transmission
+  LoRaTxn *t = findTxn(onAirMid);
+  if (t != nullptr) t->sentAt = millis();
+  LoRaGroupTxn *g = findGroup(onAirMid);
+  if (g != nullptr) g->sentAt = millis();
+  
+  onAirMid = 0;
+  txBusy = false;
+  txDoneFlag = false;
+  txTimeoutFlag = false;
 }
 
 // ========== Parse ACK ==========
-bool LoRaComm::parseAck(const char* msg, uint32_t wantMid, const String &wantType,
-                        int wantNode, const String &wantSched, int wantSeqIndex) {
+bool LoRaComm::parseAck(const char* msg, uint32_t wantMid, const char *wantType,
+                        int wantNode, const char *wantSched, int wantSeqIndex) {
   
   if (strncmp(msg, "ACK|", 4) != 0) return false;
   
@@ -132,7 +310,7 @@ bool LoRaComm::parseAck(const char* msg, uint32_t wantMid, const String &wantTyp
   typeBuf[typeLen] = '\0';
   
   // Accept both exact match and PONG (for PING command)
-  if (strcmp(typeBuf, wantType.c_str()) != 0 && strcmp(typeBuf, "PONG") != 0) {
+  if (strcmp(typeBuf, wantType) != 0 && strcmp(typeBuf, "PONG") != 0) {
     return false;
   }
   
@@ -164,151 +342,2207 @@ bool LoRaComm::parseAck(const char* msg, uint32_t wantMid, const String &wantTyp
   
   if (node != wantNode) return false;
   if (idx != wantSeqIndex) return false;
-  if (strcmp(sched, wantSched.c_str()) != 0) return false;
+  if (strcmp(sched, wantSched) != 0) return false;
   if (strstr(pipe3 + 1, "OK") == NULL) return false;
   
   return true;
 }
 
-// ========== Wait for ACK ==========
-bool LoRaComm::waitForAck(int node, const String &type, const String &sched,
-                          int seqIdx, uint32_t mid, uint32_t timeout) {
-  unsigned long start = millis();
+// Binary counterpart of parseAck() - same fields, no text handling
+bool LoRaComm::matchBinaryAck(const LoRaFrame &f, const LoRaTxn &t) {
+  if (f.type != LORA_FT_ACK) return false;
+  if (f.mid != t.mid || f.node != t.node) return false;
   
-  Serial.printf("[LoRa] Waiting ACK: MID=%u, Node=%d, Type=%s\n", mid, node, type.c_str());
+  uint8_t op = loraOpFromName(t.type);
+  if (f.op != op && f.op != LORA_OP_PONG) return false;
+  if (f.schedHash != t.schedHash) return false;
   
-  while (millis() - start < timeout) {
-    Radio.IrqProcess();
-    
-    if (rxFlag) {
-      memcpy(rxBufferSafe, rxBuffer, rxSize);
-      rxBufferSafe[rxSize] = '\0';
-      int16_t rssi = lastRssi;
-      int8_t snr = lastSnr;
-      rxFlag = false;
-      
-      Serial.printf("[LoRa] Check: %s (RSSI=%d, SNR=%d)\n", rxBufferSafe, rssi, snr);
-      
-      if (parseAck(rxBufferSafe, mid, type, node, sched, seqIdx)) {
-        Serial.println("[LoRa] ✓✓✓ ACK MATCHED!");
-        return true;
-      } else {
-        Serial.println("[LoRa] Not matching ACK");
-        
-        // Queue non-ACK messages
-        if (strlen(rxBufferSafe) > 0 && strncmp(rxBufferSafe, "ACK|", 4) != 0) {
-          String msg = String(rxBufferSafe);
-          if (msg.indexOf("SRC=") < 0) msg += ",SRC=LORA";
-          incomingQueue.enqueue(msg);
-        }
+  uint8_t step = (t.seqIndex >= 0 && t.seqIndex < LORA_FRAME_NO_STEP) ? (uint8_t)t.seqIndex : LORA_FRAME_NO_STEP;
+  return f.step == step;
+}
+
+// ========== Transaction Table ==========
+LoRaTxn* LoRaComm::findTxn(uint32_t mid) {
+  for (int i = 0; i < LORA_MAX_TXNS; i++) {
+    if (txns[i].active && txns[i].mid == mid) return &txns[i];
+  }
+  return nullptr;
+}
+
+bool LoRaComm::nodeBusy(uint8_t node) {
+  for (int i = 0; i < LORA_MAX_TXNS; i++) {
+    if (txns[i].active && txns[i].inFlight && txns[i].node == node) return true;
+  }
+  return false;
+}
+
+bool LoRaComm::anyInFlight() {
+  // A bulk frame that expects replies holds the profile like an ACK window
+  if (bulkListenUntil != 0 && (long)(millis() - bulkListenUntil) < 0) return true;
+  for (int i = 0; i < LORA_MAX_TXNS; i++) {
+    if (txns[i].active && txns[i].inFlight) return true;
+  }
+  for (int i = 0; i < LORA_MAX_GROUPS; i++) {
+    if (groups[i].active && groups[i].inFlight) return true;
+  }
+  return false;
+}
+
+bool LoRaComm::isPending(uint32_t mid) {
+  return findTxn(mid) != nullptr;
+}
+
+int LoRaComm::pendingCount() {
+  int count = 0;
+  for (int i = 0; i < LORA_MAX_TXNS; i++) {
+    if (txns[i].active) count++;
+  }
+  for (int i = 0; i < LORA_MAX_GROUPS; i++) {
+    if (groups[i].active) count++;
+  }
+  return count;
+}
+
+void LoRaComm::completeTxn(LoRaTxn &t, LoRaTxnStatus status) {
+  // Free the slot before calling back so the callbacks can queue follow-ups
+  LoRaRequester reqs[LORA_TXN_MAX_REQUESTERS];
+  uint8_t reqCount = t.requesterCount;
+  memcpy(reqs, t.requesters, sizeof(reqs));
+  uint32_t mid = t.mid;
+  int node = t.node;
+  t.active = false;
+  t.inFlight = false;
+  if (status != LORA_TXN_SUPERSEDED) noteDone(t.priority, t.queuedAt);
+  
+  if (status == LORA_TXN_ACKED) {
+    Serial.printf("[LoRa] ✓ MID=%u acked by node %d\n", mid, node);
+  } else if (status == LORA_TXN_SUPERSEDED) {
+    Serial.printf("[LoRa] MID=%u to node %d superseded\n", mid, node);
+  } else {
+    Serial.printf("[LoRa] ✗ MID=%u to node %d failed after %d attempts\n", mid, node, LORA_MAX_RETRIES);
+  }
+  
+  for (uint8_t i = 0; i < reqCount; i++) {
+    if (reqs[i].callback != nullptr) reqs[i].callback(mid, node, status, reqs[i].ctx);
+  }
+}
+
+bool LoRaComm::isValveCommand(const char *type) {
+  return strcmp(type, "OPEN") == 0 || strcmp(type, "CLOSE") == 0 || strcmp(type, "VSET") == 0;
+}
+
+// Match an incoming ACK against every transaction that has been sent
+bool LoRaComm::matchAck(const char *msg, const LoRaFrame *bin, unsigned long rxAt) {
+  if (bin != nullptr && matchGroupAck(*bin)) return true;
+  
+  for (int i = 0; i < LORA_MAX_TXNS; i++) {
+    LoRaTxn &t = txns[i];
+    if (!t.active || t.attempts == 0) continue;
+    bool match = (bin != nullptr) ? matchBinaryAck(*bin, t)
+                                  : parseAck(msg, t.mid, t.type, t.node, t.sched, t.seqIndex);
+    if (match) {
+      // Karn: a retransmitted command's ACK can't be tied to one attempt
+      if (t.attempts == 1 && t.mid != onAirMid) {
+        updateRtt(t.node, rxAt - t.sentAt);
       }
+      links[t.node].failStreak = 0;
+      routeResult(t, true);
+      completeTxn(t, LORA_TXN_ACKED);
+      return true;
     }
+  }
+  Serial.println("[LoRa] ACK matches no pending transaction");
+  return false;
+}
+
+// Retire timed-out attempts and put the next eligible frame on air.
+// Commands to different nodes overlap; a node only ever has one in flight.
+void LoRaComm::serviceTxns() {
+  unsigned long now = millis();
+  
+  for (int i = 0; i < LORA_MAX_TXNS; i++) {
+    LoRaTxn &t = txns[i];
+    if (!t.active || !t.inFlight) continue;
+    if (t.mid == onAirMid) continue;  // Still transmitting
+    if (now - t.sentAt < t.timeoutMs) continue;
     
-    delay(10);
+    t.inFlight = false;
+    ackTimeoutStreak++;
+    backoffRto(t.node);
+    linkTimeout(t.node);
+    routeResult(t, false);
+    if (t.attempts >= LORA_MAX_RETRIES) {
+      completeTxn(t, LORA_TXN_TIMEOUT);
+    } else {
+      uint32_t wait = backoffDelay(t.attempts);
+      Serial.printf("[LoRa] MID=%u timeout, retry in %u ms\n", t.mid, wait);
+      t.nextTxAt = now + wait;
+      retryBackoffs++;
+    }
+  }
+  
+  // Commands whose deadline passed before they got through (mostly sleepy
+  // nodes that didn't wake up in time)
+  for (int i = 0; i < LORA_MAX_TXNS; i++) {
+    LoRaTxn &t = txns[i];
+    if (!t.active || t.inFlight || t.deadline == 0) continue;
+    if (t.mid == cadMid || (long)(now - t.deadline) < 0) continue;
+    Serial.printf("[LoRa] MID=%u %s -> node %d missed its deadline\n", t.mid, t.type, t.node);
+    mailboxExpired++;
+    completeTxn(t, LORA_TXN_TIMEOUT);
+  }
+  
+  serviceGroupTimeouts(now);
+  
+  refillAirtime();
+  if (txBusy || cadMid != 0) return;
+  if (serviceBeacon()) return;
+  bool slotWindow = inSlotWindow(now);
+  
+  // Highest priority first, oldest first within a class (MIDs are allocated
+  // in order). Sends the budget can't cover yet wait for the bucket to refill.
+  // While an ACK is outstanding the receiver stays on that node's channel
+  // and SF, so only nodes on the same pair can overlap with it.
+  // Attempts on air are never cut short; if the best command needs another
+  // channel/SF, lower classes don't start new attempts on the locked pair,
+  // so it takes the radio as soon as the current attempts end.
+  bool locked = anyInFlight();
+  LoRaTxn *next = nullptr;
+  LoRaTxn *waiting = nullptr;   // Best command blocked by the profile lock
+  LoRaPriority nextPrio = LORA_PRIO_COUNT, waitingPrio = LORA_PRIO_COUNT;
+  for (int i = 0; i < LORA_MAX_TXNS; i++) {
+    LoRaTxn &t = txns[i];
+    if (!t.active || t.inFlight) continue;
+    if ((long)(now - t.nextTxAt) < 0) continue;
+    if (nodeBusy(t.node)) continue;
+    if (!inRxWindow(t.node, now)) continue;
+    if (slotWindow && t.priority > LORA_PRIO_OPERATOR) continue;
+    if (!airtimeAvailable(t.priority, t.airtimeMs)) {
+      if (!t.airtimeDeferred) {
+        t.airtimeDeferred = true;
+        airtimeDeferrals++;
+        Serial.printf("[LoRa] Airtime budget low, MID=%u deferred\n", t.mid);
+      }
+      continue;
+    }
+    LoRaPriority prio = effectivePriority(t.priority, t.queuedAt, now);
+    if (locked && !onProfileOf(t.node)) {
+      if (waiting == nullptr || prio < waitingPrio ||
+          (prio == waitingPrio && t.mid < waiting->mid)) {
+        waiting = &t;
+        waitingPrio = prio;
+      }
+      continue;
+    }
+    if (next == nullptr || prio < nextPrio || (prio == nextPrio && t.mid < next->mid)) {
+      next = &t;
+      nextPrio = prio;
+    }
+  }
+  if (waiting != nullptr && next != nullptr && waitingPrio < nextPrio) {
+    if (!waiting->preemptWait) {
+      waiting->preemptWait = true;
+      preemptions++;
+      Serial.printf("[LoRa] MID=%u (%s) waits for in-flight attempts, holding back %s\n",
+                    waiting->mid, priorityName(waitingPrio), priorityName(nextPrio));
+    }
+    next = nullptr;
+  }
+  // A group goes ahead of unicasts of the same or lower priority
+  LoRaGroupTxn *group = nextGroup(now, slotWindow);
+  if (group != nullptr && (next == nullptr || group->priority <= nextPrio)) {
+    applyRadioProfile(group->channel, group->sf, group->power);
+#if LORA_CAD_ENABLED
+    cadMid = group->mid;
+    cadStartedAt = millis();
+    cadDoneFlag = false;
+    cadActivity = false;
+    cadChecks++;
+    Radio.StartCad();
+#else
+    transmitGroup(*group);
+#endif
+    return;
+  }
+  
+  if (next == nullptr) {
+    if (waiting != nullptr) return;  // Keep listening for the in-flight ACKs
+    if (!locked && serviceBulk(now, slotWindow)) return;
+    // Nothing to send - listen for uplinks on the home channel
+    if (!locked && (radioChannel != LORA_HOME_CHANNEL || radioSf != LORA_SPREADING_FACTOR ||
+                    radioPower != TX_OUTPUT_POWER)) {
+      applyHomeProfile();
+      Radio.Rx(0);
+    }
+    return;
   }
   
-  Serial.println("[LoRa] ✗ ACK timeout");
+  // CAD only detects preambles on the channel and SF it runs on
+  uint8_t hop = firstHop(next->node);
+  applyRadioProfile(links[hop].channel, links[hop].sf, links[hop].power);
+  
+#if LORA_CAD_ENABLED
+  // Listen before talk - the frame goes out from updateCadState()
+  cadMid = next->mid;
+  cadStartedAt = millis();
+  cadDoneFlag = false;
+  cadActivity = false;
+  cadChecks++;
+  Radio.StartCad();
+#else
+  transmitTxn(*next);
+#endif
+}
+
+// Sleepy nodes only hear us in the window after their own frames
+bool LoRaComm::inRxWindow(uint8_t node, unsigned long now) {
+  LoRaNodeLink &l = links[node];
+  if (l.rxWindowMs == 0) return true;
+  if (l.wakeAt == 0 || (long)(now - l.wakeAt) < 0) return false;
+  if (now - l.wakeAt < l.rxWindowMs) return true;
+  l.wakeAt = 0;
   return false;
 }
 
-// ========== Send with ACK retry ==========
-bool LoRaComm::sendWithAck(const String &cmdType, int node, const String &schedId,
-                           int seqIndex, uint32_t durationMs) {
+void LoRaComm::transmitTxn(LoRaTxn &t) {
+  if (t.startAt != 0 && encodeTxn(t) < 0) {
+    Serial.printf("[LoRa] ❌ MID=%u no longer fits\n", t.mid);
+    completeTxn(t, LORA_TXN_TIMEOUT);
+    return;
+  }
+  t.attempts++;
+  t.cadDeferrals = 0;
+  t.via = routeFor(t.node);
   
-  if (cmdType.length() > 20 || schedId.length() > 50) {
-    Serial.println("[LoRa] ❌ Parameters too long!");
-    return false;
+  const uint8_t *out = t.frame;
+  uint16_t outLen = t.frameLen;
+  uint8_t wrapped[LORA_BUFFER_SIZE];
+  if (t.via != 0) {
+    LoRaRelayHeader h = { LORA_GATEWAY_ID, t.node, t.via, LORA_GATEWAY_ID, 0, 0 };
+    outLen = (uint16_t)loraRelayEncode(wrapped, sizeof(wrapped), h, t.frame, t.frameLen);
+    if (outLen == 0) {
+      Serial.printf("[LoRa] ⚠ MID=%u too long to relay, sending direct\n", t.mid);
+      t.via = 0;
+      outLen = t.frameLen;
+    } else {
+      out = wrapped;
+    }
   }
   
-  if (node <= 0 || node > 255) {
-    Serial.println("[LoRa] ❌ Invalid node ID!");
-    return false;
+  t.airtimeMs = airtimeMs(outLen, radioSf);
+  if (t.via != 0) {
+    Serial.printf("[LoRa] MID=%u attempt %d/%d (node %d via %d, ch%u SF%u)\n",
+                  t.mid, t.attempts, LORA_MAX_RETRIES, t.node, t.via, radioChannel, radioSf);
+  } else {
+    Serial.printf("[LoRa] MID=%u attempt %d/%d (node %d, ch%u SF%u)\n",
+                  t.mid, t.attempts, LORA_MAX_RETRIES, t.node, radioChannel, radioSf);
+  }
+  if (!sendRaw(out, outLen)) {
+    t.attempts--;
+    return;
   }
+  if (t.attempts == 1) {
+    noteAccess(t.priority, t.queuedAt);
+    if (effectivePriority(t.priority, t.queuedAt, millis()) != t.priority) agedPromotions++;
+  }
+  chargeAirtime(t.priority, t.airtimeMs);
+  channelTx[radioChannel]++;
+  if (links[t.node].rxWindowMs != 0) {
+    // One command per window; the node's ACK opens the next
+    links[t.node].wakeAt = 0;
+    mailboxSent++;
+  }
+  t.timeoutMs = links[t.node].rto;
+  t.inFlight = true;
+  t.sentAt = millis();
+  onAirMid = t.mid;
+}
+
+// Act on a CadDone: transmit on a clear channel, otherwise back off
+void LoRaComm::updateCadState() {
+  if (cadMid == 0) return;
   
-  uint32_t mid = getNextMsgId();
+  bool timedOut = !cadDoneFlag && (millis() - cadStartedAt >= LORA_CAD_TIMEOUT_MS);
+  if (!cadDoneFlag && !timedOut) return;
+  
+  if (cadDoneFlag) noteRadioAlive(false);
+  else radioFaults++;
+  bool busy = cadDoneFlag && cadActivity;
+  LoRaTxn *t = findTxn(cadMid);
+  LoRaGroupTxn *g = findGroup(cadMid);
+  cadMid = 0;
+  cadDoneFlag = false;
+  
+  if (g != nullptr && !g->inFlight) {
+    if (!busy || g->cadDeferrals >= LORA_CAD_MAX_DEFERRALS) {
+      if (busy) cadForced++;
+      transmitGroup(*g);
+      return;
+    }
+    g->cadDeferrals++;
+    cadBusy++;
+    g->nextTxAt = millis() + backoffDelay(g->cadDeferrals);
+    Radio.Rx(0);
+    return;
+  }
   
-  String cmd = String("CMD|MID=") + String(mid) + 
-               String("|") + cmdType + 
-               String("|N=") + String(node) + 
-               String(",S=") + schedId + 
-               String(",I=") + String(seqIndex);
+  if (t == nullptr || t->inFlight) {
+    Radio.Rx(0);
+    return;
+  }
   
-  if (cmdType == "OPEN" && durationMs > 0) {
-    cmd += String(",T=") + String(durationMs);
+  if (!busy) {
+    transmitTxn(*t);
+    return;
   }
   
-  if (cmd.length() >= LORA_BUFFER_SIZE) {
-    Serial.println("[LoRa] ❌ Command too long!");
-    return false;
+  if (t->cadDeferrals >= LORA_CAD_MAX_DEFERRALS) {
+    cadForced++;
+    Serial.printf("[LoRa] ⚠ Channel still busy after %d checks, sending MID=%u anyway\n",
+                  t->cadDeferrals, t->mid);
+    transmitTxn(*t);
+    return;
   }
   
-  uint8_t attempt = 0;
-  while (attempt < LORA_MAX_RETRIES) {
-    Serial.printf("[LoRa] Attempt %d/%d\n", attempt + 1, LORA_MAX_RETRIES);
-    
-    sendRaw(cmd);
+  t->cadDeferrals++;
+  cadBusy++;
+  uint32_t wait = backoffDelay(t->cadDeferrals);
+  t->nextTxAt = millis() + wait;
+  Serial.printf("[LoRa] Channel busy, MID=%u deferred %u ms\n", t->mid, wait);
+  Radio.Rx(0);
+}
+
+// ========== Group Commands ==========
+LoRaGroupTxn* LoRaComm::findGroup(uint32_t mid) {
+  if (mid == 0) return nullptr;
+  for (int i = 0; i < LORA_MAX_GROUPS; i++) {
+    if (groups[i].active && groups[i].mid == mid) return &groups[i];
+  }
+  return nullptr;
+}
+
+int LoRaComm::groupPendingCount(const LoRaGroupTxn &g) {
+  int count = 0;
+  for (int i = 0; i < LORA_GROUP_MAX_BITMAP; i++) {
+    for (uint8_t b = g.pending[i]; b; b &= b - 1) count++;
+  }
+  return count;
+}
+
+// Queue cmdType for every node. Binary-capable nodes reached directly are
+// grouped per channel/SF into one frame each; the rest (and sleepy nodes,
+// which wait in their mailbox) fall back to unicast transactions. The
+// callback runs once per node. Returns how many nodes were queued.
+int LoRaComm::sendGroupAsync(const String &cmdType, const uint8_t *nodes, const int *seqIndex,
+                             uint8_t count, const String &schedId,
+                             LoRaTxnCallback callback, void *ctx, LoRaPriority prio) {
+  uint8_t op = loraOpFromName(cmdType.c_str());
+  uint16_t schedHash = loraSchedHash(schedId.c_str());
+  uint8_t seen[LORA_GROUP_MAX_BITMAP];
+  memset(seen, 0, sizeof(seen));
+  int queued = 0;
+  
+  for (int i = 0; i < count; i++) {
+    uint8_t node = nodes[i];
+    if (node == 0 || (seen[node / 8] & (1 << (node % 8)))) continue;
+    seen[node / 8] |= 1 << (node % 8);
+    LoRaNodeLink &l = links[node];
     
-    if (waitForAck(node, cmdType, schedId, seqIndex, mid, LORA_ACK_TIMEOUT_MS)) {
-      Serial.println("[LoRa] ✓✓✓ SUCCESS!");
-      return true;
+    LoRaGroupTxn *g = nullptr;
+#if LORA_BINARY_FRAMES
+    if (op != LORA_OP_NONE && l.binary && l.rxWindowMs == 0 && routeFor(node) == 0) {
+      // Join a group still being filled for the same channel/SF
+      for (int k = 0; k < LORA_MAX_GROUPS && g == nullptr; k++) {
+        LoRaGroupTxn &c = groups[k];
+        if (c.active && c.attempts == 0 && c.op == op && c.schedHash == schedHash &&
+            c.channel == l.channel && c.sf == l.sf && c.callback == callback && c.ctx == ctx) {
+          g = &c;
+        }
+      }
+      for (int k = 0; k < LORA_MAX_GROUPS && g == nullptr; k++) {
+        if (groups[k].active) continue;
+        g = &groups[k];
+        memset(g, 0, sizeof(*g));
+        g->active = true;
+        g->mid = getNextMsgId();
+        g->op = op;
+        g->schedHash = schedHash;
+        g->priority = prio;
+        g->channel = l.channel;
+        g->sf = l.sf;
+        g->power = l.power;
+        g->slotMs = airtimeMs(LORA_FRAME_MIN_LEN, l.sf) + LORA_GROUP_SLOT_GUARD_MS;
+        g->nextTxAt = millis();
+        g->queuedAt = g->nextTxAt;
+        g->callback = callback;
+        g->ctx = ctx;
+      }
     }
+#endif
     
-    attempt++;
-    if (attempt < LORA_MAX_RETRIES) {
-      Serial.println("[LoRa] Retry...");
-      delay(300);
+    if (g != nullptr) {
+      g->pending[node / 8] |= 1 << (node % 8);
+      if (l.power > g->power) g->power = l.power;
+      queued++;
+    } else if (sendAsync(cmdType, node, schedId, seqIndex ? seqIndex[i] : 0, 0,
+                         callback, ctx, prio) != 0) {
+      queued++;
     }
   }
   
-  Serial.printf("[LoRa] ✗✗✗ FAILED after %d attempts\n", LORA_MAX_RETRIES);
-  return false;
+  for (int k = 0; k < LORA_MAX_GROUPS; k++) {
+    LoRaGroupTxn &g = groups[k];
+    if (g.active && g.attempts == 0) {
+      Serial.printf("[LoRa] Queued group MID=%u %s -> %d nodes (ch%u SF%u)\n",
+                    g.mid, cmdType.c_str(), groupPendingCount(g), g.channel, g.sf);
+    }
+  }
+  return queued;
 }
 
-// ========== Process Incoming ==========
-void LoRaComm::processIncoming() {
-  Radio.IrqProcess();
+void LoRaComm::transmitGroup(LoRaGroupTxn &g) {
+  int first = -1, last = -1;
+  for (int n = 0; n < LORA_MAX_NODES; n++) {
+    if (g.pending[n / 8] & (1 << (n % 8))) {
+      if (first < 0) first = n;
+      last = n;
+    }
+  }
+  if (first < 0) return;
   
-  if (rxFlag) {
-    memcpy(rxBufferSafe, rxBuffer, rxSize);
-    rxBufferSafe[rxSize] = '\0';
-    int16_t rssi = lastRssi;
-    int8_t snr = lastSnr;
-    rxFlag = false;
-    
-    if (strlen(rxBufferSafe) == 0) return;
-    
-    Serial.printf("[LoRa] ✓ RX: %s (RSSI=%d, SNR=%d)\n", rxBufferSafe, rssi, snr);
+  // Bitmap relative to the lowest pending node
+  uint8_t bitmap[LORA_GROUP_MAX_BITMAP];
+  memset(bitmap, 0, sizeof(bitmap));
+  for (int n = first; n <= last; n++) {
+    if (g.pending[n / 8] & (1 << (n % 8))) bitmap[(n - first) / 8] |= 1 << ((n - first) % 8);
+  }
+  
+  LoRaGroupFrame f;
+  f.op = g.op;
+  f.mid = g.mid;
+  f.schedHash = g.schedHash;
+  f.slotMs = g.slotMs;
+  f.base = (uint8_t)first;
+  f.bitmapLen = (uint8_t)((last - first) / 8 + 1);
+  f.bitmap = bitmap;
+  
+  uint8_t frame[LORA_BUFFER_SIZE];
+  size_t len = loraGroupEncode(frame, sizeof(frame), f);
+  if (len == 0) return;
+  
+  int members = groupPendingCount(g);
+  g.attempts++;
+  g.cadDeferrals = 0;
+  Serial.printf("[LoRa] Group MID=%u attempt %d/%d (%d nodes, ch%u SF%u)\n",
+                g.mid, g.attempts, LORA_MAX_RETRIES, members, radioChannel, radioSf);
+  if (!sendRaw(frame, (uint16_t)len)) {
+    g.attempts--;
+    return;
+  }
+  if (g.attempts == 1) noteAccess(g.priority, g.queuedAt);
+  
+  uint32_t airtime = airtimeMs((uint16_t)len, radioSf);
+  chargeAirtime(g.priority, airtime);
+  channelTx[radioChannel]++;
+  g.timeoutMs = (uint32_t)members * g.slotMs + LORA_RTO_MIN_MS;
+  g.inFlight = true;
+  g.sentAt = millis();
+  onAirMid = g.mid;
+}
+
+// Member ACK: clear its bit, report it, finish the group once all are in
+bool LoRaComm::matchGroupAck(const LoRaFrame &f) {
+  LoRaGroupTxn *g = findGroup(f.mid);
+  if (g == nullptr || f.type != LORA_FT_ACK) return false;
+  if (f.op != g->op || f.schedHash != g->schedHash) return true;
+  if (!(g->pending[f.node / 8] & (1 << (f.node % 8)))) return true;  // Repeat ACK
+  
+  g->pending[f.node / 8] &= ~(1 << (f.node % 8));
+  links[f.node].failStreak = 0;
+  Serial.printf("[LoRa] ✓ Group MID=%u acked by node %u\n", g->mid, f.node);
+  
+  LoRaTxnCallback cb = g->callback;
+  void *ctx = g->ctx;
+  uint32_t mid = g->mid;
+  if (groupPendingCount(*g) == 0) {
+    g->active = false;
+    g->inFlight = false;
+    noteDone(g->priority, g->queuedAt);
+  }
+  if (cb != nullptr) cb(mid, f.node, LORA_TXN_ACKED, ctx);
+  return true;
+}
+
+// Reply window over: resend to the members still missing, or give up on them
+void LoRaComm::serviceGroupTimeouts(unsigned long now) {
+  for (int i = 0; i < LORA_MAX_GROUPS; i++) {
+    LoRaGroupTxn &g = groups[i];
+    if (!g.active || !g.inFlight) continue;
+    if (g.mid == onAirMid) continue;
+    if (now - g.sentAt < g.timeoutMs) continue;
     
-    // Skip ACKs (handled in waitForAck)
-    if (strncmp(rxBufferSafe, "ACK|", 4) == 0) {
-      Serial.println("[LoRa] ACK (handled in waitForAck)");
-      return;
+    g.inFlight = false;
+    int missing = groupPendingCount(g);
+    if (g.attempts < LORA_MAX_RETRIES) {
+      Serial.printf("[LoRa] Group MID=%u: %d node(s) missing, retrying them\n", g.mid, missing);
+      g.nextTxAt = now + backoffDelay(g.attempts);
+      retryBackoffs++;
+      continue;
     }
     
-    String payload = String(rxBufferSafe);
-    
-    // Accept STAT messages
-    if (payload.startsWith("STAT|")) {
-      Serial.println("[LoRa] ✓ STAT message - QUEUING!");
-      if (payload.indexOf("SRC=") < 0) payload += ",SRC=LORA";
-      incomingQueue.enqueue(payload);
-      Serial.println("[LoRa] ✓ Queued STAT");
-      return;
+    Serial.printf("[LoRa] ✗ Group MID=%u: %d node(s) never acked\n", g.mid, missing);
+    g.active = false;
+    noteDone(g.priority, g.queuedAt);
+    for (int n = 1; n < LORA_MAX_NODES; n++) {
+      if (!(g.pending[n / 8] & (1 << (n % 8)))) continue;
+      linkTimeout((uint8_t)n);
+      if (g.callback != nullptr) g.callback(g.mid, n, LORA_TXN_TIMEOUT, g.ctx);
     }
-    
-    // Accept AUTO_CLOSE
-    if (payload.startsWith("AUTO_CLOSE|")) {
-      Serial.println("[LoRa] ✓ AUTO_CLOSE - QUEUING!");
-      if (payload.indexOf("SRC=") < 0) payload += ",SRC=LORA";
-      incomingQueue.enqueue(payload);
-      Serial.println("[LoRa] ✓ Queued AUTO_CLOSE");
-      return;
+  }
+}
+
+// Groups need the channel to themselves for the reply window, so one only
+// starts when nothing else is in flight
+LoRaGroupTxn* LoRaComm::nextGroup(unsigned long now, bool slotWindow) {
+  if (anyInFlight()) return nullptr;
+  
+  LoRaGroupTxn *best = nullptr;
+  for (int i = 0; i < LORA_MAX_GROUPS; i++) {
+    LoRaGroupTxn &g = groups[i];
+    if (!g.active || g.inFlight) continue;
+    if ((long)(now - g.nextTxAt) < 0) continue;
+    if (slotWindow && g.priority > LORA_PRIO_OPERATOR) continue;
+    uint32_t estimate = airtimeMs(LORA_GROUP_HEADER_LEN + LORA_GROUP_MAX_BITMAP + 2, g.sf);
+    if (!airtimeAvailable(g.priority, estimate)) continue;
+    if (best == nullptr || g.priority < best->priority ||
+        (g.priority == best->priority && g.mid < best->mid)) {
+      best = &g;
+    }
+  }
+  return best;
+}
+
+// Binary exponential backoff: a random wait in [W/2, W] with
+// W = LORA_BACKOFF_BASE_MS * 2^(round-1), capped at LORA_BACKOFF_MAX_MS
+uint32_t LoRaComm::backoffDelay(uint8_t round) {
+  uint32_t window = LORA_BACKOFF_BASE_MS;
+  for (uint8_t i = 1; i < round && window < LORA_BACKOFF_MAX_MS; i++) {
+    window *= 2;
+  }
+  if (window > LORA_BACKOFF_MAX_MS) window = LORA_BACKOFF_MAX_MS;
+  return window / 2 + (uint32_t)random(window / 2 + 1);
+}
+
+// ========== Airtime Budget ==========
+// Time on air per Semtech AN1200.13 for the configured bandwidth, coding
+// rate, preamble, explicit header and CRC on
+uint32_t LoRaComm::airtimeMs(uint16_t payloadLen, uint8_t sf) {
+  uint32_t bwHz = (LORA_BANDWIDTH == 2) ? 500000UL : (LORA_BANDWIDTH == 1) ? 250000UL : 125000UL;
+  uint32_t symbolUs = (uint32_t)(((uint64_t)1 << sf) * 1000000ULL / bwHz);
+  int de = (symbolUs > 16000) ? 1 : 0;   // Low data rate optimize
+  int cr = LORA_CODINGRATE;              // 1..4 = 4/5..4/8
+  
+  int32_t num = 8 * (int32_t)payloadLen - 4 * sf + 28 + 16;  // CRC on, explicit header
+  int32_t den = 4 * (sf - 2 * de);
+  int32_t blocks = (num > 0) ? (num + den - 1) / den : 0;
+  uint32_t payloadSymbols = 8 + blocks * (cr + 4);
+  
+  // Preamble is (n + 4.25) symbols
+  uint32_t totalUs = (uint32_t)((LORA_PREAMBLE_LENGTH * 4 + 17) * (uint64_t)symbolUs / 4) +
+                     payloadSymbols * symbolUs;
+  return (totalUs + 999) / 1000;
+}
+
+LoRaPriority LoRaComm::commandPriority(const String &cmdType) {
+  if (cmdType == "OPEN" || cmdType == "CLOSE" || cmdType == "VSET") return LORA_PRIO_OPERATOR;
+  return LORA_PRIO_DIAG;
+}
+
+void LoRaComm::refillAirtime() {
+  unsigned long now = millis();
+  
+  if (airtimeRefillAt == 0) {
+    airtimeRefillAt = now;
+    airtimeHourStart = now;
+    return;
+  }
+  
+  unsigned long elapsed = now - airtimeRefillAt;
+  if (elapsed > 0) {
+    uint64_t tokens = airtimeTokensUs +
+                      (uint64_t)elapsed * LORA_AIRTIME_BUDGET_MS_PER_HOUR * 1000ULL / 3600000ULL;
+    uint64_t cap = (uint64_t)LORA_AIRTIME_BURST_MS * 1000ULL;
+    airtimeTokensUs = (uint32_t)(tokens > cap ? cap : tokens);
+    airtimeRefillAt = now;
+  }
+  
+  if (now - airtimeHourStart >= 3600000UL) {
+    uint32_t total = 0;
+    for (int p = 0; p < LORA_PRIO_COUNT; p++) {
+      airtimeLastHourMs[p] = airtimeHourMs[p];
+      total += airtimeHourMs[p];
+      airtimeHourMs[p] = 0;
+    }
+    beaconLastHourMs = beaconHourMs;
+    total += beaconHourMs;
+    beaconHourMs = 0;
+    airtimeHourStart = now;
+    Serial.printf("[LoRa] Airtime last hour: %u ms "
+                  "(safety=%u sched=%u op=%u diag=%u bulk=%u beacon=%u)\n",
+                  total, airtimeLastHourMs[LORA_PRIO_SAFETY], airtimeLastHourMs[LORA_PRIO_SCHEDULE],
+                  airtimeLastHourMs[LORA_PRIO_OPERATOR], airtimeLastHourMs[LORA_PRIO_DIAG],
+                  airtimeLastHourMs[LORA_PRIO_BULK], beaconLastHourMs);
+  }
+}
+
+bool LoRaComm::airtimeAvailable(LoRaPriority prio, uint32_t airtimeMs) {
+  if (prio == LORA_PRIO_SAFETY) return true;  // A stop goes out even on an empty bucket
+  uint32_t reserveMs = 0;
+  if (prio == LORA_PRIO_OPERATOR) reserveMs = LORA_AIRTIME_OPERATOR_RESERVE_MS;
+  else if (prio == LORA_PRIO_DIAG) reserveMs = LORA_AIRTIME_DIAG_RESERVE_MS;
+  else if (prio == LORA_PRIO_BULK) reserveMs = LORA_AIRTIME_BULK_RESERVE_MS;
+  return airtimeTokensUs >= (airtimeMs + reserveMs) * 1000UL;
+}
+
+void LoRaComm::chargeAirtime(LoRaPriority prio, uint32_t airtimeMs) {
+  uint32_t cost = airtimeMs * 1000UL;
+  airtimeTokensUs = (airtimeTokensUs > cost) ? airtimeTokensUs - cost : 0;
+  airtimeHourMs[prio] += airtimeMs;
+}
+
+// Beacons spend tokens like any frame but are network overhead, not any
+// class's traffic
+void LoRaComm::chargeBeacon(uint32_t airtimeMs) {
+  uint32_t cost = airtimeMs * 1000UL;
+  airtimeTokensUs = (airtimeTokensUs > cost) ? airtimeTokensUs - cost : 0;
+  beaconHourMs += airtimeMs;
+}
+
+uint32_t LoRaComm::airtimeBudgetMs() {
+  refillAirtime();
+  return airtimeTokensUs / 1000;
+}
+
+String LoRaComm::airtimeReport() {
+  refillAirtime();
+  uint32_t hour = 0, lastHour = 0;
+  for (int p = 0; p < LORA_PRIO_COUNT; p++) {
+    hour += airtimeHourMs[p];
+    lastHour += airtimeLastHourMs[p];
+  }
+  hour += beaconHourMs;
+  lastHour += beaconLastHourMs;
+  return "hour=" + String(hour) + "ms (safety=" + String(airtimeHourMs[LORA_PRIO_SAFETY]) +
+         " sched=" + String(airtimeHourMs[LORA_PRIO_SCHEDULE]) +
+         " op=" + String(airtimeHourMs[LORA_PRIO_OPERATOR]) +
+         " diag=" + String(airtimeHourMs[LORA_PRIO_DIAG]) +
+         " bulk=" + String(airtimeHourMs[LORA_PRIO_BULK]) +
+         " beacon=" + String(beaconHourMs) + ") lastHour=" + String(lastHour) +
+         "ms budget=" + String(airtimeTokensUs / 1000) + "ms deferred=" + String(airtimeDeferrals) +
+         " refused=" + String(airtimeRefusals);
+}
+
+// ========== Radio Arbitration ==========
+const char* LoRaComm::priorityName(LoRaPriority prio) {
+  switch (prio) {
+    case LORA_PRIO_SAFETY: return "safety";
+    case LORA_PRIO_SCHEDULE: return "sched";
+    case LORA_PRIO_OPERATOR: return "op";
+    case LORA_PRIO_DIAG: return "diag";
+    case LORA_PRIO_BULK: return "bulk";
+    default: return "?";
+  }
+}
+
+// Class used for ordering: one step up after LORA_PRIO_AGING_MS waited.
+// Only one step, so an operator command can catch up with schedule steps
+// but a diagnostic never can.
+LoRaPriority LoRaComm::effectivePriority(LoRaPriority prio, unsigned long queuedAt,
+                                         unsigned long now) {
+  if (prio <= LORA_PRIO_SCHEDULE) return prio;
+  if (now - queuedAt < LORA_PRIO_AGING_MS) return prio;
+  return (LoRaPriority)(prio - 1);
+}
+
+void LoRaComm::noteAccess(LoRaPriority prio, unsigned long queuedAt) {
+  LoRaClassStats &c = classStats[prio];
+  uint32_t ms = millis() - queuedAt;
+  c.sent++;
+  c.accessSumMs += ms;
+  if (ms > c.accessMaxMs) c.accessMaxMs = ms;
+}
+
+void LoRaComm::noteDone(LoRaPriority prio, unsigned long queuedAt) {
+  LoRaClassStats &c = classStats[prio];
+  uint32_t ms = millis() - queuedAt;
+  c.done++;
+  c.doneSumMs += ms;
+  if (ms > c.doneMaxMs) c.doneMaxMs = ms;
+}
+
+// "sched=12 access=40/310ms done=820/2400ms ..." - avg/max per class
+String LoRaComm::priorityReport() {
+  String out;
+  for (int p = 0; p < LORA_PRIO_COUNT; p++) {
+    const LoRaClassStats &c = classStats[p];
+    if (p) out += " ";
+    out += String(priorityName((LoRaPriority)p)) + "=" + String(c.sent);
+    if (c.sent > 0) {
+      out += " access=" + String(c.accessSumMs / c.sent) + "/" + String(c.accessMaxMs) + "ms";
+    }
+    if (c.done > 0) {
+      out += " done=" + String(c.doneSumMs / c.done) + "/" + String(c.doneMaxMs) + "ms";
     }
-    
-    // Accept any other message
-    Serial.println("[LoRa] ✓ Generic message - QUEUING!");
-    if (payload.indexOf("SRC=") < 0) payload += ",SRC=LORA";
-    incomingQueue.enqueue(payload);
-    Serial.println("[LoRa] ✓ Queued");
   }
+  return out + " preempt=" + String(preemptions) + " aged=" + String(agedPromotions);
+}
+
+// ========== RTT Estimation ==========
+// Jacobson/Karels: SRTT += (R - SRTT)/8, RTTVAR += (|R - SRTT| - RTTVAR)/4,
+// RTO = SRTT + 4*RTTVAR, clamped to [LORA_RTO_MIN_MS, LORA_RTO_MAX_MS]
+void LoRaComm::updateRtt(uint8_t node, uint32_t sample) {
+  LoRaNodeLink &l = links[node];
+  
+  if (l.rttSamples == 0) {
+    l.srtt = sample;
+    l.rttvar = sample / 2;
+  } else {
+    uint32_t err = (sample > l.srtt) ? sample - l.srtt : l.srtt - sample;
+    l.rttvar = (3 * l.rttvar + err) / 4;
+    l.srtt = (7 * l.srtt + sample) / 8;
+  }
+  if (l.rttSamples < UINT16_MAX) l.rttSamples++;
+  
+  uint32_t rto = l.srtt + 4 * l.rttvar;
+  if (rto < LORA_RTO_MIN_MS) rto = LORA_RTO_MIN_MS;
+  if (rto > LORA_RTO_MAX_MS) rto = LORA_RTO_MAX_MS;
+  l.rto = rto;
+  
+  DEBUG_LORA_PRINTLN(String("[LoRa] Node ") + node + " RTT=" + sample + " SRTT=" + l.srtt + " RTO=" + l.rto);
+}
+
+// Timeout: double the node's RTO until a clean sample resets it
+void LoRaComm::backoffRto(uint8_t node) {
+  LoRaNodeLink &l = links[node];
+  l.rto = (l.rto * 2 > LORA_RTO_MAX_MS) ? LORA_RTO_MAX_MS : l.rto * 2;
+  if (l.timeouts < UINT16_MAX) l.timeouts++;
+}
+
+// Forget RTT history, e.g. when the node's data rate changes
+void LoRaComm::resetRtt(uint8_t node) {
+  LoRaNodeLink &l = links[node];
+  l.srtt = 0;
+  l.rttvar = 0;
+  l.rttSamples = 0;
+  l.rto = LORA_ACK_TIMEOUT_MS;
+}
+
+uint32_t LoRaComm::getRto(int node) {
+  if (node <= 0 || node >= LORA_MAX_NODES) return LORA_ACK_TIMEOUT_MS;
+  return links[node].rto;
+}
+
+// "N4:412/38/600 N7:..." - SRTT/RTTVAR/RTO in ms for nodes with samples
+String LoRaComm::rttReport(int maxNodes) {
+  String out = "";
+  int listed = 0;
+  for (int n = 1; n < LORA_MAX_NODES && listed < maxNodes; n++) {
+    LoRaNodeLink &l = links[n];
+    if (l.rttSamples == 0 && l.timeouts == 0) continue;
+    if (out.length()) out += " ";
+    out += "N" + String(n) + ":" + String(l.srtt) + "/" + String(l.rttvar) + "/" + String(l.rto);
+    listed++;
+  }
+  return out.length() ? out : String("none");
+}
+
+String LoRaComm::statsReport() {
+  return "CAD=" + String(cadChecks) + " busy=" + String(cadBusy) +
+         " forced=" + String(cadForced) + " retryBackoff=" + String(retryBackoffs) +
+         " coalesced=" + String(coalesced) + " superseded=" + String(superseded) +
+         " bulk=" + String(bulkSent) +
+         " rxDropped=" + String((uint32_t)rxDropped) + " adr=" + String(adrChanges) +
+         " fallback=" + String(adrFallbacks) + " dupHit=" + String(dupHits) +
+         " dupMiss=" + String(dupMisses) + " " + channelReport();
+}
+
+// "ch=12/9/8/11/10" - transmissions per channel
+String LoRaComm::channelReport() {
+  String out = "ch=";
+  for (int c = 0; c < LORA_CHANNEL_COUNT; c++) {
+    if (c) out += "/";
+    out += String(channelTx[c]);
+  }
+  return out;
+}
+
+// ========== Link Quality / Adaptive Data Rate ==========
+// Node ID from the "N=" field every node frame carries, -1 if absent
+int LoRaComm::frameNode(const char *msg) {
+  const char *p = msg;
+  while ((p = strstr(p, "N=")) != NULL) {
+    if (p > msg && (p[-1] == '|' || p[-1] == ',')) {
+      int node = atoi(p + 2);
+      return (node > 0 && node < LORA_MAX_NODES) ? node : -1;
+    }
+    p += 2;
+  }
+  return -1;
+}
+
+// Demodulation floor (dB) per spreading factor, SX127x datasheet
+int LoRaComm::requiredSnr(uint8_t sf) {
+  static const int8_t floorDb[] = { -7, -10, -12, -15, -17, -20 };  // SF7..SF12
+  if (sf < 7) sf = 7;
+  if (sf > 12) sf = 12;
+  return floorDb[sf - 7];
+}
+
+// Every frame from a node: link stats for direct ones, then the registry.
+// A sleepy node listens for a while after each direct frame.
+void LoRaComm::noteHeard(int node, int16_t rssi, int8_t snr, uint8_t via, unsigned long rxAt) {
+  if (node <= 0 || node >= LORA_MAX_NODES) return;
+  if (via == 0) recordLink(node, rssi, snr);
+  if (via == 0 && links[node].rxWindowMs != 0) links[node].wakeAt = rxAt + LORA_SLEEPY_RX_DELAY_MS;
+  if (seenHandler != nullptr) seenHandler((uint8_t)node, rssi, snr, via, seenCtx);
+}
+
+void LoRaComm::recordLink(int node, int16_t rssi, int8_t snr) {
+  if (node <= 0 || node >= LORA_MAX_NODES) return;
+  LoRaNodeLink &l = links[node];
+  l.directRssi = rssi;
+  l.directAt = millis();
+  
+  l.snrHist[l.histPos] = snr;
+  l.rssiHist[l.histPos] = rssi;
+  l.histPos = (l.histPos + 1) % LORA_LINK_HISTORY;
+  if (l.histCount < LORA_LINK_HISTORY) l.histCount++;
+  
+  int snrBin = (constrain((int)snr, -20, 19) + 20) / 5;
+  int rssiBin = (constrain((int)rssi, -130, -51) + 130) / 10;
+  if (l.snrBins[snrBin] < UINT16_MAX) l.snrBins[snrBin]++;
+  if (l.rssiBins[rssiBin] < UINT16_MAX) l.rssiBins[rssiBin]++;
+  
+#if LORA_ADR_ENABLED
+  adrEvaluate(node);
+#endif
+}
+
+// Consecutive timeouts: drop the node back to the data rate it boots on
+void LoRaComm::linkTimeout(uint8_t node) {
+  LoRaNodeLink &l = links[node];
+  if (l.failStreak < UINT8_MAX) l.failStreak++;
+  if (l.failStreak < LORA_ADR_FALLBACK_TIMEOUTS) return;
+  
+  if (l.binary) {
+    // Relearned from the node's next binary frame
+    Serial.printf("[LoRa] ⚠ Node %d: %d timeouts, back to ASCII frames\n", node, l.failStreak);
+    l.binary = false;
+  }
+  if (l.sf == LORA_SPREADING_FACTOR && l.power == TX_OUTPUT_POWER) return;
+  
+  Serial.printf("[LoRa] ⚠ Node %d: %d timeouts at SF%u, back to SF%u @ %d dBm\n",
+                node, l.failStreak, l.sf, LORA_SPREADING_FACTOR, TX_OUTPUT_POWER);
+  l.sf = LORA_SPREADING_FACTOR;
+  l.power = TX_OUTPUT_POWER;
+  l.histCount = 0;
+  l.histPos = 0;
+  l.drChangedAt = millis();
+  l.failStreak = 0;
+  adrFallbacks++;
+}
+
+// LoRaWAN-style ADR: spend the SNR headroom above floor + margin in 3 dB
+// steps, first on lower SF, then on lower power; a deficit raises power
+// first, then SF. Changes go to the node as a SETDR command on the current
+// data rate and take effect once it is acked.
+void LoRaComm::adrEvaluate(int node) {
+  LoRaNodeLink &l = links[node];
+  if (l.drMid != 0 || l.histCount < LORA_LINK_HISTORY) return;
+  if (l.drChangedAt != 0 && millis() - l.drChangedAt < LORA_ADR_HOLD_MS) return;
+  
+  int maxSnr = l.snrHist[0];
+  for (int i = 1; i < LORA_LINK_HISTORY; i++) {
+    if (l.snrHist[i] > maxSnr) maxSnr = l.snrHist[i];
+  }
+  
+  int margin = maxSnr - requiredSnr(l.sf) - LORA_ADR_MARGIN_DB;
+  int steps = (margin >= 0) ? margin / 3 : -((-margin + 2) / 3);
+  int sf = l.sf;
+  int power = l.power;
+  
+  while (steps > 0 && sf > LORA_ADR_MIN_SF) { sf--; steps--; }
+  while (steps > 0 && power > LORA_ADR_MIN_POWER) {
+    power = max(power - 3, LORA_ADR_MIN_POWER);
+    steps--;
+  }
+  while (steps < 0 && power < TX_OUTPUT_POWER) {
+    power = min(power + 3, TX_OUTPUT_POWER);
+    steps++;
+  }
+  while (steps < 0 && sf < LORA_ADR_MAX_SF) { sf++; steps++; }
+  
+  if (sf == l.sf && power == l.power) return;
+  
+  l.pendingSf = (uint8_t)sf;
+  l.pendingPower = (int8_t)power;
+  l.drChangedAt = millis();  // Also rate-limits a refused SETDR
+  Serial.printf("[LoRa] Node %d: max SNR %d dB, SF%u @ %d dBm -> SF%d @ %d dBm\n",
+                node, maxSnr, l.sf, l.power, sf, power);
+  l.drMid = sendAsync("SETDR", node, "", 0, 0, onSetDrResult, this, LORA_PRIO_DIAG);
+}
+
+void LoRaComm::onSetDrResult(uint32_t mid, int node, LoRaTxnStatus status, void *ctx) {
+  LoRaComm *self = (LoRaComm *)ctx;
+  LoRaNodeLink &l = self->links[node];
+  if (l.drMid != mid) return;
+  l.drMid = 0;
+  l.drChangedAt = millis();
+  
+  if (status != LORA_TXN_ACKED) {
+    Serial.printf("[LoRa] Node %d kept SF%u (SETDR not acked)\n", node, l.sf);
+    return;
+  }
+  
+  l.sf = l.pendingSf;
+  l.power = l.pendingPower;
+  l.histCount = 0;  // Re-measure at the new power
+  l.histPos = 0;
+  self->resetRtt(node);
+  self->adrChanges++;
+  Serial.printf("[LoRa] ✓ Node %d now on SF%u @ %d dBm\n", node, l.sf, l.power);
+}
+
+// "N4:ch4/SF7/2dBm snr=9 rssi=-81 ..." - channel, data rate, last sample
+String LoRaComm::linkReport(int maxNodes) {
+  String out = "";
+  int listed = 0;
+  for (int n = 1; n < LORA_MAX_NODES && listed < maxNodes; n++) {
+    LoRaNodeLink &l = links[n];
+    if (l.histCount == 0 && l.via == 0 &&
+        l.sf == LORA_SPREADING_FACTOR && l.power == TX_OUTPUT_POWER) continue;
+    if (out.length()) out += " ";
+    out += "N" + String(n) + ":ch" + String(l.channel) + "/SF" + String(l.sf) + "/" + String(l.power) + "dBm";
+    if (l.via != 0) out += " via N" + String(l.via);
+    if (l.histCount > 0) {
+      int last = (l.histPos + LORA_LINK_HISTORY - 1) % LORA_LINK_HISTORY;
+      out += " snr=" + String(l.snrHist[last]) + " rssi=" + String(l.rssiHist[last]);
+    }
+    listed++;
+  }
+  return out.length() ? out : String("none");
+}
+
+// "SNR -20:0 -15:3 ... RSSI -130:0 -120:1 ..." - bins by lower edge
+String LoRaComm::linkHistogram(int node) {
+  if (node <= 0 || node >= LORA_MAX_NODES) return String("invalid node");
+  LoRaNodeLink &l = links[node];
+  String out = "SNR";
+  for (int b = 0; b < LORA_LINK_BINS; b++) {
+    out += " " + String(-20 + b * 5) + ":" + String(l.snrBins[b]);
+  }
+  out += " RSSI";
+  for (int b = 0; b < LORA_LINK_BINS; b++) {
+    out += " " + String(-130 + b * 10) + ":" + String(l.rssiBins[b]);
+  }
+  return out;
+}
+
+// ========== Queue Command (non-blocking) ==========
+uint32_t LoRaComm::sendAsync(const String &cmdType, int node, const String &schedId,
+                             int seqIndex, uint32_t durationMs,
+                             LoRaTxnCallback callback, void *ctx, LoRaPriority prio,
+                             const uint8_t *params, uint8_t paramsLen,
+                             unsigned long startAt, unsigned long deadline) {
+  
+  if (cmdType.length() >= LORA_TXN_TYPE_LEN || schedId.length() >= LORA_TXN_SCHED_LEN ||
+      paramsLen > LORA_FRAME_MAX_PARAMS - (startAt != 0 ? LORA_FRAME_DELAY_LEN : 0)) {
+    Serial.println("[LoRa] ❌ Parameters too long!");
+    return 0;
+  }
+  
+  if (node <= 0 || node > 255) {
+    Serial.println("[LoRa] ❌ Invalid node ID!");
+    return 0;
+  }
+  
+  // Coalesce with commands to this node that aren't on air right now: an
+  // identical one gains another requester, even while it waits for a retry.
+  // An older valve command is replaced only if it has never gone on air,
+  // because the last valve state wins; one the node may already have acted
+  // on runs to its result. A timed command only replaces one for the same
+  // start; an immediate one replaces them all.
+  LoRaTxn *replaced[LORA_MAX_TXNS];
+  int replacedCount = 0;
+  for (int i = 0; i < LORA_MAX_TXNS; i++) {
+    LoRaTxn &t = txns[i];
+    if (!t.active || t.node != node || t.inFlight) continue;
+    if (t.mid == cadMid || t.mid == onAirMid) continue;
+    if (cmdType == "SETDR" || strcmp(t.type, "SETDR") == 0) continue;
+    
+    bool same = cmdType == t.type && schedId == t.sched && seqIndex == t.seqIndex &&
+                durationMs == t.durationMs && paramsLen == t.paramsLen &&
+                (paramsLen == 0 || memcmp(params, t.params, paramsLen) == 0) &&
+                startAt == t.startAt;
+    if (same && t.requesterCount < LORA_TXN_MAX_REQUESTERS) {
+      t.requesters[t.requesterCount].callback = callback;
+      t.requesters[t.requesterCount].ctx = ctx;
+      t.requesterCount++;
+      if (prio < t.priority) t.priority = prio;
+      if (deadline != 0 && (t.deadline == 0 || (long)(deadline - t.deadline) < 0)) {
+        t.deadline = deadline;
+      }
+      coalesced++;
+      Serial.printf("[LoRa] %s -> node %d merged into MID=%u (%d requesters)\n",
+                    cmdType.c_str(), node, t.mid, t.requesterCount);
+      return t.mid;
+    }
+    if (!same && t.attempts == 0 && isValveCommand(cmdType.c_str()) &&
+        isValveCommand(t.type) && (startAt == 0 || startAt == t.startAt)) {
+      replaced[replacedCount++] = &t;
+    }
+  }
+  
+  LoRaTxn *slot = nullptr;
+  for (int i = 0; i < LORA_MAX_TXNS; i++) {
+    if (!txns[i].active) {
+      slot = &txns[i];
+      break;
+    }
+  }
+  if (slot == nullptr) {
+    Serial.println("[LoRa] ❌ Transaction table full!");
+    tableFull++;
+    return 0;
+  }
+  
+  uint32_t mid = getNextMsgId();
+  
+  // Sleepy nodes may take a while to pick a command up; don't let it linger forever
+  if (deadline == 0 && nodeSleepy(node)) deadline = millis() + LORA_SLEEPY_DEADLINE_MS;
+  
+  slot->mid = mid;
+  slot->node = (uint8_t)node;
+  slot->seqIndex = seqIndex;
+  slot->durationMs = durationMs;
+  slot->paramsLen = paramsLen;
+  if (paramsLen > 0) memcpy(slot->params, params, paramsLen);
+  strncpy(slot->type, cmdType.c_str(), LORA_TXN_TYPE_LEN - 1);
+  slot->type[LORA_TXN_TYPE_LEN - 1] = '\0';
+  strncpy(slot->sched, schedId.c_str(), LORA_TXN_SCHED_LEN - 1);
+  slot->sched[LORA_TXN_SCHED_LEN - 1] = '\0';
+  slot->schedHash = loraSchedHash(schedId.c_str());
+  slot->startAt = startAt;
+  slot->deadline = deadline;
+  
+  int len = encodeTxn(*slot);
+  if (len < 0) {
+    Serial.println("[LoRa] ❌ Command too long!");
+    return 0;
+  }
+  
+  // Diagnostics are refused outright once they would eat into the reserve
+  uint32_t airtime = airtimeMs((uint16_t)len, links[node].sf);
+  refillAirtime();
+  if (prio == LORA_PRIO_DIAG && !airtimeAvailable(prio, airtime)) {
+    airtimeRefusals++;
+    Serial.println("[LoRa] ❌ Airtime budget exhausted, diagnostic refused");
+    return 0;
+  }
+  
+  slot->active = true;
+  slot->inFlight = false;
+  slot->attempts = 0;
+  slot->cadDeferrals = 0;
+  slot->priority = prio;
+  slot->airtimeMs = airtime;
+  slot->airtimeDeferred = false;
+  slot->preemptWait = false;
+  slot->sentAt = 0;
+  slot->timeoutMs = links[node].rto;
+  slot->nextTxAt = millis();
+  slot->queuedAt = slot->nextTxAt;
+  slot->requesters[0].callback = callback;
+  slot->requesters[0].ctx = ctx;
+  slot->requesterCount = 1;
+  
+  Serial.printf("[LoRa] Queued MID=%u %s -> node %d%s (%d pending)\n",
+                mid, cmdType.c_str(), node, nodeSleepy(node) ? " mailbox" : "", pendingCount());
+  
+  for (int i = 0; i < replacedCount; i++) {
+    superseded++;
+    completeTxn(*replaced[i], LORA_TXN_SUPERSEDED);
+  }
+  
+  // Goes on air from the next processIncoming() pass
+  return mid;
+}
+
+// Builds t.frame from the transaction; returns its length, -1 if it doesn't
+// fit. Timed commands are rebuilt before every attempt so the start delay
+// they carry counts down to t.startAt.
+int LoRaComm::encodeTxn(LoRaTxn &t) {
+  int node = t.node;
+  int len;
+  uint8_t op = loraOpFromName(t.type);
+  uint32_t delayMs = 0;
+  if (t.startAt != 0 && (long)(t.startAt - millis()) > 0) delayMs = t.startAt - millis();
+  
+#if LORA_BINARY_FRAMES
+  if (links[node].binary && op != LORA_OP_NONE) {
+    uint8_t params[LORA_FRAME_MAX_PARAMS];
+    uint8_t paramsLen = t.paramsLen;
+    if (op == LORA_OP_SETDR) {
+      params[0] = links[node].pendingSf;
+      params[1] = (uint8_t)links[node].pendingPower;
+      paramsLen = 2;
+    } else if (paramsLen > 0) {
+      memcpy(params, t.params, paramsLen);
+    }
+    if (t.startAt != 0 && (op == LORA_OP_OPEN || op == LORA_OP_VSET)) {
+      for (int i = 0; i < LORA_FRAME_DELAY_LEN; i++) params[paramsLen++] = (uint8_t)(delayMs >> (8 * i));
+    }
+    LoRaFrame f;
+    f.type = LORA_FT_CMD;
+    f.op = op;
+    f.mid = t.mid;
+    f.node = (uint8_t)node;
+    f.schedHash = t.schedHash;
+    f.step = (t.seqIndex >= 0 && t.seqIndex < LORA_FRAME_NO_STEP) ? (uint8_t)t.seqIndex : LORA_FRAME_NO_STEP;
+    f.durationMs = (op == LORA_OP_OPEN || op == LORA_OP_VSET) ? t.durationMs : 0;
+    f.params = params;
+    f.paramsLen = paramsLen;
+    len = (int)loraFrameEncode(t.frame, LORA_BUFFER_SIZE, f);
+    if (len == 0) return -1;
+    t.frameLen = (uint16_t)len;
+    return len;
+  }
+#endif
+  char *out = (char *)t.frame;
+  if (strcmp(t.type, "SETDR") == 0) {
+    len = snprintf(out, LORA_BUFFER_SIZE, "CMD|MID=%u|%s|N=%d,S=%s,I=%d,SF=%u,P=%d",
+                   t.mid, t.type, node, t.sched, t.seqIndex,
+                   links[node].pendingSf, links[node].pendingPower);
+  } else if (strcmp(t.type, "VSET") == 0) {
+    // "V=1:600;2:600" - valve:seconds in the order the node runs them
+    LoRaValveStep plan[LORA_VALVE_PLAN_MAX];
+    uint8_t count = loraValvePlanDecode(t.params, t.paramsLen, plan, LORA_VALVE_PLAN_MAX);
+    String v;
+    for (uint8_t i = 0; i < count; i++) {
+      if (i > 0) v += ";";
+      v += String(plan[i].valve) + ":" + String(plan[i].seconds);
+    }
+    len = snprintf(out, LORA_BUFFER_SIZE, "CMD|MID=%u|%s|N=%d,S=%s,I=%d,T=%u,V=%s",
+                   t.mid, t.type, node, t.sched, t.seqIndex, t.durationMs, v.c_str());
+  } else if (strcmp(t.type, "OPEN") == 0 && t.durationMs > 0) {
+    len = snprintf(out, LORA_BUFFER_SIZE, "CMD|MID=%u|%s|N=%d,S=%s,I=%d,T=%u",
+                   t.mid, t.type, node, t.sched, t.seqIndex, t.durationMs);
+  } else {
+    len = snprintf(out, LORA_BUFFER_SIZE, "CMD|MID=%u|%s|N=%d,S=%s,I=%d",
+                   t.mid, t.type, node, t.sched, t.seqIndex);
+  }
+  // "D=<ms>" - start delay of a timed OPEN/VSET
+  if (len > 0 && len < LORA_BUFFER_SIZE && t.startAt != 0 &&
+      (strcmp(t.type, "OPEN") == 0 || strcmp(t.type, "VSET") == 0)) {
+    len += snprintf(out + len, LORA_BUFFER_SIZE - len, ",D=%u", delayMs);
+  }
+  if (len < 0 || len >= LORA_BUFFER_SIZE) return -1;
+  t.frameLen = (uint16_t)len;
+  return len;
+}
+
+// ========== Send with ACK (deadline) ==========
+// Queues like sendAsync(); the callback reports the outcome, TIMEOUT at the
+// latest deadlineMs from now (a sleepy node may take that long to wake up)
+uint32_t LoRaComm::sendWithAck(const String &cmdType, int node, const String &schedId,
+                               int seqIndex, uint32_t durationMs, uint32_t deadlineMs,
+                               LoRaTxnCallback callback, void *ctx, LoRaPriority prio) {
+  return sendAsync(cmdType, node, schedId, seqIndex, durationMs, callback, ctx, prio,
+                   nullptr, 0, 0, millis() + deadlineMs);
+}
+
+// ========== Relay Routing ==========
+// Relay to use for node, 0 to talk to it directly
+uint8_t LoRaComm::routeFor(uint8_t node) {
+#if LORA_RELAY_ENABLED
+  LoRaNodeLink &l = links[node];
+  if (l.via == 0) return 0;
+  
+  bool heard = l.directAt != 0 && millis() - l.directAt < LORA_ROUTE_STALE_MS;
+  if (!heard || l.directRssi < LORA_ROUTE_DIRECT_MIN_RSSI) return l.via;
+  if (l.directFails >= LORA_ROUTE_FAILS) return l.via;
+#endif
+  return 0;
+}
+
+// Node the gateway's radio actually talks to for this destination
+uint8_t LoRaComm::firstHop(uint8_t node) {
+  uint8_t via = routeFor(node);
+  return via ? via : node;
+}
+
+// Route metric is the weaker of gateway<->relay and relay<->node
+void LoRaComm::learnRoute(uint8_t node, uint8_t relay, int16_t hopRssi) {
+  if (node == 0 || node >= LORA_MAX_NODES || relay == 0 || relay >= LORA_MAX_NODES) return;
+  if (!links[relay].relay) return;
+  
+  LoRaNodeLink &l = links[node];
+  int16_t metric = hopRssi;
+  if (links[relay].directAt != 0 && links[relay].directRssi < metric) metric = links[relay].directRssi;
+  
+  if (l.via == relay) {
+    l.viaRssi = metric;
+    return;
+  }
+  if (l.via == 0 || metric > l.viaRssi) {
+    Serial.printf("[LoRa] Route to node %d via relay %d (%d dBm)\n", node, relay, metric);
+    l.via = relay;
+    l.viaRssi = metric;
+    l.relayFails = 0;
+  }
+}
+
+// Per-path failure counting; a relay route that keeps failing is dropped
+// and relearned from the next relayed uplink
+void LoRaComm::routeResult(LoRaTxn &t, bool acked) {
+  LoRaNodeLink &l = links[t.node];
+  if (t.via == 0) {
+    if (acked) l.directFails = 0;
+    else if (l.directFails < UINT8_MAX) l.directFails++;
+    return;
+  }
+  
+  if (acked) {
+    l.relayFails = 0;
+    return;
+  }
+  if (++l.relayFails >= LORA_ROUTE_FAILS && l.via == t.via) {
+    Serial.printf("[LoRa] ⚠ Route to node %d via %d failed, dropped\n", t.node, l.via);
+    l.via = 0;
+    l.relayFails = 0;
+    l.directFails = 0;
+    resetRtt(t.node);
+  }
+}
+
+// ========== TDMA Beacon ==========
+// Sends the beacon once the radio is free; new transactions are held back
+// while it is due. Returns true while the beacon owns the radio.
+bool LoRaComm::serviceBeacon() {
+#if LORA_BEACON_ENABLED
+  if (beaconOnAir) return true;
+  if (beaconDueAt == 0 || (long)(millis() - beaconDueAt) < 0) return false;
+  if (anyInFlight()) return true;
+  
+  // Close the superframe that is ending; owners that stay silent lose the slot
+  if (beaconAt != 0) {
+    for (int s = 0; s < beaconSlots; s++) {
+      if (slotOwner[s] == 0) continue;
+      LoRaSlotStats &st = slotStats[s];
+      if (st.heard) {
+        st.missStreak = 0;
+        continue;
+      }
+      if (st.missed < UINT16_MAX) st.missed++;
+      if (++st.missStreak >= LORA_TDMA_RELEASE_MISSES) {
+        Serial.printf("[LoRa] Node %d silent for %d superframes, TDMA slot %d freed\n",
+                      slotOwner[s], st.missStreak, s);
+        releaseSlot(slotOwner[s]);
+      }
+    }
+  }
+  for (int s = 0; s < LORA_TDMA_SLOTS; s++) slotStats[s].heard = false;
+  
+  uint8_t used = 0;
+  for (int s = 0; s < LORA_TDMA_SLOTS; s++) {
+    if (slotOwner[s] != 0) used = s + 1;
+  }
+  
+  time_t now = time(nullptr);
+  LoRaBeacon b;
+  b.epoch = (now > 1600000000) ? (uint32_t)now : 0;
+  b.seq = ++beaconSeq;
+  b.slotMs = LORA_TDMA_SLOT_MS;
+  b.firstSlotMs = LORA_TDMA_FIRST_SLOT_MS;
+  b.slotCount = used;
+  b.slotMap = slotOwner;
+  
+  uint8_t frame[LORA_BUFFER_SIZE];
+  size_t len = loraBeaconEncode(frame, sizeof(frame), b);
+  
+  applyHomeProfile();
+  beaconDueAt += LORA_BEACON_INTERVAL_MS;
+  if ((long)(millis() - beaconDueAt) >= 0) beaconDueAt = millis() + LORA_BEACON_INTERVAL_MS;
+  if (len == 0 || !sendRaw(frame, (uint16_t)len)) return false;
+  
+  beaconSlots = used;
+  beaconOnAir = true;
+  chargeBeacon(airtimeMs((uint16_t)len, radioSf));
+  DEBUG_LORA_PRINTLN(String("[LoRa] Beacon #") + b.seq + ", " + used + " slots");
+  return true;
+#else
+  return false;
+#endif
+}
+
+// Slot index t falls in for the current superframe, -1 outside the slot window
+int LoRaComm::slotAt(unsigned long t) {
+  if (beaconAt == 0 || beaconSlots == 0) return -1;
+  long offset = (long)(t - beaconAt) - LORA_TDMA_FIRST_SLOT_MS;
+  if (offset < 0) return -1;
+  long s = offset / LORA_TDMA_SLOT_MS;
+  return (s < beaconSlots) ? (int)s : -1;
+}
+
+// Slot window plus one slot of lead-in, so a command exchange started just
+// before it doesn't spill into slot 0
+bool LoRaComm::inSlotWindow(unsigned long t) {
+#if LORA_BEACON_ENABLED
+  if (beaconAt == 0 || beaconSlots == 0) return false;
+  long offset = (long)(t - beaconAt);
+  long start = LORA_TDMA_FIRST_SLOT_MS - LORA_TDMA_SLOT_MS;
+  long end = LORA_TDMA_FIRST_SLOT_MS + (long)beaconSlots * LORA_TDMA_SLOT_MS;
+  return offset >= start && offset < end;
+#else
+  return false;
+#endif
+}
+
+// First free slot; announced in the next beacon
+void LoRaComm::assignSlot(uint8_t node) {
+  for (int s = 0; s < LORA_TDMA_SLOTS; s++) {
+    if (slotOwner[s] == 0) {
+      slotOwner[s] = node;
+      links[node].slot = s;
+      Serial.printf("[LoRa] Node %d assigned TDMA slot %d\n", node, s);
+      return;
+    }
+  }
+  Serial.printf("[LoRa] ⚠ No free TDMA slot for node %d\n", node);
+  links[node].slot = LORA_NO_SLOT - 1;  // Don't retry on every uplink
+}
+
+// Frees the node's slot; it gets one again on its next uplink, and nodes
+// that found the map full get another try. The window shrinks in the next
+// beacon if this was the highest slot in use.
+void LoRaComm::releaseSlot(uint8_t node) {
+  LoRaNodeLink &l = links[node];
+  if (l.slot < LORA_TDMA_SLOTS) {
+    slotOwner[l.slot] = 0;
+    memset(&slotStats[l.slot], 0, sizeof(LoRaSlotStats));
+    for (int n = 1; n < LORA_MAX_NODES; n++) {
+      if (links[n].slot == LORA_NO_SLOT - 1) links[n].slot = LORA_NO_SLOT;
+    }
+  }
+  l.slot = LORA_NO_SLOT;
+}
+
+// The address now belongs to different hardware, or to none. Everything
+// learned about the old node goes: its commands and group memberships fail,
+// its slot is freed and ADR, route, RTT and listen window start over.
+void LoRaComm::resetLink(int node) {
+  if (node <= 0 || node >= LORA_MAX_NODES) return;
+  
+  int failed = 0;
+  for (int i = 0; i < LORA_MAX_TXNS; i++) {
+    if (!txns[i].active || txns[i].node != node) continue;
+    completeTxn(txns[i], LORA_TXN_TIMEOUT);
+    failed++;
+  }
+  uint8_t bit = 1 << (node % 8);
+  for (int i = 0; i < LORA_MAX_GROUPS; i++) {
+    LoRaGroupTxn &g = groups[i];
+    if (!g.active || !(g.pending[node / 8] & bit)) continue;
+    g.pending[node / 8] &= ~bit;
+    failed++;
+    if (groupPendingCount(g) == 0) {
+      g.active = false;
+      g.inFlight = false;
+      noteDone(g.priority, g.queuedAt);
+    }
+    if (g.callback != nullptr) g.callback(g.mid, node, LORA_TXN_TIMEOUT, g.ctx);
+  }
+  
+  for (int i = 0; i < LORA_DUP_CACHE_SLOTS; i++) {
+    if (dupCache[i].used && dupCache[i].node == node) dupCache[i].used = false;
+  }
+  for (int n = 1; n < LORA_MAX_NODES; n++) {
+    if (links[n].via == node) links[n].via = 0;  // Routes through the old node
+  }
+  
+  releaseSlot((uint8_t)node);
+  bool relay = links[node].relay;
+  defaultLink((uint8_t)node);
+  links[node].relay = relay;
+  if (idListHas(LORA_SLEEPY_NODES, node)) links[node].rxWindowMs = LORA_SLEEPY_RX_WINDOW_MS;
+  Serial.printf("[LoRa] Node %d link reset, %d command(s) dropped\n", node, failed);
+}
+
+// Account a node's uplink against the slot map
+void LoRaComm::noteUplink(uint8_t node, unsigned long rxAt) {
+#if LORA_BEACON_ENABLED
+  if (node == 0 || node >= LORA_MAX_NODES) return;
+  LoRaNodeLink &l = links[node];
+  if (l.slot == LORA_NO_SLOT) {
+    assignSlot(node);
+    return;
+  }
+  if (l.slot >= LORA_TDMA_SLOTS) return;
+  
+  int s = slotAt(rxAt);
+  LoRaSlotStats &own = slotStats[l.slot];
+  if (l.slot >= beaconSlots) return;  // Not announced yet
+  
+  if (s == l.slot) {
+    if (own.ok < UINT16_MAX) own.ok++;
+  } else {
+    if (own.offSlot < UINT16_MAX) own.offSlot++;
+    if (s >= 0 && slotOwner[s] != 0 && slotStats[s].collisions < UINT16_MAX) {
+      slotStats[s].collisions++;
+    }
+  }
+  own.heard = true;
+#endif
+}
+
+// CRC errors inside an assigned slot count as collisions in that slot
+void LoRaComm::noteRxErrors() {
+  uint32_t errors = rxErrors;
+  if (errors == rxErrorsSeen) return;
+  noteRadioAlive(false);
+  
+  int s = slotAt(millis());
+  if (s >= 0 && slotOwner[s] != 0) {
+    uint32_t n = errors - rxErrorsSeen;
+    slotStats[s].collisions = (slotStats[s].collisions + n > UINT16_MAX) ? UINT16_MAX
+                                                                          : slotStats[s].collisions + n;
+  }
+  DEBUG_LORA_PRINTLN(String("[LoRa] RX errors: ") + errors);
+  rxErrorsSeen = errors;
+}
+
+// "#12 S0:N4 ok=10 miss=1 off=0 coll=2 ..." - beacon count and assigned slots
+String LoRaComm::slotReport(int maxSlots) {
+  String out = "#" + String(beaconSeq);
+  int listed = 0;
+  for (int s = 0; s < LORA_TDMA_SLOTS && listed < maxSlots; s++) {
+    if (slotOwner[s] == 0) continue;
+    LoRaSlotStats &st = slotStats[s];
+    out += " S" + String(s) + ":N" + String(slotOwner[s]) + " ok=" + String(st.ok) +
+           " miss=" + String(st.missed) + " off=" + String(st.offSlot) +
+           " coll=" + String(st.collisions);
+    listed++;
+  }
+  if (listed == 0) out += " no slots";
+  return out;
+}
+
+// ========== Duplicate Suppression ==========
+// Value of a numeric "KEY=" field preceded by '|' or ',', -1 if absent
+static long frameField(const char *msg, const char *key) {
+  size_t keyLen = strlen(key);
+  const char *p = msg;
+  while ((p = strstr(p, key)) != NULL) {
+    if (p > msg && (p[-1] == '|' || p[-1] == ',') && isdigit((unsigned char)p[keyLen])) {
+      return atol(p + keyLen);
+    }
+    p += keyLen;
+  }
+  return -1;
+}
+
+bool LoRaComm::isDuplicate(int node, const char *msg) {
+  if (dupCheck(dupCache, node, msg, millis())) {
+    dupHits++;
+    return true;
+  }
+  dupMisses++;
+  return false;
+}
+
+// Remembers (node, key) in cache for LORA_DUP_WINDOW_MS; the oldest entry
+// is evicted when the cache is full
+bool LoRaComm::dupCheck(LoRaDupEntry *cache, int node, const char *msg, unsigned long now) {
+  long seq = frameField(msg, "SEQ=");
+  if (seq < 0) seq = frameField(msg, "MID=");
+  uint32_t key;
+  if (seq >= 0) {
+    key = (uint32_t)seq & 0x7FFFFFFF;
+  } else {
+    key = 2166136261UL;  // FNV-1a, top bit set to keep it apart from sequence numbers
+    for (const char *p = msg; *p; p++) {
+      key ^= (uint8_t)*p;
+      key *= 16777619UL;
+    }
+    key |= 0x80000000UL;
+  }
+  
+  LoRaDupEntry *victim = &cache[0];
+  for (int i = 0; i < LORA_DUP_CACHE_SLOTS; i++) {
+    LoRaDupEntry &e = cache[i];
+    if (e.used && now - e.seenAt >= LORA_DUP_WINDOW_MS) e.used = false;
+    if (e.used && e.node == (uint8_t)node && e.key == key) return true;
+    if (!e.used) {
+      if (victim->used) victim = &e;
+    } else if (victim->used && now - e.seenAt > now - victim->seenAt) {
+      victim = &e;
+    }
+  }
+  
+  victim->used = true;
+  victim->node = (uint8_t)node;
+  victim->key = key;
+  victim->seenAt = now;
+  return false;
+}
+
+// ========== Process Incoming ==========
+void LoRaComm::handleRx(LoRaRxSlot &slot) {
+  lastRssi = slot.rssi;
+  lastSnr = slot.snr;
+  
+  uint8_t outcome = rxFrame(slot.data, slot.size, slot.rssi, slot.snr, slot.rxAt, *this);
+  captureFrame(LORA_CAP_RX, outcome, slot.rxAt, slot.data, slot.size, slot.rssi, slot.snr);
+}
+
+// The whole RX path for one frame, live or replayed. Returns a
+// LoRaCaptureOutcome.
+uint8_t LoRaComm::rxFrame(const uint8_t *data, uint16_t size, int16_t rssi, int8_t snr,
+                          unsigned long rxAt, LoRaRxSink &sink) {
+  if (loraFrameIsRelay(data, size)) return handleRelay(data, size, rssi, snr, rxAt, sink);
+  if (loraFrameIsBeacon(data, size)) return LORA_CAP_RX_IGNORED;  // Another gateway's
+  return handleFrame(data, size, rssi, snr, rxAt, 0, sink);
+}
+
+// Uplinks forwarded to us are unwrapped and handled like direct frames;
+// relays' copies of our own downlinks are ignored
+uint8_t LoRaComm::handleRelay(const uint8_t *data, uint16_t size, int16_t rssi, int8_t snr,
+                              unsigned long rxAt, LoRaRxSink &sink) {
+  LoRaRelayHeader h;
+  const uint8_t *inner;
+  size_t innerLen;
+  if (!loraRelayDecode(data, size, h, inner, innerLen)) {
+    Serial.printf("[LoRa] ⚠ Bad relay frame (%u bytes, RSSI=%d)\n", size, rssi);
+    return LORA_CAP_RX_BAD;
+  }
+  if (h.dst != LORA_GATEWAY_ID || h.via != 0) return LORA_CAP_RX_IGNORED;
+  
+  DEBUG_LORA_PRINTLN(String("[LoRa] Relayed from node ") + h.src + " via " + h.last +
+                     " (" + h.hops + " hops, " + h.rssi + " dBm)");
+  sink.rxHeard(h.last, rssi, snr, 0, rxAt);
+  sink.rxRoute(h.src, h.last, h.rssi);
+  return handleFrame(inner, (uint16_t)innerLen, rssi, snr, rxAt, h.last, sink);
+}
+
+// via != 0: the frame came through that relay, so rssi/snr describe the
+// relay's link rather than the node's. Returns a LoRaCaptureOutcome.
+uint8_t LoRaComm::handleFrame(const uint8_t *data, uint16_t size, int16_t rssi, int8_t snr,
+                              unsigned long rxAt, uint8_t via, LoRaRxSink &sink) {
+  // Firmware status goes to whoever runs the update
+  if (loraFrameIsFuotaStatus(data, size)) {
+    Serial.printf("[LoRa] ✓ RX: [bin %uB] FUOTA status N=%u (RSSI=%d, SNR=%d)\n",
+                  size, size > 3 ? data[3] : 0, rssi, snr);
+    if (size > 3) sink.rxHeard(data[3], rssi, snr, via, rxAt);
+    return sink.rxFuota(data, size, rssi) ? LORA_CAP_RX_HANDLER : LORA_CAP_RX_IGNORED;
+  }
+  
+  // Binary frames are decoded in place
+  if (loraFrameIsBinary(data, size)) {
+    LoRaFrame f;
+    if (!loraFrameDecode(data, size, f)) {
+      Serial.printf("[LoRa] ⚠ Bad binary frame (%u bytes, RSSI=%d)\n", size, rssi);
+      return LORA_CAP_RX_BAD;
+    }
+    Serial.printf("[LoRa] ✓ RX: [bin %uB] %s MID=%u N=%u (RSSI=%d, SNR=%d)\n",
+                  size, loraOpName(f.op), f.mid, f.node, rssi, snr);
+    if (f.node > 0 && f.node < LORA_MAX_NODES) sink.rxBinary(f.node);
+    sink.rxHeard(f.node, rssi, snr, via, rxAt);
+    
+    if (f.type == LORA_FT_ACK) {
+      return sink.rxAck(nullptr, &f, rxAt) ? LORA_CAP_RX_ACK : LORA_CAP_RX_ACK_STRAY;
+    }
+    if (f.type == LORA_FT_NAK) {
+      Serial.printf("[LoRa] ✗ Node %u rejected MID=%u\n", f.node, f.mid);
+      return LORA_CAP_RX_ACK_STRAY;
+    }
+    Serial.println("[LoRa] ⚠ Unexpected binary frame type, ignored");
+    return LORA_CAP_RX_IGNORED;
+  }
+  
+  memcpy(rxBufferSafe, data, size);
+  rxBufferSafe[size] = '\0';
+  
+  if (strlen(rxBufferSafe) == 0) return LORA_CAP_RX_IGNORED;
+  
+  Serial.printf("[LoRa] ✓ RX: %s (RSSI=%d, SNR=%d)\n", rxBufferSafe, rssi, snr);
+  int node = frameNode(rxBufferSafe);
+  // "RXW=<ms>" - the node sleeps and listens this long after its frames
+  long rxw = (node > 0 && node < LORA_MAX_NODES) ? frameField(rxBufferSafe, "RXW=") : -1;
+  if (rxw >= 0) sink.rxListenWindow(node, (uint16_t)(rxw > 65535 ? 65535 : rxw));
+  sink.rxHeard(node, rssi, snr, via, rxAt);
+  if (node > 0 && node < LORA_MAX_NODES &&
+      (strstr(rxBufferSafe, ",F=B") || strstr(rxBufferSafe, "|F=B"))) {
+    sink.rxBinary(node);
+  }
+  
+  // ACKs complete transactions, everything else goes to the main loop
+  if (strncmp(rxBufferSafe, "ACK|", 4) == 0) {
+    return sink.rxAck(rxBufferSafe, nullptr, rxAt) ? LORA_CAP_RX_ACK : LORA_CAP_RX_ACK_STRAY;
+  }
+  
+  if (via == 0 && node > 0) sink.rxUplink((uint8_t)node, rxAt);
+  
+  // Node retransmissions of the same uplink are dropped here
+  if (node > 0 && sink.rxDuplicate(node, rxBufferSafe, rxAt)) {
+    Serial.printf("[LoRa] Duplicate from node %d dropped\n", node);
+    return LORA_CAP_RX_DUP;
+  }
+  
+  String payload = String(rxBufferSafe);
+  
+  if (payload.startsWith("STAT|")) {
+    Serial.println("[LoRa] ✓ STAT message - QUEUING!");
+  } else if (payload.startsWith("AUTO_CLOSE|")) {
+    Serial.println("[LoRa] ✓ AUTO_CLOSE - QUEUING!");
+  } else if (payload.startsWith("JOIN|")) {
+    Serial.println("[LoRa] ✓ JOIN - QUEUING!");
+  } else {
+    Serial.println("[LoRa] ✓ Generic message - QUEUING!");
+  }
+  
+  if (payload.indexOf("SRC=") < 0) payload += ",SRC=LORA";
+  sink.rxQueue(payload);
+  return LORA_CAP_RX_QUEUED;
+}
+
+// ========== Live RX Sink ==========
+void LoRaComm::rxHeard(int node, int16_t rssi, int8_t snr, uint8_t via, unsigned long rxAt) {
+  noteHeard(node, rssi, snr, via, rxAt);
+}
+
+void LoRaComm::rxRoute(uint8_t node, uint8_t relay, int16_t hopRssi) {
+  learnRoute(node, relay, hopRssi);
+}
+
+void LoRaComm::rxBinary(int node) {
+  if (!links[node].binary) Serial.printf("[LoRa] Node %d speaks binary frames\n", node);
+  links[node].binary = true;
+}
+
+void LoRaComm::rxListenWindow(int node, uint16_t windowMs) {
+  if (windowMs != links[node].rxWindowMs) {
+    Serial.printf("[LoRa] Node %d listen window %u ms%s\n", node, windowMs,
+                  windowMs == 0 ? " (always on)" : "");
+  }
+  links[node].rxWindowMs = windowMs;
+  if (windowMs == 0) links[node].wakeAt = 0;
+}
+
+void LoRaComm::rxUplink(uint8_t node, unsigned long rxAt) {
+  noteUplink(node, rxAt);
+}
+
+bool LoRaComm::rxAck(const char *msg, const LoRaFrame *bin, unsigned long rxAt) {
+  return matchAck(msg, bin, rxAt);
+}
+
+bool LoRaComm::rxDuplicate(int node, const char *msg, unsigned long rxAt) {
+  return isDuplicate(node, msg);
+}
+
+void LoRaComm::rxQueue(const String &payload) {
+  incomingQueue.enqueue(payload);
+  Serial.println("[LoRa] ✓ Queued");
+}
+
+bool LoRaComm::rxFuota(const uint8_t *data, uint16_t size, int16_t rssi) {
+  if (uplinkHandler == nullptr) return false;
+  uplinkHandler(data, size, rssi, uplinkCtx);
+  return true;
+}
+
+void LoRaComm::processIncoming() {
+  Radio.IrqProcess();
+  updateTxState();
+  updateCadState();
+  noteRxErrors();
+  
+  // Drain every packet received since the last pass
+  while (rxTail != rxHead) {
+    noteRadioAlive(true);
+    handleRx(rxRing[rxTail]);
+    rxTail = (rxTail + 1) % LORA_RX_RING_SLOTS;
+  }
+  
+  uint32_t dropped = rxDropped;
+  if (dropped != rxDroppedReported) {
+    Serial.printf("[LoRa] ⚠ RX ring full, %u packet(s) dropped so far\n", dropped);
+    rxDroppedReported = dropped;
+  }
+  
+  checkRadioHealth();
+  serviceTxns();
+}
+
+
+// ========== Radio Health ==========
+// Any interrupt shows the radio works; a received frame also clears the
+// ACK timeout streak and lets recoveries come quickly again
+void LoRaComm::noteRadioAlive(bool received) {
+  unsigned long now = millis();
+  radioAliveAt = now;
+  radioFaults = 0;
+  if (received) {
+    lastRxAt = now;
+    ackTimeoutStreak = 0;
+    recoveryGapMs = LORA_HEALTH_MIN_GAP_MS;
+  }
+  if (hangSince != 0) {
+    recoverLastMs = now - hangSince;
+    if (recoverLastMs > recoverMaxMs) recoverMaxMs = recoverLastMs;
+    recoveredCount++;
+    hangSince = 0;
+    Serial.printf("[LoRa] ✓ Radio back, %lu ms after its last sign of life\n",
+                  (unsigned long)recoverLastMs);
+    publishStatus("EVT|RADIO_OK|TTR=" + String(recoverLastMs));
+  }
+}
+
+// A single missed TxDone or a dead node's timeouts happen; a run of them,
+// or hearing nothing at all for long, means the radio stopped interrupting
+void LoRaComm::checkRadioHealth() {
+  unsigned long now = millis();
+  if (recoveredAt != 0 && now - recoveredAt < recoveryGapMs) return;
+  
+  unsigned long heardAt = lastRxAt;
+  if (recoveredAt != 0 && (long)(recoveredAt - heardAt) > 0) heardAt = recoveredAt;
+  
+  if (radioFaults >= LORA_HEALTH_RADIO_FAULTS) {
+    recoverRadio(LORA_RECOVER_IRQ);
+  } else if (ackTimeoutStreak >= LORA_HEALTH_ACK_TIMEOUTS) {
+    recoverRadio(LORA_RECOVER_ACKS);
+  } else if (lastRxAt != 0 && now - heardAt >= LORA_HEALTH_RX_SILENCE_MS) {
+    recoverRadio(LORA_RECOVER_SILENCE);
+  }
+}
+
+// Whatever the radio was doing is abandoned: the attempt on air times out
+// and is retried like any other, from a freshly initialised radio
+void LoRaComm::recoverRadio(LoRaRecoverReason why) {
+  static const char *reasons[LORA_RECOVER_COUNT] = {
+    "interrupts missing", "ACK timeouts with nothing received", "nothing received"
+  };
+  static const char *codes[LORA_RECOVER_COUNT] = { "IRQ", "ACKS", "SILENCE" };
+  unsigned long now = millis();
+  Serial.printf("[LoRa] ⚠ Radio looks wedged (%s), reinitialising\n", reasons[why]);
+  publishStatus(String("WARN|RADIO_RECOVER|WHY=") + codes[why]);
+  recoveries[why]++;
+  if (hangSince == 0) hangSince = (radioAliveAt != 0) ? radioAliveAt : now;
+  if (recoveredAt != 0) recoveryGapMs = min((uint32_t)LORA_HEALTH_MAX_GAP_MS, recoveryGapMs * 2);
+  recoveredAt = now;
+  
+  txBusy = false;
+  txDoneFlag = false;
+  txTimeoutFlag = false;
+  onAirMid = 0;
+  beaconOnAir = false;
+  cadMid = 0;
+  cadDoneFlag = false;
+  cadActivity = false;
+  bulkListenUntil = 0;
+  radioFaults = 0;
+  ackTimeoutStreak = 0;
+  
+  configureRadio();
+}
+
+// "ok lastRx=12s faults=0 ackStreak=0 recoveries=1/0/0 recovered=1 ttr=4s max=4s"
+String LoRaComm::healthReport() {
+  unsigned long now = millis();
+  String out = (hangSince != 0) ? "recovering" : "ok";
+  out += " lastRx=" + (lastRxAt != 0 ? String((now - lastRxAt) / 1000) + "s" : String("never"));
+  out += " faults=" + String(radioFaults) + " ackStreak=" + String(ackTimeoutStreak);
+  out += " recoveries=" + String(recoveries[LORA_RECOVER_IRQ]) + "/" +
+         String(recoveries[LORA_RECOVER_ACKS]) + "/" + String(recoveries[LORA_RECOVER_SILENCE]);
+  out += " recovered=" + String(recoveredCount);
+  if (recoveredCount > 0) {
+    out += " ttr=" + String(recoverLastMs / 1000) + "s max=" + String(recoverMaxMs / 1000) + "s";
+  }
+  return out;
+}
+
+// ========== Bulk Frames ==========
+// Fire-and-forget multicast (firmware fragments and their control frames).
+// listenMs keeps the radio on the frame's channel/SF for replies.
+bool LoRaComm::sendBulk(const uint8_t *frame, uint16_t len, uint8_t channel, uint8_t sf,
+                        int8_t power, uint32_t listenMs) {
+  if (bulkLen != 0 || len == 0 || len >= LORA_BUFFER_SIZE) return false;
+  memcpy(bulkFrame, frame, len);
+  bulkChannel = channel;
+  bulkSf = sf;
+  bulkPower = power;
+  bulkListenMs = listenMs;
+  bulkLen = len;
+  return true;
+}
+
+bool LoRaComm::bulkIdle() {
+  return bulkLen == 0 && !(bulkListenUntil != 0 && (long)(millis() - bulkListenUntil) < 0);
+}
+
+// Bulk frames go out only when no command is ready, outside the TDMA slot
+// window, and while the budget stays above the bulk reserve
+bool LoRaComm::serviceBulk(unsigned long now, bool slotWindow) {
+  if (bulkLen == 0 || slotWindow) return false;
+  uint32_t airtime = airtimeMs(bulkLen, bulkSf);
+  if (!airtimeAvailable(LORA_PRIO_BULK, airtime)) return false;
+  
+  applyRadioProfile(bulkChannel, bulkSf, bulkPower);
+  if (!sendRaw(bulkFrame, bulkLen)) return false;
+  chargeAirtime(LORA_PRIO_BULK, airtime);
+  channelTx[radioChannel]++;
+  bulkSent++;
+  bulkListenUntil = bulkListenMs ? now + airtime + bulkListenMs : 0;
+  bulkLen = 0;
+  return true;
+}
+
+void LoRaComm::setUplinkHandler(LoRaUplinkHandler handler, void *ctx) {
+  uplinkHandler = handler;
+  uplinkCtx = ctx;
+}
+
+void LoRaComm::setNodeSeenHandler(LoRaNodeSeenHandler handler, void *ctx) {
+  seenHandler = handler;
+  seenCtx = ctx;
+}
+
+void LoRaComm::nodeProfile(int node, uint8_t &channel, uint8_t &sf, int8_t &power) {
+  const LoRaNodeLink &l = links[node & 0xFF];
+  channel = l.channel;
+  sf = l.sf;
+  power = l.power;
+}
+
+bool LoRaComm::nodeBinary(int node) {
+  return node > 0 && node < LORA_MAX_NODES && links[node].binary;
+}
+
+bool LoRaComm::nodeSleepy(int node) {
+  return node > 0 && node < LORA_MAX_NODES && links[node].rxWindowMs != 0;
+}
+
+// "5:2 9:0 sent=14 expired=1" - commands waiting per sleepy node
+String LoRaComm::mailboxReport() {
+  String out;
+  for (int n = 1; n < LORA_MAX_NODES; n++) {
+    if (links[n].rxWindowMs == 0) continue;
+    int waiting = 0;
+    for (int i = 0; i < LORA_MAX_TXNS; i++) {
+      if (txns[i].active && txns[i].node == n) waiting++;
+    }
+    out += String(n) + ":" + String(waiting) + " ";
+  }
+  if (out.length() == 0) return String("none");
+  return out + "sent=" + String(mailboxSent) + " expired=" + String(mailboxExpired);
+}
+
+// ========== Packet Capture ==========
+bool LoRaComm::setCapture(LoRaCaptureMode mode) {
+  if (captureMode == LORA_CAPTURE_FILE) {
+    captureFile.close();
+  }
+  captureMode = LORA_CAPTURE_OFF;
+  
+  if (mode == LORA_CAPTURE_FILE) {
+    captureFile = LittleFS.open(LORA_CAPTURE_PATH, "a");
+    if (!captureFile) {
+      Serial.println("[LoRa] ❌ Cannot open " LORA_CAPTURE_PATH);
+      return false;
+    }
+    captureBytes = captureFile.size();
+  }
+  captureMode = mode;
+  Serial.printf("[LoRa] Capture %s\n", mode == LORA_CAPTURE_FILE ? "to " LORA_CAPTURE_PATH :
+                                      mode == LORA_CAPTURE_SERIAL ? "to Serial" : "off");
+  return true;
+}
+
+void LoRaComm::captureFrame(uint8_t kind, uint8_t outcome, unsigned long at, const uint8_t *data,
+                            uint16_t len, int16_t rssi, int8_t snr) {
+  if (captureMode == LORA_CAPTURE_OFF) return;
+  
+  LoRaCaptureRecord r;
+  r.kind = kind;
+  r.outcome = outcome;
+  r.at = at;
+  r.rssi = rssi;
+  r.snr = snr;
+  r.channel = radioChannel;
+  r.sf = radioSf;
+  r.len = (uint8_t)(len > 255 ? 255 : len);
+  r.data = data;
+  
+  uint8_t buf[LORA_CAP_HEADER_LEN + 255];
+  size_t n = loraCaptureEncode(buf, sizeof(buf), r);
+  
+  if (captureMode == LORA_CAPTURE_FILE) {
+    if (captureBytes + n > LORA_CAPTURE_MAX_BYTES) {
+      Serial.println("[LoRa] ⚠ Capture file full, capture stopped");
+      setCapture(LORA_CAPTURE_OFF);
+      return;
+    }
+    if (captureFile.write(buf, n) != n) {
+      Serial.println("[LoRa] ❌ Capture write failed, capture stopped");
+      setCapture(LORA_CAPTURE_OFF);
+      return;
+    }
+    captureBytes += n;
+  } else {
+    static const char hex[] = "0123456789ABCDEF";
+    char line[4 + 2 * sizeof(buf) + 1];
+    memcpy(line, "CAP|", 4);
+    for (size_t i = 0; i < n; i++) {
+      line[4 + 2 * i] = hex[buf[i] >> 4];
+      line[5 + 2 * i] = hex[buf[i] & 0x0F];
+    }
+    line[4 + 2 * n] = '\0';
+    Serial.println(line);
+  }
+  captureRecords++;
+}
+
+String LoRaComm::captureReport() {
+  const char *mode = captureMode == LORA_CAPTURE_FILE ? "file" :
+                     captureMode == LORA_CAPTURE_SERIAL ? "serial" : "off";
+  return String(mode) + " records=" + String(captureRecords) + " bytes=" + String(captureBytes);
+}
+
+// ========== Capture Replay ==========
+// REPLAY's sink: ACKs match the commands seen earlier in the capture, the
+// duplicate check has a cache of its own, queued messages go to the replay
+// queue, and links, routes and transactions are left alone
+class LoRaReplaySink : public LoRaRxSink {
+private:
+  LoRaComm *comm;
+  MessageQueue *queue;
+  LoRaTxn sent[LORA_REPLAY_TX_RING];
+  int sentCount;
+  int sentPos;
+  LoRaDupEntry dupCache[LORA_DUP_CACHE_SLOTS];
+
+public:
+  void begin(LoRaComm *c, MessageQueue *q) {
+    comm = c;
+    queue = q;
+    sentCount = 0;
+    sentPos = 0;
+    memset(dupCache, 0, sizeof(dupCache));
+  }
+
+  void noteSent(const uint8_t *data, uint16_t len) {
+    if (!LoRaComm::replayTxn(data, len, sent[sentPos])) return;
+    sentPos = (sentPos + 1) % LORA_REPLAY_TX_RING;
+    if (sentCount < LORA_REPLAY_TX_RING) sentCount++;
+  }
+
+  void rxHeard(int node, int16_t rssi, int8_t snr, uint8_t via, unsigned long rxAt) override {}
+  void rxRoute(uint8_t node, uint8_t relay, int16_t hopRssi) override {}
+  void rxBinary(int node) override {}
+  void rxListenWindow(int node, uint16_t windowMs) override {}
+  void rxUplink(uint8_t node, unsigned long rxAt) override {}
+
+  // Group frames were recorded with node 0 and match on MID alone
+  bool rxAck(const char *msg, const LoRaFrame *bin, unsigned long rxAt) override {
+    for (int i = 0; i < sentCount; i++) {
+      const LoRaTxn &t = sent[i];
+      if (bin != nullptr) {
+        if (t.node == 0 ? bin->mid == t.mid : comm->matchBinaryAck(*bin, t)) return true;
+      } else if (t.node != 0 && comm->parseAck(msg, t.mid, t.type, t.node, t.sched, t.seqIndex)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Captured receive times, so the window behaves as it did live
+  bool rxDuplicate(int node, const char *msg, unsigned long rxAt) override {
+    return LoRaComm::dupCheck(dupCache, node, msg, rxAt);
+  }
+
+  void rxQueue(const String &payload) override {
+    queue->enqueue(payload);
+  }
+
+  bool rxFuota(const uint8_t *data, uint16_t size, int16_t rssi) override {
+    return comm->uplinkHandler != nullptr;
+  }
+};
+
+// Rebuild what an ACK is matched against from a captured command frame.
+// Group frames keep node 0 and only match on MID.
+bool LoRaComm::replayTxn(const uint8_t *data, uint16_t len, LoRaTxn &t) {
+  LoRaRelayHeader h;
+  const uint8_t *inner;
+  size_t innerLen;
+  if (loraFrameIsRelay(data, len)) {
+    if (!loraRelayDecode(data, len, h, inner, innerLen)) return false;
+    data = inner;
+    len = (uint16_t)innerLen;
+  }
+  
+  memset(&t, 0, sizeof(t));
+  if (loraFrameIsGroup(data, len)) {
+    LoRaGroupFrame g;
+    if (!loraGroupDecode(data, len, g)) return false;
+    t.mid = g.mid;
+    return true;
+  }
+  if (loraFrameIsBinary(data, len)) {
+    LoRaFrame f;
+    if (!loraFrameDecode(data, len, f) || f.type != LORA_FT_CMD) return false;
+    t.mid = f.mid;
+    t.node = f.node;
+    strncpy(t.type, loraOpName(f.op), LORA_TXN_TYPE_LEN - 1);
+    t.schedHash = f.schedHash;
+    t.seqIndex = (f.step == LORA_FRAME_NO_STEP) ? -1 : f.step;
+    return true;
+  }
+  
+  // "CMD|MID=5|OPEN|N=3,S=sched1,I=0..."
+  char msg[LORA_BUFFER_SIZE];
+  memcpy(msg, data, len);
+  msg[len] = '\0';
+  if (strncmp(msg, "CMD|", 4) != 0) return false;
+  const char *typeStart = strchr(msg + 4, '|');
+  const char *typeEnd = typeStart ? strchr(typeStart + 1, '|') : NULL;
+  if (typeEnd == NULL || typeEnd - typeStart - 1 >= LORA_TXN_TYPE_LEN) return false;
+  memcpy(t.type, typeStart + 1, typeEnd - typeStart - 1);
+  
+  t.mid = (uint32_t)frameField(msg, "MID=");
+  t.node = (uint8_t)frameField(msg, "N=");
+  t.seqIndex = (int)frameField(msg, "I=");
+  const char *sched = strstr(typeEnd, "S=");
+  if (sched != NULL) {
+    sched += 2;
+    size_t n = strcspn(sched, ",|");
+    if (n >= LORA_TXN_SCHED_LEN) n = LORA_TXN_SCHED_LEN - 1;
+    memcpy(t.sched, sched, n);
+  }
+  return true;
+}
+
+// Appends one "CAP|<hex>" record to the capture file
+bool LoRaComm::importCapture(const String &hex) {
+  if (captureMode == LORA_CAPTURE_FILE) {
+    Serial.println("[LoRa] ✗ Stop the capture before loading records into it");
+    return false;
+  }
+  
+  uint8_t buf[LORA_CAP_HEADER_LEN + 255];
+  LoRaCaptureRecord r;
+  size_t n = loraCaptureFromHex(hex.c_str(), buf, sizeof(buf));
+  if (n == 0 || loraCaptureDecode(buf, n, r) != n) {
+    Serial.println("[LoRa] ✗ Not a capture record");
+    return false;
+  }
+  
+  File f = LittleFS.open(LORA_CAPTURE_PATH, "a");
+  if (!f) {
+    Serial.println("[LoRa] ❌ Cannot open " LORA_CAPTURE_PATH);
+    return false;
+  }
+  bool ok = f.size() + n <= LORA_CAPTURE_MAX_BYTES && f.write(buf, n) == n;
+  f.close();
+  if (!ok) Serial.println("[LoRa] ❌ Capture file full or write failed");
+  return ok;
+}
+
+bool LoRaComm::clearCapture() {
+  if (captureMode == LORA_CAPTURE_FILE) setCapture(LORA_CAPTURE_OFF);
+  if (LittleFS.exists(LORA_CAPTURE_PATH) && !LittleFS.remove(LORA_CAPTURE_PATH)) return false;
+  Serial.println("[LoRa] Capture file cleared");
+  return true;
+}
+
+// Feed the capture file through rxFrame() with the replay sink, and after
+// each frame drain the queue through consumer; both are timed. Without a
+// queue, messages go to a scratch one and are only dequeued. Blocks until
+// the whole file is done.
+String LoRaComm::replayCapture(MessageQueue *queue, LoRaMessageConsumer consumer, void *ctx) {
+  if (captureMode == LORA_CAPTURE_FILE) setCapture(LORA_CAPTURE_OFF);
+  
+  File f = LittleFS.open(LORA_CAPTURE_PATH, "r");
+  if (!f) return "no capture at " LORA_CAPTURE_PATH;
+  
+  static LoRaReplaySink sink;
+  static MessageQueue scratch;
+  if (queue == nullptr) queue = &scratch;
+  queue->clear();
+  sink.begin(this, queue);
+  
+  uint32_t records = 0, rx = 0, mismatches = 0, drained = 0;
+  uint32_t rxUs = 0, rxMaxUs = 0, drainUs = 0, drainMaxUs = 0;
+  uint32_t outcomes[LORA_CAP_RX_HANDLER + 1];
+  memset(outcomes, 0, sizeof(outcomes));
+  uint8_t buf[LORA_CAP_HEADER_LEN + 255];
+  String msg;
+  
+  while (f.read(buf, LORA_CAP_HEADER_LEN) == LORA_CAP_HEADER_LEN) {
+    if (buf[0] != LORA_CAP_MAGIC ||
+        (buf[12] > 0 && f.read(buf + LORA_CAP_HEADER_LEN, buf[12]) != buf[12])) {
+      Serial.printf("[LoRa] ⚠ Capture corrupt after %u records\n", records);
+      break;
+    }
+    LoRaCaptureRecord r;
+    if (loraCaptureDecode(buf, sizeof(buf), r) == 0) break;
+    records++;
+    
+    if (r.kind == LORA_CAP_TX) {
+      sink.noteSent(r.data, r.len);
+      continue;
+    }
+    
+    unsigned long start = micros();
+    uint8_t outcome = rxFrame(r.data, r.len, r.rssi, r.snr, r.at, sink);
+    unsigned long decoded = micros();
+    while (queue->dequeue(msg)) {
+      drained++;
+      if (consumer != nullptr) consumer(msg, ctx);
+    }
+    uint32_t us = decoded - start;
+    uint32_t queueUs = micros() - decoded;
+    rx++;
+    rxUs += us;
+    drainUs += queueUs;
+    if (us > rxMaxUs) rxMaxUs = us;
+    if (queueUs > drainMaxUs) drainMaxUs = queueUs;
+    if (outcome <= LORA_CAP_RX_HANDLER) outcomes[outcome]++;
+    if (outcome != r.outcome) mismatches++;
+  }
+  f.close();
+  
+  // "records=412 rx=380 avg=85us max=610us queue=120 avg=40us max=900us rate=8100/s ..."
+  String out = "records=" + String(records) + " rx=" + String(rx);
+  if (rx > 0) {
+    uint32_t totalUs = rxUs + drainUs;
+    out += " avg=" + String(rxUs / rx) + "us max=" + String(rxMaxUs) + "us queue=" + String(drained);
+    if (drained > 0) {
+      out += " avg=" + String(drainUs / drained) + "us max=" + String(drainMaxUs) + "us";
+    }
+    out += " rate=" +
+           String(totalUs > 0 ? (uint32_t)((uint64_t)rx * 1000000ULL / totalUs) : 0) + "/s";
+  }
+  for (uint8_t o = LORA_CAP_RX_ACK; o <= LORA_CAP_RX_HANDLER; o++) {
+    if (outcomes[o] > 0) out += " " + String(loraCaptureOutcomeName(o)) + "=" + String(outcomes[o]);
+  }
+  return out + " mismatch=" + String(mismatches);
+}
+
+uint32_t LoRaComm::rxDropCount() {
+  return rxDropped;
+}
+
+uint32_t LoRaComm::tableFullCount() {
+  return tableFull;
 }
\ No newline at end of file
@@ -5,36 +5,481 @@
 #include "Config.h"
 #include "Utils.h"
 #include "MessageQueue.h"
+#include "LoRaFrame.h"
+#include "LoRaCapture.h"
+#include <LittleFS.h>
+
+// Forward declaration for main controller function
+extern void publishStatus(const String &msg);
+
+// Outcome reported to a transaction's completion callback
+enum LoRaTxnStatus {
+  LORA_TXN_ACKED,
+  LORA_TXN_TIMEOUT,
+  LORA_TXN_SUPERSEDED         // Replaced by a newer valve command before it went out
+};
+
+// Send priority - lower value goes on air first and may dig deeper into
+// the airtime budget
+enum LoRaPriority {
+  LORA_PRIO_SAFETY,           // Emergency CLOSE (schedule stop), ignores the budget
+  LORA_PRIO_SCHEDULE,         // Schedule step OPEN/CLOSE
+  LORA_PRIO_OPERATOR,         // Manual valve commands (Serial/BLE/SMS)
+  LORA_PRIO_DIAG,             // PING/STATUS and other diagnostics
+  LORA_PRIO_BULK,             // Firmware fragments, only when nothing else waits
+  LORA_PRIO_COUNT
+};
+
+// Why the radio was re-initialised
+enum LoRaRecoverReason {
+  LORA_RECOVER_IRQ,           // TxDone/CadDone never arrived
+  LORA_RECOVER_ACKS,          // ACK timeouts across nodes, nothing received
+  LORA_RECOVER_SILENCE,       // Nothing received for LORA_HEALTH_RX_SILENCE_MS
+  LORA_RECOVER_COUNT
+};
+
+enum LoRaCaptureMode {
+  LORA_CAPTURE_OFF,
+  LORA_CAPTURE_FILE,          // Appended to LORA_CAPTURE_PATH on LittleFS
+  LORA_CAPTURE_SERIAL         // "CAP|<hex>" lines on the console
+};
+
+// Completion callback - runs from processIncoming(), never from the radio IRQ
+typedef void (*LoRaTxnCallback)(uint32_t mid, int node, LoRaTxnStatus status, void *ctx);
+
+// Receives LORA_FT_FSTAT uplinks - runs from processIncoming()
+typedef void (*LoRaUplinkHandler)(const uint8_t *frame, uint16_t len, int16_t rssi, void *ctx);
+
+// Called for every frame a node sends; via != 0 when a relay forwarded it
+typedef void (*LoRaNodeSeenHandler)(uint8_t node, int16_t rssi, int8_t snr, uint8_t via, void *ctx);
+
+// Whoever asked for a command; identical requests share one transaction
+struct LoRaRequester {
+  LoRaTxnCallback callback;
+  void *ctx;
+};
+
+// One outstanding command, keyed by MID
+struct LoRaTxn {
+  bool active;
+  bool inFlight;              // Frame on air / waiting for ACK
+  uint32_t mid;
+  uint8_t node;
+  uint8_t attempts;
+  uint8_t cadDeferrals;       // Busy-channel deferrals for the next attempt
+  LoRaPriority priority;
+  uint32_t airtimeMs;         // Time on air of one transmission of frame
+  bool airtimeDeferred;       // Already counted as waiting for budget
+  bool preemptWait;           // Already counted as holding back lower classes
+  int seqIndex;
+  uint32_t durationMs;
+  uint8_t params[LORA_FRAME_MAX_PARAMS];  // VSET valve plan
+  uint8_t paramsLen;
+  unsigned long startAt;      // millis() when the node should act, 0 = on receipt
+  unsigned long deadline;     // millis() after which it is dropped, 0 = none
+  char type[LORA_TXN_TYPE_LEN];
+  char sched[LORA_TXN_SCHED_LEN];
+  uint16_t schedHash;         // Binary frames carry the hash, not the ID
+  uint8_t frame[LORA_BUFFER_SIZE];
+  uint16_t frameLen;
+  uint8_t via;                // Relay used by the current attempt, 0 = direct
+  unsigned long sentAt;       // millis() of last transmission
+  uint32_t timeoutMs;         // ACK timeout of the current attempt
+  unsigned long nextTxAt;     // millis() when the next attempt may go out
+  unsigned long queuedAt;     // millis() when queued, for aging and latency
+  LoRaRequester requesters[LORA_TXN_MAX_REQUESTERS];
+  uint8_t requesterCount;
+};
+
+// One group command - a single binary frame to every member on one
+// channel/SF; retries address only the members that haven't acked
+struct LoRaGroupTxn {
+  bool active;
+  bool inFlight;
+  uint32_t mid;
+  uint8_t op;
+  uint16_t schedHash;
+  LoRaPriority priority;
+  uint8_t channel;
+  uint8_t sf;
+  int8_t power;
+  uint8_t attempts;
+  uint8_t cadDeferrals;
+  uint8_t pending[LORA_GROUP_MAX_BITMAP];   // Bit per node ID still to ack
+  uint16_t slotMs;
+  unsigned long sentAt;
+  uint32_t timeoutMs;
+  unsigned long nextTxAt;
+  unsigned long queuedAt;
+  LoRaTxnCallback callback;   // Called once per member
+  void *ctx;
+};
+
+// One received packet, filled by the RxDone callback
+struct LoRaRxSlot {
+  uint8_t data[LORA_BUFFER_SIZE];
+  uint16_t size;
+  int16_t rssi;
+  int8_t snr;
+  unsigned long rxAt;         // millis() at RxDone, for RTT samples
+};
+
+// Latency per priority class, queue to first transmission and to result
+struct LoRaClassStats {
+  uint32_t sent;              // First transmissions
+  uint32_t accessSumMs;
+  uint32_t accessMaxMs;
+  uint32_t done;              // Acked or timed out
+  uint32_t doneSumMs;
+  uint32_t doneMaxMs;
+};
+
+// Per-slot uplink accounting
+struct LoRaSlotStats {
+  uint16_t ok;                // Owner's uplink arrived in its slot
+  uint16_t missed;            // Superframes without the owner's uplink
+  uint16_t offSlot;           // Owner's uplink arrived outside its slot
+  uint16_t collisions;        // CRC errors or other nodes' frames in the slot
+  uint8_t missStreak;         // Superframes missed in a row
+  bool heard;                 // Owner heard in the current superframe
+};
+
+// Recently seen uplink, for duplicate suppression
+struct LoRaDupEntry {
+  bool used;
+  uint8_t node;
+  uint32_t key;               // SEQ/MID from the frame, else payload hash
+  unsigned long seenAt;
+};
+
+// Per-node link state, indexed by node ID
+struct LoRaNodeLink {
+  uint32_t srtt;              // Smoothed RTT (ms), 0 until first sample
+  uint32_t rttvar;            // RTT mean deviation (ms)
+  uint32_t rto;               // Current retransmit timeout (ms)
+  uint16_t rttSamples;
+  uint16_t timeouts;
+  
+  // Link quality, from every frame the node sends
+  int8_t snrHist[LORA_LINK_HISTORY];    // Recent samples (ring)
+  int16_t rssiHist[LORA_LINK_HISTORY];
+  uint8_t histPos;
+  uint8_t histCount;
+  uint16_t snrBins[LORA_LINK_BINS];     // Lifetime histograms
+  uint16_t rssiBins[LORA_LINK_BINS];
+  
+  // Channel and data rate the node listens and answers on
+  uint8_t channel;            // Index into LORA_CHANNEL_PLAN
+  uint8_t sf;
+  int8_t power;               // dBm
+  uint8_t pendingSf;          // Offered by the SETDR in flight
+  int8_t pendingPower;
+  uint32_t drMid;             // SETDR transaction, 0 if none
+  unsigned long drChangedAt;
+  uint8_t failStreak;         // Consecutive ACK timeouts
+  bool binary;                // Node decodes LoRaFrame binary frames
+  
+  // Routing
+  bool relay;                 // Designated relay (LORA_RELAY_NODES)
+  uint8_t via;                // Relay of the learned route, 0 = none
+  int16_t viaRssi;            // Weakest hop RSSI on that route
+  int16_t directRssi;         // Last RSSI heard directly
+  unsigned long directAt;     // millis() of that frame, 0 = never
+  uint8_t directFails;        // Consecutive timeouts per path
+  uint8_t relayFails;
+  
+  uint8_t slot;               // TDMA uplink slot, LORA_NO_SLOT if none
+  
+  // Sleepy nodes listen only after their own uplinks
+  uint16_t rxWindowMs;        // Listen window length, 0 = always listening
+  unsigned long wakeAt;       // Start of the current window, 0 = closed
+};
+
+#define LORA_NO_SLOT 0xFF
+
+// What a received frame changes. The RX path decodes and classifies every
+// frame the same way and leaves the effects to its sink: LoRaComm itself
+// for live frames, a scratch sink for REPLAY.
+class LoRaRxSink {
+public:
+  virtual ~LoRaRxSink() {}
+  // Link learning: signal, route, framing, listen window, TDMA slot
+  virtual void rxHeard(int node, int16_t rssi, int8_t snr, uint8_t via, unsigned long rxAt) = 0;
+  virtual void rxRoute(uint8_t node, uint8_t relay, int16_t hopRssi) = 0;
+  virtual void rxBinary(int node) = 0;
+  virtual void rxListenWindow(int node, uint16_t windowMs) = 0;
+  virtual void rxUplink(uint8_t node, unsigned long rxAt) = 0;
+  // True when the ACK completed a pending command (bin == nullptr: text ACK)
+  virtual bool rxAck(const char *msg, const LoRaFrame *bin, unsigned long rxAt) = 0;
+  virtual bool rxDuplicate(int node, const char *msg, unsigned long rxAt) = 0;
+  virtual void rxQueue(const String &payload) = 0;
+  // FUOTA status frames; false when nobody takes them
+  virtual bool rxFuota(const uint8_t *data, uint16_t size, int16_t rssi) = 0;
+};
+
+// Takes what REPLAY drains from its queue - the host replayer hands it to
+// the same handler the gateway's loop() uses
+typedef void (*LoRaMessageConsumer)(const String &msg, void *ctx);
+
+class LoRaComm : private LoRaRxSink {
+  friend class LoRaReplaySink;
 
-class LoRaComm {
 private:
   static char txBuffer[LORA_BUFFER_SIZE];
-  static char rxBuffer[LORA_BUFFER_SIZE];
   static char rxBufferSafe[LORA_BUFFER_SIZE];
-  static volatile bool rxFlag;
+  
+  // RX ring - onRxDone() only writes rxHead, processIncoming() only rxTail
+  static LoRaRxSlot rxRing[LORA_RX_RING_SLOTS];
+  static volatile uint8_t rxHead;
+  static volatile uint8_t rxTail;
+  static volatile uint32_t rxDropped;
+  
   static volatile bool txDoneFlag;
-  static volatile uint16_t rxSize;
-  static int16_t lastRssi;
-  static int8_t lastSnr;
-  static String lastRxMessage;
+  static volatile bool txTimeoutFlag;
+  static volatile bool cadDoneFlag;
+  static volatile bool cadActivity;
+  static volatile uint32_t rxErrors;
+  uint32_t rxErrorsSeen;
+  uint32_t cadMid;            // Transaction waiting on a CAD result
+  unsigned long cadStartedAt;
+  bool txBusy;
+  unsigned long txStartedAt;
+  uint32_t onAirMid;          // Transaction whose frame is being transmitted
+  uint32_t rxDroppedReported;
+  uint16_t txLen;             // Length of the frame in txBuffer
+  
+  int16_t lastRssi;
+  int8_t lastSnr;
+  
+  // Radio profile currently programmed (per transaction with ADR/channels)
+  uint8_t radioChannel;
+  uint8_t radioSf;
+  int8_t radioPower;
+  uint32_t channelTx[LORA_CHANNEL_COUNT];
+  uint32_t adrChanges;
+  uint32_t adrFallbacks;
+  
+  // Channel access counters
+  uint32_t cadChecks;
+  uint32_t cadBusy;           // Sends deferred because the channel was busy
+  uint32_t cadForced;         // Sent after LORA_CAD_MAX_DEFERRALS busy checks
+  uint32_t retryBackoffs;
+  uint32_t coalesced;         // Requests merged into an identical queued command
+  uint32_t superseded;        // Queued valve commands replaced by newer ones
+  
+  // Airtime budget (tokens in microseconds of airtime)
+  uint32_t airtimeTokensUs;
+  unsigned long airtimeRefillAt;
+  unsigned long airtimeHourStart;
+  uint32_t airtimeHourMs[LORA_PRIO_COUNT];      // Current hour, per class
+  uint32_t airtimeLastHourMs[LORA_PRIO_COUNT];  // Previous full hour
+  uint32_t beaconHourMs;      // Beacon airtime, kept apart from the classes
+  uint32_t beaconLastHourMs;
+  uint32_t airtimeDeferrals;
+  uint32_t airtimeRefusals;
+  
+  // Radio arbitration
+  LoRaClassStats classStats[LORA_PRIO_COUNT];
+  uint32_t preemptions;       // Times a waiting class held back lower ones
+  uint32_t agedPromotions;    // Sends that went out on an aged-up class
+  
+  // TDMA beacon and slot map
+  uint8_t slotOwner[LORA_TDMA_SLOTS];           // Node per slot, 0 = free
+  LoRaSlotStats slotStats[LORA_TDMA_SLOTS];
+  uint8_t beaconSlots;        // Slots announced in the last beacon
+  uint16_t beaconSeq;
+  unsigned long beaconDueAt;
+  unsigned long beaconAt;     // millis() at the end of the last beacon, 0 = none
+  bool beaconOnAir;
+  
+  LoRaDupEntry dupCache[LORA_DUP_CACHE_SLOTS];
+  uint32_t dupHits;
+  uint32_t dupMisses;
+  
+  // Bulk frame (unacknowledged multicast), one waiting at a time
+  uint8_t bulkFrame[LORA_BUFFER_SIZE];
+  uint16_t bulkLen;           // 0 = none waiting
+  uint8_t bulkChannel;
+  uint8_t bulkSf;
+  int8_t bulkPower;
+  uint32_t bulkListenMs;      // Keep the profile this long after the frame
+  unsigned long bulkListenUntil;
+  uint32_t bulkSent;
+  LoRaUplinkHandler uplinkHandler;
+  void *uplinkCtx;
+  LoRaNodeSeenHandler seenHandler;
+  void *seenCtx;
+  
+  // Packet capture
+  LoRaCaptureMode captureMode;
+  File captureFile;
+  uint32_t captureBytes;
+  uint32_t captureRecords;
+  
+  // Radio health
+  unsigned long radioAliveAt; // Last interrupt seen (TxDone, CadDone, RX, RX error)
+  unsigned long lastRxAt;     // Last frame received, 0 = none yet
+  uint8_t radioFaults;        // TxDone/CadDone missed in a row
+  uint16_t ackTimeoutStreak;  // ACK timeouts in a row with nothing received
+  unsigned long recoveredAt;  // Last re-initialisation, 0 = none
+  uint32_t recoveryGapMs;     // Least time before the next one
+  unsigned long hangSince;    // Last sign of life before a recovery still waiting for one
+  uint32_t recoveries[LORA_RECOVER_COUNT];
+  uint32_t recoveredCount;    // Recoveries the radio came back from
+  uint32_t recoverLastMs;     // Time to recover: last sign of life to the next
+  uint32_t recoverMaxMs;
+  
+  uint32_t tableFull;         // sendAsync() refusals for want of a transaction slot
+  uint32_t mailboxSent;       // Commands delivered into a sleepy node's window
+  uint32_t mailboxExpired;    // Commands dropped at their deadline
+  
+  LoRaTxn txns[LORA_MAX_TXNS];
+  LoRaGroupTxn groups[LORA_MAX_GROUPS];
+  LoRaNodeLink links[LORA_MAX_NODES];
   
   static void onTxDone(void);
   static void onTxTimeout(void);
   static void onRxDone(uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr);
+  static void onCadDone(bool channelActivityDetected);
+  static void onRxError(void);
+  void initLinks();
+  void defaultLink(uint8_t node);
+  void configureRadio();
+  void noteRadioAlive(bool received);
+  void checkRadioHealth();
+  void recoverRadio(LoRaRecoverReason why);
+  
+  bool parseAck(const char* msg, uint32_t wantMid, const char *wantType,
+                int wantNode, const char *wantSched, int wantSeqIndex);
+  bool matchBinaryAck(const LoRaFrame &f, const LoRaTxn &t);
+  bool sendRaw(const uint8_t *frame, uint16_t len);
+  void updateTxState();
+  void updateCadState();
+  int encodeTxn(LoRaTxn &t);
+  void transmitTxn(LoRaTxn &t);
+  bool inRxWindow(uint8_t node, unsigned long now);
+  uint32_t backoffDelay(uint8_t round);
+  void refillAirtime();
+  bool airtimeAvailable(LoRaPriority prio, uint32_t airtimeMs);
+  void chargeAirtime(LoRaPriority prio, uint32_t airtimeMs);
+  void chargeBeacon(uint32_t airtimeMs);
+  LoRaPriority effectivePriority(LoRaPriority prio, unsigned long queuedAt, unsigned long now);
+  void noteAccess(LoRaPriority prio, unsigned long queuedAt);
+  void noteDone(LoRaPriority prio, unsigned long queuedAt);
+  void handleRx(LoRaRxSlot &slot);
+  uint8_t rxFrame(const uint8_t *data, uint16_t size, int16_t rssi, int8_t snr,
+                  unsigned long rxAt, LoRaRxSink &sink);
+  uint8_t handleRelay(const uint8_t *data, uint16_t size, int16_t rssi, int8_t snr,
+                      unsigned long rxAt, LoRaRxSink &sink);
+  uint8_t handleFrame(const uint8_t *data, uint16_t size, int16_t rssi, int8_t snr,
+                      unsigned long rxAt, uint8_t via, LoRaRxSink &sink);
+  void rxHeard(int node, int16_t rssi, int8_t snr, uint8_t via, unsigned long rxAt) override;
+  void rxRoute(uint8_t node, uint8_t relay, int16_t hopRssi) override;
+  void rxBinary(int node) override;
+  void rxListenWindow(int node, uint16_t windowMs) override;
+  void rxUplink(uint8_t node, unsigned long rxAt) override;
+  bool rxAck(const char *msg, const LoRaFrame *bin, unsigned long rxAt) override;
+  bool rxDuplicate(int node, const char *msg, unsigned long rxAt) override;
+  void rxQueue(const String &payload) override;
+  bool rxFuota(const uint8_t *data, uint16_t size, int16_t rssi) override;
+  uint8_t routeFor(uint8_t node);
+  uint8_t firstHop(uint8_t node);
+  void learnRoute(uint8_t node, uint8_t relay, int16_t hopRssi);
+  void routeResult(LoRaTxn &t, bool acked);
+  bool isDuplicate(int node, const char *msg);
+  static bool dupCheck(LoRaDupEntry *cache, int node, const char *msg, unsigned long now);
+  bool serviceBeacon();
+  int slotAt(unsigned long t);
+  bool inSlotWindow(unsigned long t);
+  void assignSlot(uint8_t node);
+  void releaseSlot(uint8_t node);
+  void noteUplink(uint8_t node, unsigned long rxAt);
+  void noteRxErrors();
   
-  bool parseAck(const char* msg, uint32_t wantMid, const String &wantType,
-                int wantNode, const String &wantSched, int wantSeqIndex);
-  bool waitForAck(int node, const String &type, const String &sched, 
-                  int seqIdx, uint32_t mid, uint32_t timeout);
-  void sendRaw(const String &cmd);
+  LoRaTxn* findTxn(uint32_t mid);
+  bool nodeBusy(uint8_t node);
+  bool matchAck(const char *msg, const LoRaFrame *bin, unsigned long rxAt);
+  void updateRtt(uint8_t node, uint32_t sample);
+  void backoffRto(uint8_t node);
+  bool anyInFlight();
+  void applyRadioProfile(uint8_t channel, uint8_t sf, int8_t power);
+  void applyHomeProfile();
+  bool onProfileOf(uint8_t node);
+  void recordLink(int node, int16_t rssi, int8_t snr);
+  void noteHeard(int node, int16_t rssi, int8_t snr, uint8_t via, unsigned long rxAt);
+  void linkTimeout(uint8_t node);
+  void adrEvaluate(int node);
+  void resetRtt(uint8_t node);
+  static void onSetDrResult(uint32_t mid, int node, LoRaTxnStatus status, void *ctx);
+  static int frameNode(const char *msg);
+  static int requiredSnr(uint8_t sf);
+  void completeTxn(LoRaTxn &t, LoRaTxnStatus status);
+  static bool isValveCommand(const char *type);
+  LoRaGroupTxn* findGroup(uint32_t mid);
+  bool matchGroupAck(const LoRaFrame &f);
+  void transmitGroup(LoRaGroupTxn &g);
+  void serviceGroupTimeouts(unsigned long now);
+  LoRaGroupTxn* nextGroup(unsigned long now, bool slotWindow);
+  static int groupPendingCount(const LoRaGroupTxn &g);
+  void serviceTxns();
+  bool serviceBulk(unsigned long now, bool slotWindow);
+  void captureFrame(uint8_t kind, uint8_t outcome, unsigned long at, const uint8_t *data,
+                    uint16_t len, int16_t rssi, int8_t snr);
+  static bool replayTxn(const uint8_t *data, uint16_t len, LoRaTxn &t);
 
 public:
   LoRaComm();
   bool init();
-  bool sendWithAck(const String &cmdType, int node, const String &schedId,
-                   int seqIndex, uint32_t durationMs = 0);
+  uint32_t sendAsync(const String &cmdType, int node, const String &schedId,
+                     int seqIndex, uint32_t durationMs = 0,
+                     LoRaTxnCallback callback = nullptr, void *ctx = nullptr,
+                     LoRaPriority prio = LORA_PRIO_OPERATOR,
+                     const uint8_t *params = nullptr, uint8_t paramsLen = 0,
+                     unsigned long startAt = 0, unsigned long deadline = 0);
+  int sendGroupAsync(const String &cmdType, const uint8_t *nodes, const int *seqIndex,
+                     uint8_t count, const String &schedId,
+                     LoRaTxnCallback callback = nullptr, void *ctx = nullptr,
+                     LoRaPriority prio = LORA_PRIO_OPERATOR);
+  uint32_t sendWithAck(const String &cmdType, int node, const String &schedId,
+                       int seqIndex, uint32_t durationMs, uint32_t deadlineMs,
+                       LoRaTxnCallback callback, void *ctx = nullptr,
+                       LoRaPriority prio = LORA_PRIO_OPERATOR);
+  static LoRaPriority commandPriority(const String &cmdType);
+  static const char* priorityName(LoRaPriority prio);
+  static uint32_t airtimeMs(uint16_t payloadLen, uint8_t sf = LORA_SPREADING_FACTOR);
+  bool isPending(uint32_t mid);
+  int pendingCount();
+  uint32_t getRto(int node);
+  String rttReport(int maxNodes = LORA_MAX_NODES);
+  String linkReport(int maxNodes = LORA_MAX_NODES);
+  String linkHistogram(int node);
+  String statsReport();
+  String channelReport();
+  String slotReport(int maxSlots = LORA_TDMA_SLOTS);
+  String airtimeReport();
+  String priorityReport();
+  uint32_t airtimeBudgetMs();
+  bool sendBulk(const uint8_t *frame, uint16_t len, uint8_t channel, uint8_t sf, int8_t power,
+                uint32_t listenMs = 0);
+  bool bulkIdle();
+  void setUplinkHandler(LoRaUplinkHandler handler, void *ctx);
+  void setNodeSeenHandler(LoRaNodeSeenHandler handler, void *ctx);
+  void nodeProfile(int node, uint8_t &channel, uint8_t &sf, int8_t &power);
+  bool nodeBinary(int node);
+  bool nodeSleepy(int node);
+  void resetLink(int node);
+  String mailboxReport();
+  bool setCapture(LoRaCaptureMode mode);
+  String captureReport();
+  bool importCapture(const String &hex);
+  bool clearCapture();
+  String replayCapture(MessageQueue *queue = nullptr, LoRaMessageConsumer consumer = nullptr,
+                       void *ctx = nullptr);
+  uint32_t rxDropCount();
+  uint32_t tableFullCount();
+  String healthReport();
   void processIncoming();
 };
 
 extern LoRaComm loraComm;
-#endif
\ No newline at end of file
+#endif
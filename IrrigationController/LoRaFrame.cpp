@@ -0,0 +1,407 @@
+// LoRaFrame.cpp - Compact binary LoRa frame codec
+#include "LoRaFrame.h"
+#include <string.h>
+
+// ========== Checksums ==========
+// CRC16-CCITT (poly 0x1021, init 0xFFFF)
+uint16_t loraFrameCrc16(const uint8_t *data, size_t len) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (int b = 0; b < 8; b++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+// CRC-32 (IEEE, reflected), chainable: start with 0
+uint32_t loraCrc32(uint32_t crc, const uint8_t *data, size_t len) {
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int b = 0; b < 8; b++) {
+      crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320UL : crc >> 1;
+    }
+  }
+  return ~crc;
+}
+
+// FNV-1a folded to 16 bits; never 0 for a non-empty ID
+uint16_t loraSchedHash(const char *schedId) {
+  if (schedId == nullptr || schedId[0] == '\0') return 0;
+  uint32_t h = 2166136261UL;
+  for (const char *p = schedId; *p; p++) {
+    h ^= (uint8_t)*p;
+    h *= 16777619UL;
+  }
+  uint16_t folded = (uint16_t)(h ^ (h >> 16));
+  return folded ? folded : 1;
+}
+
+// ========== Operation Names ==========
+static const char *const opNames[] = { "", "OPEN", "CLOSE", "PING", "PONG", "STATUS", "SETDR", "VSET" };
+static const uint8_t opCount = sizeof(opNames) / sizeof(opNames[0]);
+
+uint8_t loraOpFromName(const char *name) {
+  for (uint8_t op = 1; op < opCount; op++) {
+    if (strcmp(name, opNames[op]) == 0) return op;
+  }
+  return LORA_OP_NONE;
+}
+
+const char *loraOpName(uint8_t op) {
+  return op < opCount ? opNames[op] : "?";
+}
+
+// ========== Encode ==========
+size_t loraFrameEncode(uint8_t *buf, size_t cap, const LoRaFrame &f) {
+  // Header 11 + varint up to 5 + params + CRC 2
+  if (f.paramsLen > LORA_FRAME_MAX_PARAMS) return 0;
+  if (cap < (size_t)(11 + 5 + f.paramsLen + 2)) return 0;
+
+  size_t n = 0;
+  buf[n++] = LORA_FRAME_MAGIC;
+  buf[n++] = f.type;
+  buf[n++] = f.op;
+  buf[n++] = (uint8_t)(f.mid);
+  buf[n++] = (uint8_t)(f.mid >> 8);
+  buf[n++] = (uint8_t)(f.mid >> 16);
+  buf[n++] = (uint8_t)(f.mid >> 24);
+  buf[n++] = f.node;
+  buf[n++] = (uint8_t)(f.schedHash);
+  buf[n++] = (uint8_t)(f.schedHash >> 8);
+  buf[n++] = f.step;
+
+  uint32_t v = f.durationMs;
+  do {
+    uint8_t b = v & 0x7F;
+    v >>= 7;
+    buf[n++] = v ? (b | 0x80) : b;
+  } while (v);
+
+  if (f.paramsLen > 0) {
+    memcpy(buf + n, f.params, f.paramsLen);
+    n += f.paramsLen;
+  }
+
+  uint16_t crc = loraFrameCrc16(buf, n);
+  buf[n++] = (uint8_t)(crc >> 8);
+  buf[n++] = (uint8_t)crc;
+  return n;
+}
+
+// ========== Decode ==========
+bool loraFrameDecode(const uint8_t *buf, size_t len, LoRaFrame &out) {
+  if (len < LORA_FRAME_MIN_LEN || buf[0] != LORA_FRAME_MAGIC) return false;
+  if (buf[1] != LORA_FT_CMD && buf[1] != LORA_FT_ACK && buf[1] != LORA_FT_NAK) return false;
+
+  uint16_t crc = ((uint16_t)buf[len - 2] << 8) | buf[len - 1];
+  if (loraFrameCrc16(buf, len - 2) != crc) return false;
+
+  out.type = buf[1];
+  out.op = buf[2];
+  out.mid = (uint32_t)buf[3] | ((uint32_t)buf[4] << 8) |
+            ((uint32_t)buf[5] << 16) | ((uint32_t)buf[6] << 24);
+  out.node = buf[7];
+  out.schedHash = (uint16_t)buf[8] | ((uint16_t)buf[9] << 8);
+  out.step = buf[10];
+
+  size_t end = len - 2;
+  size_t n = 11;
+  uint32_t v = 0;
+  int shift = 0;
+  while (true) {
+    if (n >= end || shift > 28) return false;
+    uint8_t b = buf[n++];
+    v |= (uint32_t)(b & 0x7F) << shift;
+    if (!(b & 0x80)) break;
+    shift += 7;
+  }
+  out.durationMs = v;
+
+  if (end - n > LORA_FRAME_MAX_PARAMS) return false;
+  out.params = buf + n;
+  out.paramsLen = (uint8_t)(end - n);
+  return true;
+}
+
+// ========== Relay Envelope ==========
+size_t loraRelayEncode(uint8_t *buf, size_t cap, const LoRaRelayHeader &h,
+                       const uint8_t *inner, size_t innerLen) {
+  if (cap < LORA_RELAY_HEADER_LEN + innerLen + 2) return 0;
+
+  buf[0] = LORA_FRAME_MAGIC;
+  buf[1] = LORA_FT_RELAY;
+  buf[2] = h.src;
+  buf[3] = h.dst;
+  buf[4] = h.via;
+  buf[5] = h.last;
+  buf[6] = h.hops;
+  buf[7] = (uint8_t)h.rssi;
+  memcpy(buf + LORA_RELAY_HEADER_LEN, inner, innerLen);
+
+  size_t n = LORA_RELAY_HEADER_LEN + innerLen;
+  uint16_t crc = loraFrameCrc16(buf, n);
+  buf[n++] = (uint8_t)(crc >> 8);
+  buf[n++] = (uint8_t)crc;
+  return n;
+}
+
+bool loraRelayDecode(const uint8_t *buf, size_t len, LoRaRelayHeader &h,
+                     const uint8_t *&inner, size_t &innerLen) {
+  if (len < LORA_RELAY_HEADER_LEN + 1 + 2 || !loraFrameIsRelay(buf, len)) return false;
+
+  uint16_t crc = ((uint16_t)buf[len - 2] << 8) | buf[len - 1];
+  if (loraFrameCrc16(buf, len - 2) != crc) return false;
+
+  h.src = buf[2];
+  h.dst = buf[3];
+  h.via = buf[4];
+  h.last = buf[5];
+  h.hops = buf[6];
+  h.rssi = (int8_t)buf[7];
+  inner = buf + LORA_RELAY_HEADER_LEN;
+  innerLen = len - LORA_RELAY_HEADER_LEN - 2;
+  return true;
+}
+
+// ========== Beacon ==========
+size_t loraBeaconEncode(uint8_t *buf, size_t cap, const LoRaBeacon &b) {
+  if (cap < LORA_BEACON_HEADER_LEN + (size_t)b.slotCount + 2) return 0;
+
+  buf[0] = LORA_FRAME_MAGIC;
+  buf[1] = LORA_FT_BEACON;
+  buf[2] = (uint8_t)(b.epoch);
+  buf[3] = (uint8_t)(b.epoch >> 8);
+  buf[4] = (uint8_t)(b.epoch >> 16);
+  buf[5] = (uint8_t)(b.epoch >> 24);
+  buf[6] = (uint8_t)(b.seq);
+  buf[7] = (uint8_t)(b.seq >> 8);
+  buf[8] = (uint8_t)(b.slotMs);
+  buf[9] = (uint8_t)(b.slotMs >> 8);
+  buf[10] = (uint8_t)(b.firstSlotMs);
+  buf[11] = (uint8_t)(b.firstSlotMs >> 8);
+  buf[12] = b.slotCount;
+  if (b.slotCount > 0) memcpy(buf + LORA_BEACON_HEADER_LEN, b.slotMap, b.slotCount);
+
+  size_t n = LORA_BEACON_HEADER_LEN + b.slotCount;
+  uint16_t crc = loraFrameCrc16(buf, n);
+  buf[n++] = (uint8_t)(crc >> 8);
+  buf[n++] = (uint8_t)crc;
+  return n;
+}
+
+bool loraBeaconDecode(const uint8_t *buf, size_t len, LoRaBeacon &b) {
+  if (len < LORA_BEACON_HEADER_LEN + 2 || !loraFrameIsBeacon(buf, len)) return false;
+
+  uint16_t crc = ((uint16_t)buf[len - 2] << 8) | buf[len - 1];
+  if (loraFrameCrc16(buf, len - 2) != crc) return false;
+  if (len != LORA_BEACON_HEADER_LEN + (size_t)buf[12] + 2) return false;
+
+  b.epoch = (uint32_t)buf[2] | ((uint32_t)buf[3] << 8) |
+            ((uint32_t)buf[4] << 16) | ((uint32_t)buf[5] << 24);
+  b.seq = (uint16_t)buf[6] | ((uint16_t)buf[7] << 8);
+  b.slotMs = (uint16_t)buf[8] | ((uint16_t)buf[9] << 8);
+  b.firstSlotMs = (uint16_t)buf[10] | ((uint16_t)buf[11] << 8);
+  b.slotCount = buf[12];
+  b.slotMap = buf + LORA_BEACON_HEADER_LEN;
+  return true;
+}
+
+// ========== Group Command ==========
+size_t loraGroupEncode(uint8_t *buf, size_t cap, const LoRaGroupFrame &g) {
+  if (g.bitmapLen == 0 || g.bitmapLen > LORA_GROUP_MAX_BITMAP) return 0;
+  if (cap < LORA_GROUP_HEADER_LEN + (size_t)g.bitmapLen + 2) return 0;
+
+  buf[0] = LORA_FRAME_MAGIC;
+  buf[1] = LORA_FT_GROUP;
+  buf[2] = g.op;
+  buf[3] = (uint8_t)(g.mid);
+  buf[4] = (uint8_t)(g.mid >> 8);
+  buf[5] = (uint8_t)(g.mid >> 16);
+  buf[6] = (uint8_t)(g.mid >> 24);
+  buf[7] = (uint8_t)(g.schedHash);
+  buf[8] = (uint8_t)(g.schedHash >> 8);
+  buf[9] = (uint8_t)(g.slotMs);
+  buf[10] = (uint8_t)(g.slotMs >> 8);
+  buf[11] = g.base;
+  buf[12] = g.bitmapLen;
+  memcpy(buf + LORA_GROUP_HEADER_LEN, g.bitmap, g.bitmapLen);
+
+  size_t n = LORA_GROUP_HEADER_LEN + g.bitmapLen;
+  uint16_t crc = loraFrameCrc16(buf, n);
+  buf[n++] = (uint8_t)(crc >> 8);
+  buf[n++] = (uint8_t)crc;
+  return n;
+}
+
+bool loraGroupDecode(const uint8_t *buf, size_t len, LoRaGroupFrame &g) {
+  if (len < LORA_GROUP_HEADER_LEN + 1 + 2 || !loraFrameIsGroup(buf, len)) return false;
+
+  uint16_t crc = ((uint16_t)buf[len - 2] << 8) | buf[len - 1];
+  if (loraFrameCrc16(buf, len - 2) != crc) return false;
+  if (buf[12] == 0 || buf[12] > LORA_GROUP_MAX_BITMAP) return false;
+  if (len != LORA_GROUP_HEADER_LEN + (size_t)buf[12] + 2) return false;
+
+  g.op = buf[2];
+  g.mid = (uint32_t)buf[3] | ((uint32_t)buf[4] << 8) |
+          ((uint32_t)buf[5] << 16) | ((uint32_t)buf[6] << 24);
+  g.schedHash = (uint16_t)buf[7] | ((uint16_t)buf[8] << 8);
+  g.slotMs = (uint16_t)buf[9] | ((uint16_t)buf[10] << 8);
+  g.base = buf[11];
+  g.bitmapLen = buf[12];
+  g.bitmap = buf + LORA_GROUP_HEADER_LEN;
+  return true;
+}
+
+int loraGroupRank(const LoRaGroupFrame &g, uint8_t node) {
+  if (node < g.base) return -1;
+  int bit = node - g.base;
+  if (bit >= g.bitmapLen * 8) return -1;
+  if (!(g.bitmap[bit / 8] & (1 << (bit % 8)))) return -1;
+
+  int rank = 0;
+  for (int i = 0; i < bit; i++) {
+    if (g.bitmap[i / 8] & (1 << (i % 8))) rank++;
+  }
+  return rank;
+}
+
+// ========== Valve Plan ==========
+size_t loraValvePlanEncode(uint8_t *buf, size_t cap, const LoRaValveStep *steps, uint8_t count) {
+  if (count == 0 || count > LORA_VALVE_PLAN_MAX || cap < (size_t)count * 3) return 0;
+  size_t n = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    buf[n++] = steps[i].valve;
+    buf[n++] = (uint8_t)(steps[i].seconds);
+    buf[n++] = (uint8_t)(steps[i].seconds >> 8);
+  }
+  return n;
+}
+
+uint8_t loraValvePlanDecode(const uint8_t *params, uint8_t len, LoRaValveStep *steps, uint8_t cap) {
+  if (len % 3 == LORA_FRAME_DELAY_LEN % 3 && len > LORA_FRAME_DELAY_LEN) len -= LORA_FRAME_DELAY_LEN;
+  if (len == 0 || len % 3 != 0 || len / 3 > cap) return 0;
+  uint8_t count = len / 3;
+  for (uint8_t i = 0; i < count; i++) {
+    const uint8_t *p = params + i * 3;
+    if (p[0] < 1 || p[0] > 8) return 0;
+    steps[i].valve = p[0];
+    steps[i].seconds = (uint16_t)p[1] | ((uint16_t)p[2] << 8);
+  }
+  return count;
+}
+
+bool loraFrameStartDelay(const LoRaFrame &f, uint32_t &delayMs) {
+  const uint8_t *p;
+  if (f.op == LORA_OP_OPEN && f.paramsLen == LORA_FRAME_DELAY_LEN) {
+    p = f.params;
+  } else if (f.op == LORA_OP_VSET && f.paramsLen > LORA_FRAME_DELAY_LEN &&
+             f.paramsLen % 3 == LORA_FRAME_DELAY_LEN % 3) {
+    p = f.params + f.paramsLen - LORA_FRAME_DELAY_LEN;
+  } else {
+    return false;
+  }
+  delayMs = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+  return true;
+}
+
+// ========== Firmware Update ==========
+static size_t fuotaFinish(uint8_t *buf, size_t n) {
+  uint16_t crc = loraFrameCrc16(buf, n);
+  buf[n++] = (uint8_t)(crc >> 8);
+  buf[n++] = (uint8_t)crc;
+  return n;
+}
+
+size_t loraFuotaSetupEncode(uint8_t *buf, size_t cap, const LoRaFuotaSetup &s) {
+  if (s.bitmapLen == 0 || s.bitmapLen > LORA_GROUP_MAX_BITMAP) return 0;
+  if (cap < LORA_FUOTA_SETUP_HEADER_LEN + (size_t)s.bitmapLen + 2) return 0;
+
+  buf[0] = LORA_FRAME_MAGIC;
+  buf[1] = LORA_FT_FUOTA;
+  buf[2] = s.session;
+  buf[3] = LORA_FUOTA_SETUP;
+  for (int i = 0; i < 4; i++) {
+    buf[4 + i] = (uint8_t)(s.imageSize >> (8 * i));
+    buf[8 + i] = (uint8_t)(s.imageCrc >> (8 * i));
+  }
+  buf[12] = s.fragSize;
+  buf[13] = (uint8_t)(s.fragCount);
+  buf[14] = (uint8_t)(s.fragCount >> 8);
+  buf[15] = s.fecSpan;
+  buf[16] = s.base;
+  buf[17] = s.bitmapLen;
+  memcpy(buf + LORA_FUOTA_SETUP_HEADER_LEN, s.bitmap, s.bitmapLen);
+  return fuotaFinish(buf, LORA_FUOTA_SETUP_HEADER_LEN + s.bitmapLen);
+}
+
+size_t loraFuotaQueryEncode(uint8_t *buf, size_t cap, uint8_t session, uint8_t node, uint16_t from) {
+  if (cap < 7 + 2) return 0;
+
+  buf[0] = LORA_FRAME_MAGIC;
+  buf[1] = LORA_FT_FUOTA;
+  buf[2] = session;
+  buf[3] = LORA_FUOTA_QUERY;
+  buf[4] = node;
+  buf[5] = (uint8_t)(from);
+  buf[6] = (uint8_t)(from >> 8);
+  return fuotaFinish(buf, 7);
+}
+
+size_t loraFuotaEndEncode(uint8_t *buf, size_t cap, uint8_t session, uint32_t imageCrc) {
+  if (cap < 8 + 2) return 0;
+
+  buf[0] = LORA_FRAME_MAGIC;
+  buf[1] = LORA_FT_FUOTA;
+  buf[2] = session;
+  buf[3] = LORA_FUOTA_END;
+  for (int i = 0; i < 4; i++) buf[4 + i] = (uint8_t)(imageCrc >> (8 * i));
+  return fuotaFinish(buf, 8);
+}
+
+size_t loraFragEncode(uint8_t *buf, size_t cap, uint8_t session, uint16_t index,
+                      const uint8_t *payload, size_t payloadLen) {
+  if (cap < LORA_FRAG_HEADER_LEN + payloadLen + 2) return 0;
+
+  buf[0] = LORA_FRAME_MAGIC;
+  buf[1] = LORA_FT_FRAG;
+  buf[2] = session;
+  buf[3] = (uint8_t)(index);
+  buf[4] = (uint8_t)(index >> 8);
+  memcpy(buf + LORA_FRAG_HEADER_LEN, payload, payloadLen);
+  return fuotaFinish(buf, LORA_FRAG_HEADER_LEN + payloadLen);
+}
+
+size_t loraFuotaStatusEncode(uint8_t *buf, size_t cap, const LoRaFuotaStatus &st) {
+  if (cap < LORA_FSTAT_HEADER_LEN + (size_t)st.bitmapLen + 2) return 0;
+
+  buf[0] = LORA_FRAME_MAGIC;
+  buf[1] = LORA_FT_FSTAT;
+  buf[2] = st.session;
+  buf[3] = st.node;
+  buf[4] = (uint8_t)(st.missing);
+  buf[5] = (uint8_t)(st.missing >> 8);
+  buf[6] = (uint8_t)(st.start);
+  buf[7] = (uint8_t)(st.start >> 8);
+  buf[8] = st.bitmapLen;
+  if (st.bitmapLen > 0) memcpy(buf + LORA_FSTAT_HEADER_LEN, st.bitmap, st.bitmapLen);
+  return fuotaFinish(buf, LORA_FSTAT_HEADER_LEN + st.bitmapLen);
+}
+
+bool loraFuotaStatusDecode(const uint8_t *buf, size_t len, LoRaFuotaStatus &st) {
+  if (len < LORA_FSTAT_HEADER_LEN + 2 || !loraFrameIsFuotaStatus(buf, len)) return false;
+
+  uint16_t crc = ((uint16_t)buf[len - 2] << 8) | buf[len - 1];
+  if (loraFrameCrc16(buf, len - 2) != crc) return false;
+  if (len != LORA_FSTAT_HEADER_LEN + (size_t)buf[8] + 2) return false;
+
+  st.session = buf[2];
+  st.node = buf[3];
+  st.missing = (uint16_t)buf[4] | ((uint16_t)buf[5] << 8);
+  st.start = (uint16_t)buf[6] | ((uint16_t)buf[7] << 8);
+  st.bitmapLen = buf[8];
+  st.bitmap = buf + LORA_FSTAT_HEADER_LEN;
+  return true;
+}
\ No newline at end of file
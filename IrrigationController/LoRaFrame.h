@@ -0,0 +1,245 @@
+// LoRaFrame.h - Compact binary LoRa frame codec
+// Shared with the node firmware: plain C types only, no Arduino/String.
+//
+// Layout (multi-byte fields little-endian):
+//   [0]     magic/version (LORA_FRAME_MAGIC) - never a printable ASCII byte
+//   [1]     frame type (LoRaFrameType)
+//   [2]     operation (LoRaFrameOp)
+//   [3..6]  MID
+//   [7]     node ID
+//   [8..9]  schedule hash (loraSchedHash, 0 = no schedule)
+//   [10]    step index (LORA_FRAME_NO_STEP = none)
+//   [11..]  duration in ms, unsigned LEB128 varint (1 byte when 0)
+//   [..]    operation parameters (SETDR: SF, power; VSET: valve plan)
+//           OPEN/VSET may end with a 32-bit start delay in ms: the node acts
+//           that long after receiving the frame (OPEN: 4 bytes, VSET: 3n+4)
+//   [n-2..] CRC16-CCITT over everything before it, big-endian
+//
+// Relay envelope (type LORA_FT_RELAY) wraps any frame, binary or ASCII:
+//   [0] magic  [1] LORA_FT_RELAY  [2] source  [3] destination
+//   [4] next relay (0 = deliver to destination)  [5] transmitter of this hop
+//   [6] hop count  [7] RSSI the forwarding relay heard the previous hop at
+//   [8..n-3] inner frame  [n-2..] CRC16
+//
+// Beacon (type LORA_FT_BEACON), broadcast by the gateway:
+//   [0] magic  [1] LORA_FT_BEACON  [2..5] epoch seconds (0 = not synced)
+//   [6..7] beacon sequence  [8..9] slot length ms  [10..11] slot 0 offset ms
+//   [12] slot count  [13..] node ID per slot (0 = free)  [n-2..] CRC16
+//
+// Group command (type LORA_FT_GROUP), one frame for many nodes:
+//   [0] magic  [1] LORA_FT_GROUP  [2] operation  [3..6] MID
+//   [7..8] schedule hash  [9..10] reply slot ms  [11] base node ID
+//   [12] bitmap bytes  [13..] bitmap, bit i = node base+i  [n-2..] CRC16
+// Each addressed node answers with an ordinary ACK carrying the group MID,
+// loraGroupRank() reply slots after the end of the frame.
+//
+// Firmware update control (type LORA_FT_FUOTA), gateway to nodes:
+//   [0] magic  [1] LORA_FT_FUOTA  [2] session  [3] command (LoRaFuotaCmd)
+//   SETUP: [4..7] image size  [8..11] image CRC32  [12] fragment size
+//          [13..14] data fragments  [15] FEC span  [16] base node ID
+//          [17] bitmap bytes  [18..] bitmap, bit i = node base+i
+//   QUERY: [4] node ID  [5..6] first fragment of interest
+//   END:   [4..7] image CRC32 - nodes verify, apply and reboot
+//   [n-2..] CRC16
+//
+// Firmware fragment (type LORA_FT_FRAG), multicast, never acked:
+//   [0] magic  [1] LORA_FT_FRAG  [2] session  [3..4] index  [5..] payload
+//   [n-2..] CRC16
+// Indexes below the data fragment count carry the image; index count+p is
+// the XOR of data fragments p*span .. p*span+span-1 (last one zero-padded),
+// so a node rebuilds any single fragment lost within a span.
+//
+// Firmware status (type LORA_FT_FSTAT), node reply to QUERY:
+//   [0] magic  [1] LORA_FT_FSTAT  [2] session  [3] node ID
+//   [4..5] data fragments still missing after FEC  [6..7] window start
+//   [8] bitmap bytes  [9..] bit i = fragment start+i missing  [n-2..] CRC16
+// The window starts at the first missing fragment at or after the QUERY's.
+#ifndef LORA_FRAME_H
+#define LORA_FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define LORA_FRAME_MAGIC 0xB1         // 0xB0 | version 1
+#define LORA_FRAME_MIN_LEN 14         // Header + 1-byte duration + CRC
+#define LORA_FRAME_MAX_PARAMS 16
+#define LORA_FRAME_DELAY_LEN 4        // Start delay trailer on OPEN/VSET
+#define LORA_VALVE_PLAN_MAX 4         // VSET entries, 3 bytes each
+#define LORA_FRAME_NO_STEP 0xFF
+#define LORA_RELAY_HEADER_LEN 8
+#define LORA_BEACON_HEADER_LEN 13
+#define LORA_GROUP_HEADER_LEN 13
+#define LORA_GROUP_MAX_BITMAP 32      // Covers node IDs 0-255
+#define LORA_FUOTA_SETUP_HEADER_LEN 18
+#define LORA_FRAG_HEADER_LEN 5
+#define LORA_FSTAT_HEADER_LEN 9
+
+enum LoRaFrameType {
+  LORA_FT_CMD = 1,
+  LORA_FT_ACK = 2,
+  LORA_FT_NAK = 3,
+  LORA_FT_RELAY = 4,
+  LORA_FT_BEACON = 5,
+  LORA_FT_GROUP = 6,
+  LORA_FT_FUOTA = 7,
+  LORA_FT_FRAG = 8,
+  LORA_FT_FSTAT = 9
+};
+
+enum LoRaFuotaCmd {
+  LORA_FUOTA_SETUP = 1,
+  LORA_FUOTA_QUERY = 2,
+  LORA_FUOTA_END = 3
+};
+
+enum LoRaFrameOp {
+  LORA_OP_NONE = 0,
+  LORA_OP_OPEN = 1,
+  LORA_OP_CLOSE = 2,
+  LORA_OP_PING = 3,
+  LORA_OP_PONG = 4,
+  LORA_OP_STATUS = 5,
+  LORA_OP_SETDR = 6,
+  LORA_OP_VSET = 7            // Close every valve, then run the plan in params
+};
+
+// Decoded frame. Parsing doesn't copy: params points into the receive buffer.
+struct LoRaFrame {
+  uint8_t type;
+  uint8_t op;
+  uint32_t mid;
+  uint8_t node;
+  uint16_t schedHash;
+  uint8_t step;
+  uint32_t durationMs;
+  const uint8_t *params;
+  uint8_t paramsLen;
+};
+
+// Relay envelope header; the inner frame stays in the receive buffer
+struct LoRaRelayHeader {
+  uint8_t src;
+  uint8_t dst;
+  uint8_t via;
+  uint8_t last;
+  uint8_t hops;
+  int8_t rssi;
+};
+
+// Beacon fields; slotMap points into the buffer
+struct LoRaBeacon {
+  uint32_t epoch;
+  uint16_t seq;
+  uint16_t slotMs;
+  uint16_t firstSlotMs;
+  uint8_t slotCount;
+  const uint8_t *slotMap;
+};
+
+// Group command fields; bitmap points into the buffer
+struct LoRaGroupFrame {
+  uint8_t op;
+  uint32_t mid;
+  uint16_t schedHash;
+  uint16_t slotMs;
+  uint8_t base;
+  uint8_t bitmapLen;
+  const uint8_t *bitmap;
+};
+
+// One VSET plan entry: [valve] [seconds, 16-bit LE]. The node opens the
+// valves one after another, each for its time, then closes the last.
+struct LoRaValveStep {
+  uint8_t valve;              // 1-8
+  uint16_t seconds;
+};
+
+// Firmware session announcement; bitmap points into the buffer
+struct LoRaFuotaSetup {
+  uint8_t session;
+  uint32_t imageSize;
+  uint32_t imageCrc;
+  uint8_t fragSize;
+  uint16_t fragCount;         // Data fragments
+  uint8_t fecSpan;
+  uint8_t base;
+  uint8_t bitmapLen;
+  const uint8_t *bitmap;
+};
+
+// Node firmware status; bitmap points into the buffer
+struct LoRaFuotaStatus {
+  uint8_t session;
+  uint8_t node;
+  uint16_t missing;
+  uint16_t start;
+  uint8_t bitmapLen;
+  const uint8_t *bitmap;
+};
+
+uint16_t loraFrameCrc16(const uint8_t *data, size_t len);
+uint32_t loraCrc32(uint32_t crc, const uint8_t *data, size_t len);
+uint16_t loraSchedHash(const char *schedId);
+uint8_t loraOpFromName(const char *name);
+const char *loraOpName(uint8_t op);
+
+inline bool loraFrameIsBinary(const uint8_t *buf, size_t len) {
+  return len > 0 && buf[0] == LORA_FRAME_MAGIC;
+}
+
+inline bool loraFrameIsRelay(const uint8_t *buf, size_t len) {
+  return len > 1 && buf[0] == LORA_FRAME_MAGIC && buf[1] == LORA_FT_RELAY;
+}
+
+inline bool loraFrameIsBeacon(const uint8_t *buf, size_t len) {
+  return len > 1 && buf[0] == LORA_FRAME_MAGIC && buf[1] == LORA_FT_BEACON;
+}
+
+inline bool loraFrameIsGroup(const uint8_t *buf, size_t len) {
+  return len > 1 && buf[0] == LORA_FRAME_MAGIC && buf[1] == LORA_FT_GROUP;
+}
+
+inline bool loraFrameIsFuotaStatus(const uint8_t *buf, size_t len) {
+  return len > 1 && buf[0] == LORA_FRAME_MAGIC && buf[1] == LORA_FT_FSTAT;
+}
+
+// Returns the encoded length, 0 if it doesn't fit in cap
+size_t loraFrameEncode(uint8_t *buf, size_t cap, const LoRaFrame &f);
+
+// Validates magic, length and CRC; out.params points into buf
+bool loraFrameDecode(const uint8_t *buf, size_t len, LoRaFrame &out);
+
+// Wraps inner in a relay envelope; returns the length, 0 if it doesn't fit
+size_t loraRelayEncode(uint8_t *buf, size_t cap, const LoRaRelayHeader &h,
+                       const uint8_t *inner, size_t innerLen);
+
+// Validates the envelope; inner points into buf
+bool loraRelayDecode(const uint8_t *buf, size_t len, LoRaRelayHeader &h,
+                     const uint8_t *&inner, size_t &innerLen);
+
+size_t loraBeaconEncode(uint8_t *buf, size_t cap, const LoRaBeacon &b);
+bool loraBeaconDecode(const uint8_t *buf, size_t len, LoRaBeacon &b);
+
+size_t loraGroupEncode(uint8_t *buf, size_t cap, const LoRaGroupFrame &g);
+bool loraGroupDecode(const uint8_t *buf, size_t len, LoRaGroupFrame &g);
+
+// Reply slot of node (number of addressed nodes before it), -1 if not addressed
+int loraGroupRank(const LoRaGroupFrame &g, uint8_t node);
+
+// VSET params; returns the length, 0 if the plan doesn't fit
+size_t loraValvePlanEncode(uint8_t *buf, size_t cap, const LoRaValveStep *steps, uint8_t count);
+// Returns the entries decoded, 0 if the params aren't a plan (a start delay
+// trailer is skipped)
+uint8_t loraValvePlanDecode(const uint8_t *params, uint8_t len, LoRaValveStep *steps, uint8_t cap);
+// Start delay of an OPEN/VSET frame; false if it has none
+bool loraFrameStartDelay(const LoRaFrame &f, uint32_t &delayMs);
+
+size_t loraFuotaSetupEncode(uint8_t *buf, size_t cap, const LoRaFuotaSetup &s);
+size_t loraFuotaQueryEncode(uint8_t *buf, size_t cap, uint8_t session, uint8_t node, uint16_t from);
+size_t loraFuotaEndEncode(uint8_t *buf, size_t cap, uint8_t session, uint32_t imageCrc);
+size_t loraFragEncode(uint8_t *buf, size_t cap, uint8_t session, uint16_t index,
+                      const uint8_t *payload, size_t payloadLen);
+size_t loraFuotaStatusEncode(uint8_t *buf, size_t cap, const LoRaFuotaStatus &st);
+bool loraFuotaStatusDecode(const uint8_t *buf, size_t len, LoRaFuotaStatus &st);
+
+#endif // LORA_FRAME_H
\ No newline at end of file
@@ -1,12 +1,13 @@
 // MessageQueue.cpp
 #include "MessageQueue.h"
 
-MessageQueue::MessageQueue() : head(0), tail(0) {}
+MessageQueue::MessageQueue() : head(0), tail(0), dropped(0) {}
 
 bool MessageQueue::enqueue(const String &msg) {
   int next = (tail + 1) % INCOMING_QUEUE_SIZE;
   if (next == head) {
     head = (head + 1) % INCOMING_QUEUE_SIZE;
+    dropped++;
   }
   queue[tail] = msg;
   tail = next;
@@ -27,4 +28,17 @@ int MessageQueue::size() {
 
 bool MessageQueue::isEmpty() {
   return head == tail;
+}
+
+bool MessageQueue::isFull() {
+  return (tail + 1) % INCOMING_QUEUE_SIZE == head;
+}
+
+void MessageQueue::clear() {
+  head = 0;
+  tail = 0;
+}
+
+uint32_t MessageQueue::droppedCount() {
+  return dropped;
 }
\ No newline at end of file
@@ -10,6 +10,7 @@ private:
   String queue[INCOMING_QUEUE_SIZE];
   int head;
   int tail;
+  uint32_t dropped;           // Oldest messages overwritten while full
 
 public:
   MessageQueue();
@@ -19,6 +20,7 @@ public:
   bool isEmpty();
   bool isFull();
   void clear();
+  uint32_t droppedCount();
 };
 
 // Global instance
@@ -5,6 +5,18 @@ HardwareSerial SerialAT(1);  // Use Serial1 for modem
 
 // Define static member variable (shared across all instances)
 bool ModemBase::modemReady = false;
+unsigned long ModemBase::restartedAt = 0;
+
+AtCommand ModemBase::atQueue[MODEM_AT_QUEUE_SLOTS];
+uint8_t ModemBase::atHead = 0;
+uint8_t ModemBase::atCount = 0;
+bool ModemBase::atActive = false;
+bool ModemBase::atBodySent = false;
+unsigned long ModemBase::atSentAt = 0;
+unsigned long ModemBase::atGuardUntil = 0;
+String ModemBase::atLine;
+String ModemBase::atResp;
+AtStats ModemBase::atStats = {0, 0, 0, 0, 0, 0, 0, 0};
 
 ModemBase::ModemBase() {
   serial = &SerialAT;
@@ -237,61 +249,241 @@ bool ModemBase::init() {
   return true;
 }
 
-String ModemBase::sendCommand(const String &cmd, uint32_t timeout) {
-  Serial.println("[Modem] TX: " + cmd);
+// ========== AT Engine ==========
+// Commands queue up and are written one at a time; serviceAT() reads whatever
+// the UART holds, splits it into lines and hands each to the command in flight
+// or, if unsolicited, to handleURC(). The next command is written the moment
+// the current one's final result line arrives, before its callback runs. After
+// a timeout it waits MODEM_AT_GUARD_MS instead, so a late OK/ERROR can't
+// complete the wrong command.
 
-  // Clear input buffer
-  clearSerialBuffer();
+// Unsolicited lines that may arrive in the middle of another command's response.
+// Nothing here may also be an intermediate response of a command that ends in
+// "OK" (+CPIN: for AT+CPIN?), or that response never reaches its callback.
+static const char *const URC_PREFIXES[] = {
+  "RDY", "POWERED DOWN", "+QIND", "+CMTI:", "+CDS:", "+QMTSTAT:", "+QMTRECV:",
+  "+QMTPUB:", "+QMTSUB:", "+QMTOPEN:", "+QMTCONN:", "+QMTDISC:"
+};
 
-  // Send command
-  SerialAT.println(cmd);
+static bool isErrorResult(const String &line) {
+  return line == "ERROR" || line.startsWith("+CME ERROR") || line.startsWith("+CMS ERROR");
+}
 
-  // Wait for response
-  unsigned long start = millis();
-  String response = "";
+bool ModemBase::sendCommandAsync(const String &cmd, uint32_t timeout, const char *final,
+                                 AtCallback callback, void *ctx, const String &body) {
+  if (atCount >= MODEM_AT_QUEUE_SLOTS) {
+    atStats.dropped++;
+    Serial.println("[Modem] ❌ AT queue full, dropped: " + cmd);
+    return false;
+  }
 
-  while (millis() - start < timeout) {
-    if (SerialAT.available()) {
-      char c = SerialAT.read();
-      response += c;
+  AtCommand &c = atQueue[(atHead + atCount) % MODEM_AT_QUEUE_SLOTS];
+  c.cmd = cmd;
+  c.body = body;
+  c.final = final;
+  c.timeoutMs = timeout;
+  c.callback = callback;
+  c.ctx = ctx;
+  atCount++;
 
-      // Check if we got OK
-      if (response.indexOf("OK\r\n") >= 0) {
-        break;
-      }
+  writeNext();
+  return true;
+}
+
+void ModemBase::writeNext() {
+  if (atActive || atCount == 0 || inGuard()) return;
+
+  AtCommand &c = atQueue[atHead];
+  Serial.println("[Modem] TX: " + c.cmd);
+  SerialAT.print(c.cmd);
+  SerialAT.print("\r\n");
+
+  atActive = true;
+  atBodySent = false;
+  atSentAt = millis();
+  atResp = "";
+  atStats.sent++;
+}
+
+// Blocking form for the init/configure sequences: pumps the engine until
+// this command completes. Loop-time traffic should use sendCommandAsync().
+struct AtWait {
+  bool done;
+  bool ok;
+  String resp;
+};
+
+static void onWaitResult(bool ok, const String &resp, void *ctx) {
+  AtWait *w = (AtWait *)ctx;
+  w->done = true;
+  w->ok = ok;
+  w->resp = resp;
+}
+
+String ModemBase::sendCommand(const String &cmd, uint32_t timeout, const char *final) {
+  AtWait wait;
+  wait.done = false;
+  wait.ok = false;
+
+  if (!sendCommandAsync(cmd, timeout, final, onWaitResult, &wait)) {
+    return "";
+  }
 
-      // Check if we got ERROR - wait a bit more to get the error code
-      if (response.indexOf("ERROR") >= 0) {
-        // Wait to capture complete error message (CME/CMS error codes)
-        delay(200);
-        while (SerialAT.available()) {
-          response += (char)SerialAT.read();
-        }
-        break;
+  while (!wait.done) {
+    serviceAT();
+    if (!wait.done) delay(1);
+  }
+
+  return wait.resp;
+}
+
+void ModemBase::serviceAT() {
+  while (SerialAT.available()) {
+    char c = SerialAT.read();
+
+    // Text-mode SMS: the modem asks for the body with "> " and no line end
+    if (c == '>' && atActive && !atBodySent && atLine.length() == 0 &&
+        atQueue[atHead].body.length() > 0) {
+      SerialAT.print(atQueue[atHead].body);
+      SerialAT.write(0x1A);  // Ctrl+Z sends it
+      atBodySent = true;
+      continue;
+    }
+
+    if (c == '\n') {
+      String line = atLine;  // Handlers may re-enter serviceAT()
+      atLine = "";
+      line.trim();
+      if (line.length() > 0) {
+        handleLine(line);
       }
+    } else if (c != '\r' && atLine.length() < MODEM_AT_LINE_MAX) {
+      atLine += c;
     }
-    delay(1);
   }
 
-  if (response.length() > 0) {
-    Serial.println("[Modem] RX: " + response);
+  if (atActive && millis() - atSentAt >= atQueue[atHead].timeoutMs) {
+    atStats.timeouts++;
+    Serial.println("[Modem] ⚠ AT timeout: " + atQueue[atHead].cmd);
+    atGuardUntil = millis() + MODEM_AT_GUARD_MS;
+    if (atGuardUntil == 0) atGuardUntil = 1;
+    completeActive(false);
+  }
+
+  // Resumes the queue once a guard time is over
+  writeNext();
+}
+
+// True for MODEM_AT_GUARD_MS after a timeout
+bool ModemBase::inGuard() {
+  if (atGuardUntil == 0) return false;
+  if ((long)(millis() - atGuardUntil) >= 0) {
+    atGuardUntil = 0;
+    return false;
+  }
+  return true;
+}
+
+bool ModemBase::isURC(const String &line) {
+  for (size_t i = 0; i < sizeof(URC_PREFIXES) / sizeof(URC_PREFIXES[0]); i++) {
+    if (line.startsWith(URC_PREFIXES[i])) return true;
+  }
+  return false;
+}
+
+void ModemBase::handleLine(const String &line) {
+  // The timed-out command's result, or the rest of its response
+  if (!atActive && inGuard() && !isURC(line)) {
+    atStats.stray++;
+    Serial.println("[Modem] ⚠ Late AT response dropped: " + line);
+    return;
+  }
+
+  if (!atActive) {
+    atStats.urcs++;
+    handleURC(line);
+    return;
+  }
+
+  bool isFinal = line.startsWith(atQueue[atHead].final);
+  bool isError = isErrorResult(line);
+  if (!isFinal && !isError && isURC(line)) {
+    atStats.urcs++;
+    handleURC(line);
+    return;
+  }
+
+  if (atResp.length() > 0) atResp += "\n";
+  atResp += line;
+
+  if (isFinal) {
+    atStats.ok++;
+    completeActive(true);
+  } else if (isError) {
+    atStats.failed++;
+    completeActive(false);
+  }
+}
+
+void ModemBase::completeActive(bool ok) {
+  unsigned long latency = millis() - atSentAt;
+  if (latency > atStats.maxLatencyMs) atStats.maxLatencyMs = latency;
+
+  AtCallback callback = atQueue[atHead].callback;
+  void *ctx = atQueue[atHead].ctx;
+  String resp = atResp;
+
+  atQueue[atHead].cmd = "";
+  atQueue[atHead].body = "";
+  atHead = (atHead + 1) % MODEM_AT_QUEUE_SLOTS;
+  atCount--;
+  atActive = false;
+
+  if (resp.length() > 0) {
+    Serial.println("[Modem] RX: " + resp);
   } else {
     Serial.println("[Modem] RX: (timeout)");
   }
 
-  return response;
-}
+  // Next command goes out before this response is acted on
+  writeNext();
 
-void ModemBase::clearSerialBuffer() {
-  while (SerialAT.available()) {
-    SerialAT.read();
+  if (callback != nullptr) {
+    callback(ok, resp, ctx);
   }
 }
 
+void ModemBase::handleURC(const String &line) {
+  Serial.println("[Modem] URC: " + line);
+}
+
+int ModemBase::atPending() {
+  return atCount;
+}
+
+String ModemBase::atReport() {
+  return "queued=" + String(atCount) + " sent=" + String(atStats.sent) +
+         " ok=" + String(atStats.ok) + " err=" + String(atStats.failed) +
+         " timeout=" + String(atStats.timeouts) + " dropped=" + String(atStats.dropped) +
+         " stray=" + String(atStats.stray) + " urc=" + String(atStats.urcs) +
+         " maxMs=" + String(atStats.maxLatencyMs);
+}
+
 bool ModemBase::isReady() {
   return modemReady;
 }
 
+// Configuration is lost on a modem restart; the modem needs a few seconds
+// after RDY before it takes it again
+void ModemBase::noteRestart() {
+  restartedAt = millis();
+  if (restartedAt == 0) restartedAt = 1;
+}
+
+bool ModemBase::restartSettled() {
+  return restartedAt == 0 || millis() - restartedAt >= MODEM_RESTART_SETTLE_MS;
+}
+
 String ModemBase::getSignalQuality() {
   String csq = sendCommand("AT+CSQ", 1000);
   
@@ -317,13 +509,6 @@ String ModemBase::getOperator() {
 }
 
 void ModemBase::processBackground() {
-  // Process any unsolicited response codes (URCs)
-  while (SerialAT.available()) {
-    String urc = SerialAT.readStringUntil('\n');
-    urc.trim();
-    
-    if (urc.length() > 0) {
-      Serial.println("[Modem] URC: " + urc);
-    }
-  }
+  // Advance queued commands and dispatch unsolicited response codes (URCs)
+  serviceAT();
 }
@@ -5,13 +5,64 @@
 #include <Arduino.h>
 #include "Config.h"
 
+// Completion of a queued AT command. resp holds the command's response lines
+// (joined with '\n', final result last); ok is false on ERROR or timeout.
+typedef void (*AtCallback)(bool ok, const String &resp, void *ctx);
+
+// One AT command in the engine's queue
+struct AtCommand {
+  String cmd;
+  String body;                // Sent after the '>' prompt, then Ctrl+Z ("" = none)
+  const char *final;          // Line that completes it, e.g. "OK" or "+QMTOPEN:"
+  uint32_t timeoutMs;         // From when the command is written
+  AtCallback callback;
+  void *ctx;
+};
+
+struct AtStats {
+  uint32_t sent;
+  uint32_t ok;
+  uint32_t failed;            // ERROR / +CME ERROR / +CMS ERROR
+  uint32_t timeouts;
+  uint32_t dropped;           // Queue full
+  uint32_t stray;             // Late results dropped in the guard time after a timeout
+  uint32_t urcs;
+  uint32_t maxLatencyMs;      // Longest write-to-final-result time
+};
+
 class ModemBase {
 protected:
   HardwareSerial *serial;
   static bool modemReady;  // Shared across all modem instances (only one physical modem)
+  static unsigned long restartedAt;  // RDY seen, 0 = not since boot
+
+  // AT engine - one queue for the one physical modem, advanced by serviceAT()
+  static AtCommand atQueue[MODEM_AT_QUEUE_SLOTS];
+  static uint8_t atHead;
+  static uint8_t atCount;
+  static bool atActive;       // atQueue[atHead] written, waiting for its final result
+  static bool atBodySent;
+  static unsigned long atSentAt;
+  static unsigned long atGuardUntil;  // No writes before this after a timeout
+  static String atLine;
+  static String atResp;
+  static AtStats atStats;
+
+  bool sendCommandAsync(const String &cmd, uint32_t timeout = 2000, const char *final = "OK",
+                        AtCallback callback = nullptr, void *ctx = nullptr,
+                        const String &body = "");
+  String sendCommand(const String &cmd, uint32_t timeout = 2000, const char *final = "OK");
+  void serviceAT();
+  virtual void handleURC(const String &line);
+  static void noteRestart();
+  static bool restartSettled();
 
-  String sendCommand(const String &cmd, uint32_t timeout = 2000);
-  void clearSerialBuffer();
+private:
+  static void writeNext();
+  static bool inGuard();
+  static bool isURC(const String &line);
+  void handleLine(const String &line);
+  void completeActive(bool ok);
 
 public:
   ModemBase();
@@ -20,8 +71,10 @@ public:
   void processBackground();
   String getSignalQuality();
   String getOperator();
+  static int atPending();
+  static String atReport();
 };
 
 extern HardwareSerial SerialAT;
 
-#endif
+#endif
\ No newline at end of file
@@ -1,12 +1,13 @@
 // ModemMQTT.cpp - MQTT communication for Quectel EC200U
 #include "ModemMQTT.h"
+#include "MessageQueue.h"
 #include <vector>
 
 // Shared URC buffer for forwarding non-MQTT URCs to SMS handler
 // MQTT processBackground() runs first and buffers URCs for SMS
 static std::vector<String> sharedURCBuffer;
 
-ModemMQTT::ModemMQTT() : mqttConnected(false), needsReconfigure(false), lastMqttCheck(0), mqttCheckInterval(30000), lastReconfigAttempt(0), reconfigAttempts(0), cooldownStartTime(0), inCooldown(false) {}
+ModemMQTT::ModemMQTT() : mqttConnected(false), needsReconfigure(false), lastMqttCheck(0), mqttCheckInterval(30000), lastReconfigAttempt(0), reconfigAttempts(0), cooldownStartTime(0), inCooldown(false), cfgStage(MQTT_CFG_IDLE), cfgWaiting(false), cfgNextAt(0), pubDropped(0), pubFailed(0) {}
 
 // Escape quotes and backslashes in strings for AT commands
 String ModemMQTT::escapeATString(const String &input) {
@@ -24,6 +25,10 @@ String ModemMQTT::escapeATString(const String &input) {
   return result;
 }
 
+// Starts the configuration sequence; configStep() sends each command from
+// processBackground() once the previous one's result is in, so no step waits
+// on the modem. Returns false if it couldn't start - the outcome arrives later
+// (isConnected(), or the log).
 bool ModemMQTT::configure() {
   if (!modemReady) {
     Serial.println("[MQTT] ❌ Modem not ready for MQTT");
@@ -31,350 +36,404 @@ bool ModemMQTT::configure() {
     return false;
   }
 
+  if (cfgStage != MQTT_CFG_IDLE) {
+    Serial.println("[MQTT] ⚠ Configuration already in progress");
+    return false;
+  }
+
   Serial.println("[MQTT] Configuring...");
 
   // IMPORTANT: Clean up any existing MQTT connections first
   // This is critical after modem restart to clear old state
   Serial.println("[MQTT] Cleaning up old connections...");
-  sendCommand("AT+QMTDISC=0", 2000);
-  delay(500);
-  sendCommand("AT+QMTCLOSE=0", 2000);
-  delay(500);
+  mqttConnected = false;
+  cfgStage = MQTT_CFG_DISC;
+  cfgWaiting = false;
+  cfgNextAt = millis();
+  configStep();
 
-  // Configure MQTT connection for EC200U
-  // AT+QMTCFG="version",<client_idx>,<vsn>
-  sendCommand("AT+QMTCFG=\"version\",0,4", 2000);  // MQTT 3.1.1
-
-  // Set keep-alive
-  sendCommand("AT+QMTCFG=\"keepalive\",0,120", 2000);
-
-  // Set clean session
-  sendCommand("AT+QMTCFG=\"session\",0,0", 2000);
+  return true;
+}
 
-  // Set timeout
-  sendCommand("AT+QMTCFG=\"timeout\",0,30,3,0", 2000);
+bool ModemMQTT::isConfiguring() {
+  return cfgStage != MQTT_CFG_IDLE;
+}
 
-  // Open MQTT connection
-  if (!openMQTTConnection()) {
-    // Don't clear needsReconfigure - let needsReconfiguration() manage attempts
-    return false;
+void ModemMQTT::configStep() {
+  if (cfgStage == MQTT_CFG_IDLE || cfgWaiting) return;
+  if ((long)(millis() - cfgNextAt) < 0) return;
+
+  String cmd;
+  uint32_t timeout = 2000;
+  const char *final = "OK";
+
+  switch (cfgStage) {
+    case MQTT_CFG_DISC:
+      cmd = "AT+QMTDISC=0";
+      break;
+    case MQTT_CFG_CLOSE:
+      cmd = "AT+QMTCLOSE=0";
+      break;
+
+    // Configure MQTT connection for EC200U
+    // AT+QMTCFG="version",<client_idx>,<vsn>
+    case MQTT_CFG_VERSION:
+      cmd = "AT+QMTCFG=\"version\",0,4";  // MQTT 3.1.1
+      break;
+    case MQTT_CFG_KEEPALIVE:
+      cmd = "AT+QMTCFG=\"keepalive\",0,120";
+      break;
+    case MQTT_CFG_SESSION:
+      cmd = "AT+QMTCFG=\"session\",0,0";
+      break;
+    case MQTT_CFG_TIMEOUT:
+      cmd = "AT+QMTCFG=\"timeout\",0,30,3,0";
+      break;
+
+    case MQTT_CFG_OPEN:
+      // Completes on the +QMTOPEN URC, which can take 10-15 seconds after OK
+      Serial.println("[MQTT] Opening connection to broker...");
+      cmd = "AT+QMTOPEN=0,\"" + String(MQTT_BROKER) + "\"," + String(MQTT_PORT);
+      timeout = 25000;
+      final = "+QMTOPEN:";
+      break;
+
+    case MQTT_CFG_CONN:
+      // Completes on the +QMTCONN URC
+      Serial.println("[MQTT] Connecting to broker...");
+      cmd = "AT+QMTCONN=0,\"" + String(MQTT_CLIENT_ID) + "\"";
+      if (strlen(MQTT_USER) > 0) {
+        cmd += ",\"" + String(MQTT_USER) + "\",\"" + String(MQTT_PASS) + "\"";
+      }
+      timeout = 20000;
+      final = "+QMTCONN:";
+      break;
+
+    case MQTT_CFG_SUB:
+      Serial.println("[MQTT] Subscribing to topic: " + String(MQTT_TOPIC_COMMANDS));
+      cmd = subscribeCommand(MQTT_TOPIC_COMMANDS);
+      timeout = 5000;
+      break;
+
+    default:
+      cfgStage = MQTT_CFG_IDLE;
+      return;
   }
 
-  // Connect to MQTT broker
-  if (!connectMQTTBroker()) {
-    // Don't clear needsReconfigure - let needsReconfiguration() manage attempts
-    return false;
+  // A full queue is retried on the next pass
+  if (sendCommandAsync(cmd, timeout, final, onConfigResult, this)) {
+    cfgWaiting = true;
   }
-
-  mqttConnected = true;
-  needsReconfigure = false;  // Clear flag only on success
-  reconfigAttempts = 0;  // Reset attempt counter on success
-  inCooldown = false;  // Clear cooldown on success
-  Serial.println("[MQTT] ✓ Connected and ready");
-
-  return true;
 }
 
-bool ModemMQTT::openMQTTConnection() {
-  Serial.println("[MQTT] Opening connection to broker...");
-
-  String openCmd = "AT+QMTOPEN=0,\"" + String(MQTT_BROKER) + "\"," + String(MQTT_PORT);
-  String openResp = sendCommand(openCmd, 5000);
+void ModemMQTT::onConfigResult(bool ok, const String &resp, void *ctx) {
+  ModemMQTT *self = (ModemMQTT *)ctx;
+  self->cfgWaiting = false;
+
+  switch (self->cfgStage) {
+    case MQTT_CFG_DISC:
+    case MQTT_CFG_CLOSE:
+      // Nothing to close is fine; give the modem a moment before the next step
+      self->cfgNextAt = millis() + MODEM_CFG_PAUSE_MS;
+      self->cfgStage++;
+      break;
+
+    case MQTT_CFG_OPEN:
+      if (!self->openResult(resp)) {
+        // Don't clear needsReconfigure - let needsReconfiguration() manage attempts
+        self->cfgStage = MQTT_CFG_IDLE;
+        return;
+      }
+      self->cfgStage++;
+      break;
 
-  if (openResp.indexOf("OK") < 0) {
-    Serial.println("[MQTT] ❌ Failed to send open command");
-    return false;
+    case MQTT_CFG_CONN:
+      if (!self->connectResult(resp)) {
+        self->cfgStage = MQTT_CFG_IDLE;
+        return;
+      }
+      self->mqttConnected = true;
+      self->needsReconfigure = false;  // Clear flag only on success
+      self->reconfigAttempts = 0;  // Reset attempt counter on success
+      self->inCooldown = false;  // Clear cooldown on success
+      Serial.println("[MQTT] ✓ Connected and ready");
+      self->cfgStage++;
+      break;
+
+    case MQTT_CFG_SUB:
+      Serial.println(ok ? "[MQTT] ✓ Subscribed successfully" : "[MQTT] ❌ Subscribe failed");
+      self->cfgStage = MQTT_CFG_IDLE;
+      return;
+
+    default:
+      // QMTCFG settings - results were never checked
+      self->cfgStage++;
+      break;
   }
 
-  // Wait for +QMTOPEN URC response (can take 10-15 seconds)
+  self->configStep();
+}
+
+bool ModemMQTT::openResult(const String &openResp) {
   // Format: +QMTOPEN: <client_idx>,<result>
   // result: 0=success, 1=wrong parameter, 2=MQTT ID occupied, 3=failed to activate PDP, 4=failed to parse domain, 5=network disconnected
-  Serial.println("[MQTT] Waiting for +QMTOPEN URC...");
-
-  unsigned long start = millis();
-  bool openSuccess = false;
-
-  while (millis() - start < 20000) {  // Wait up to 20 seconds
-    if (SerialAT.available()) {
-      String urc = SerialAT.readStringUntil('\n');
-      urc.trim();
-
-      if (urc.length() > 0) {
-        Serial.println("[MQTT] URC: " + urc);
-
-        if (urc.indexOf("+QMTOPEN:") >= 0) {
-          // Parse result code
-          int commaPos = urc.lastIndexOf(",");
-          if (commaPos >= 0) {
-            String resultStr = urc.substring(commaPos + 1);
-            resultStr.trim();
-            int result = resultStr.toInt();
-
-            if (result == 0) {
-              Serial.println("[MQTT] ✓ Connection opened successfully");
-              openSuccess = true;
-              break;
-            } else {
-              Serial.println("[MQTT] ❌ Open failed with error code: " + String(result));
-              return false;
-            }
-          }
-        }
-
-        // Ignore non-MQTT URCs (SMS, etc.) - they won't be processed in MQTT mode
-        if (urc.indexOf("+CMTI:") >= 0 || urc.indexOf("+CDS:") >= 0 || urc.indexOf("+CMGS:") >= 0) {
-          // SMS URCs ignored in MQTT mode
-        }
-      }
+  int urcPos = openResp.indexOf("+QMTOPEN:");
+  if (urcPos < 0) {
+    if (openResp.indexOf("OK") < 0) {
+      Serial.println("[MQTT] ❌ Failed to send open command");
+    } else {
+      Serial.println("[MQTT] ❌ Timeout waiting for +QMTOPEN URC");
     }
-    delay(100);  // Small delay to prevent tight loop
+    return false;
   }
 
-  if (!openSuccess) {
-    Serial.println("[MQTT] ❌ Timeout waiting for +QMTOPEN URC");
+  // Parse result code
+  String urc = openResp.substring(urcPos);
+  int commaPos = urc.lastIndexOf(",");
+  int result = (commaPos >= 0) ? urc.substring(commaPos + 1).toInt() : -1;
+
+  if (result != 0) {
+    Serial.println("[MQTT] ❌ Open failed with error code: " + String(result));
     return false;
   }
 
+  Serial.println("[MQTT] ✓ Connection opened successfully");
   return true;
 }
 
-bool ModemMQTT::connectMQTTBroker() {
-  Serial.println("[MQTT] Connecting to broker...");
-
-  String connectCmd = "AT+QMTCONN=0,\"" + String(MQTT_CLIENT_ID) + "\"";
-  if (strlen(MQTT_USER) > 0) {
-    connectCmd += ",\"" + String(MQTT_USER) + "\",\"" + String(MQTT_PASS) + "\"";
+bool ModemMQTT::connectResult(const String &connectResp) {
+  // Format: +QMTCONN: <client_idx>,<result>[,<ret_code>]
+  // result: 0=success, 1=packet retransmit, 2=failed to send, 3=authentication error, 4=server unavailable
+  int urcPos = connectResp.indexOf("+QMTCONN:");
+  if (urcPos < 0) {
+    if (connectResp.indexOf("OK") < 0) {
+      Serial.println("[MQTT] ❌ Failed to send connect command");
+    } else {
+      Serial.println("[MQTT] ❌ Timeout waiting for +QMTCONN URC");
+    }
+    return false;
   }
 
-  String connectResp = sendCommand(connectCmd, 5000);
+  // Parse result code
+  // Format: +QMTCONN: 0,0,0 (client, result, ret_code)
+  String urc = connectResp.substring(urcPos);
+  int firstComma = urc.indexOf(",");
+  int secondComma = urc.indexOf(",", firstComma + 1);
+  if (secondComma < 0) secondComma = urc.length();
+  int result = (firstComma >= 0) ? urc.substring(firstComma + 1, secondComma).toInt() : -1;
 
-  if (connectResp.indexOf("OK") < 0) {
-    Serial.println("[MQTT] ❌ Failed to send connect command");
+  if (result != 0) {
+    Serial.println("[MQTT] ❌ Connect failed with error code: " + String(result));
     return false;
   }
 
-  // Wait for +QMTCONN URC response
-  // Format: +QMTCONN: <client_idx>,<result>[,<ret_code>]
-  // result: 0=success, 1=packet retransmit, 2=failed to send, 3=authentication error, 4=server unavailable
-  Serial.println("[MQTT] Waiting for +QMTCONN URC...");
-
-  unsigned long start = millis();
-  bool connectSuccess = false;
-
-  while (millis() - start < 15000) {  // Wait up to 15 seconds
-    if (SerialAT.available()) {
-      String urc = SerialAT.readStringUntil('\n');
-      urc.trim();
-
-      if (urc.length() > 0) {
-        Serial.println("[MQTT] URC: " + urc);
-
-        if (urc.indexOf("+QMTCONN:") >= 0) {
-          // Parse result code
-          // Format: +QMTCONN: 0,0,0 (client, result, ret_code)
-          int firstComma = urc.indexOf(",");
-          int secondComma = urc.indexOf(",", firstComma + 1);
-
-          if (firstComma >= 0 && secondComma >= 0) {
-            String resultStr = urc.substring(firstComma + 1, secondComma);
-            resultStr.trim();
-            int result = resultStr.toInt();
-
-            if (result == 0) {
-              Serial.println("[MQTT] ✓ Broker connected successfully");
-              connectSuccess = true;
-              break;
-            } else {
-              Serial.println("[MQTT] ❌ Connect failed with error code: " + String(result));
-              return false;
-            }
-          }
-        }
-
-        // Ignore non-MQTT URCs (SMS, etc.) - they won't be processed in MQTT mode
-        if (urc.indexOf("+CMTI:") >= 0 || urc.indexOf("+CDS:") >= 0 || urc.indexOf("+CMGS:") >= 0) {
-          // SMS URCs ignored in MQTT mode
-        }
-      }
-    }
-    delay(100);  // Small delay to prevent tight loop
+  Serial.println("[MQTT] ✓ Broker connected successfully");
+  return true;
+}
+
+// Lines wait in the backlog and go to the AT engine as its queue drains, so
+// a burst (one NODES line per node) doesn't overrun the queue. Returns false
+// if the line was dropped; results arrive in onPublishResult().
+bool ModemMQTT::publish(const String &topic, const String &payload) {
+  if (!mqttConnected) {
+    // processBackground() reconnects on its own schedule
+    Serial.println("[MQTT] ❌ Not connected - publish dropped");
+    pubDropped++;
+    return false;
   }
 
-  if (!connectSuccess) {
-    Serial.println("[MQTT] ❌ Timeout waiting for +QMTCONN URC");
+  if (backlog.size() >= MQTT_PUBLISH_BACKLOG) {
+    Serial.println("[MQTT] ❌ Publish backlog full - dropped: " + topic);
+    pubDropped++;
     return false;
   }
 
+  MqttPublish p;
+  p.topic = topic;
+  p.payload = payload;
+  backlog.push_back(p);
+
+  feedPublishes();
   return true;
 }
 
-bool ModemMQTT::publish(const String &topic, const String &payload) {
+// Keeps half the AT queue free for configuration, SMS and reads
+void ModemMQTT::feedPublishes() {
+  if (backlog.empty()) return;
+
   if (!mqttConnected) {
-    Serial.println("[MQTT] ❌ Not connected - attempting reconnect");
-    reconnect();
-    if (!mqttConnected) {
-      return false;
-    }
+    Serial.println("[MQTT] ❌ Not connected - " + String((int)backlog.size()) +
+                   " queued publishes dropped");
+    pubDropped += backlog.size();
+    backlog.clear();
+    return;
   }
 
-  // Escape topic and payload to prevent command injection
-  String escapedTopic = escapeATString(topic);
-  String escapedPayload = escapeATString(payload);
+  while (!backlog.empty() && atPending() < MODEM_AT_QUEUE_SLOTS / 2) {
+    const MqttPublish &p = backlog.front();
 
-  // Publish message
-  // AT+QMTPUB=<client_idx>,<msgID>,<qos>,<retain>,"<topic>","<msg>"
-  String pubCmd = "AT+QMTPUB=0,0,0,0,\"" + escapedTopic + "\",\"" + escapedPayload + "\"";
+    // Escape topic and payload to prevent command injection
+    String escapedTopic = escapeATString(p.topic);
+    String escapedPayload = escapeATString(p.payload);
 
-  Serial.println("[MQTT] Publishing to topic: " + topic);
-  Serial.println("[MQTT] Payload: " + payload);
+    // Publish message
+    // AT+QMTPUB=<client_idx>,<msgID>,<qos>,<retain>,"<topic>","<msg>"
+    String pubCmd = "AT+QMTPUB=0,0,0,0,\"" + escapedTopic + "\",\"" + escapedPayload + "\"";
 
-  String resp = sendCommand(pubCmd, 5000);
+    Serial.println("[MQTT] Publishing to topic: " + p.topic);
+    Serial.println("[MQTT] Payload: " + p.payload);
 
-  if (resp.indexOf("OK") >= 0) {
+    if (!sendCommandAsync(pubCmd, 5000, "OK", onPublishResult, this)) break;
+    backlog.erase(backlog.begin());
+  }
+}
+
+void ModemMQTT::onPublishResult(bool ok, const String &resp, void *ctx) {
+  ModemMQTT *self = (ModemMQTT *)ctx;
+
+  if (ok) {
     Serial.println("[MQTT] ✓ Published successfully");
-    return true;
   } else {
     Serial.println("[MQTT] ❌ Publish failed");
-    mqttConnected = false;  // Mark as disconnected
-    return false;
+    self->pubFailed++;
+    self->mqttConnected = false;  // Mark as disconnected
   }
 }
 
+String ModemMQTT::publishReport() {
+  return "backlog=" + String((int)backlog.size()) + " dropped=" + String(pubDropped) +
+         " failed=" + String(pubFailed);
+}
+
+String ModemMQTT::subscribeCommand(const String &topic) {
+  // Escape topic to prevent command injection
+  // AT+QMTSUB=<client_idx>,<msgID>,"<topic>",<qos>
+  return "AT+QMTSUB=0,1,\"" + escapeATString(topic) + "\",0";
+}
+
+// Queued; the result is logged from a later processBackground()
 bool ModemMQTT::subscribe(const String &topic) {
   if (!mqttConnected) {
     Serial.println("[MQTT] ❌ Not connected");
     return false;
   }
 
-  // Escape topic to prevent command injection
-  String escapedTopic = escapeATString(topic);
-
-  // Subscribe to topic
-  // AT+QMTSUB=<client_idx>,<msgID>,"<topic>",<qos>
-  String subCmd = "AT+QMTSUB=0,1,\"" + escapedTopic + "\",0";
-
   Serial.println("[MQTT] Subscribing to topic: " + topic);
+  return sendCommandAsync(subscribeCommand(topic), 5000, "OK", onSubscribeResult, this);
+}
 
-  String resp = sendCommand(subCmd, 5000);
-
-  if (resp.indexOf("OK") >= 0) {
-    Serial.println("[MQTT] ✓ Subscribed successfully");
-    return true;
-  } else {
-    Serial.println("[MQTT] ❌ Subscribe failed");
-    return false;
-  }
+void ModemMQTT::onSubscribeResult(bool ok, const String &resp, void *ctx) {
+  Serial.println(ok ? "[MQTT] ✓ Subscribed successfully" : "[MQTT] ❌ Subscribe failed");
 }
 
 bool ModemMQTT::isConnected() {
   return mqttConnected;
 }
 
+// configure() closes the old connection itself
 void ModemMQTT::reconnect() {
   Serial.println("[MQTT] Attempting reconnection...");
-  
-  // Close existing connection
-  sendCommand("AT+QMTDISC=0", 2000);
-  delay(1000);
-  sendCommand("AT+QMTCLOSE=0", 2000);
-  delay(1000);
-  
-  // Reconfigure and connect
-  if (configure()) {
-    Serial.println("[MQTT] ✓ Reconnected successfully");
-  } else {
+
+  if (!configure()) {
     Serial.println("[MQTT] ❌ Reconnection failed");
   }
 }
 
-void ModemMQTT::processBackground() {
-  // Process MQTT-specific URCs
-  // Note: Don't call ModemBase::processBackground() because it consumes
-  // all SerialAT data, leaving nothing for us to process!
-  while (SerialAT.available()) {
-    String urc = SerialAT.readStringUntil('\n');
-    urc.trim();
-
-    if (urc.length() > 0) {
-      // Check if this is an MQTT-related URC
-      bool isMQTTURC = (urc.indexOf("+QMTSTAT") >= 0 ||
-                        urc.indexOf("+QMTRECV") >= 0 ||
-                        urc.indexOf("+QMTPUB") >= 0 ||
-                        urc.indexOf("+QMTSUB") >= 0 ||
-                        urc.indexOf("+QMTOPEN") >= 0 ||
-                        urc.indexOf("+QMTCONN") >= 0 ||
-                        urc.indexOf("+QMTDISC") >= 0);
-
-      // Check if this is a shared URC (modem status)
-      bool isSharedURC = (urc.indexOf("RDY") >= 0 ||
-                          urc.indexOf("POWERED DOWN") >= 0 ||
-                          urc.indexOf("+QIND") >= 0);
-
-      // Only process MQTT and shared URCs, ignore everything else
-      if (!isMQTTURC && !isSharedURC) {
-        // Not an MQTT URC - ignore it (SMS-only URC)
-        continue;  // Skip processing this URC
-      }
-
-      // Process MQTT and shared URCs
-      Serial.println("[MQTT] URC: " + urc);
+void ModemMQTT::handleURC(const String &urc) {
+  // Check if this is an MQTT-related URC
+  bool isMQTTURC = (urc.indexOf("+QMTSTAT") >= 0 ||
+                    urc.indexOf("+QMTRECV") >= 0 ||
+                    urc.indexOf("+QMTPUB") >= 0 ||
+                    urc.indexOf("+QMTSUB") >= 0 ||
+                    urc.indexOf("+QMTOPEN") >= 0 ||
+                    urc.indexOf("+QMTCONN") >= 0 ||
+                    urc.indexOf("+QMTDISC") >= 0);
+
+  // Check if this is a shared URC (modem status)
+  bool isSharedURC = (urc.indexOf("RDY") >= 0 ||
+                      urc.indexOf("POWERED DOWN") >= 0 ||
+                      urc.indexOf("+QIND") >= 0);
+
+  // Only process MQTT and shared URCs, ignore everything else
+  if (!isMQTTURC && !isSharedURC) {
+    // Not an MQTT URC - ignore it (SMS-only URC)
+    return;  // Skip processing this URC
+  }
 
-      // Handle modem initialization complete
-      if (urc.indexOf("+QIND: SMS DONE") >= 0) {
-        Serial.println("[MQTT] ✓ Modem fully initialized (+QIND: SMS DONE)");
-        modemReady = true;
-      }
+  // Process MQTT and shared URCs
+  Serial.println("[MQTT] URC: " + urc);
 
-      // Handle modem restart/reboot
-      // When modem restarts, all configuration is lost (including MQTT)
-      if (urc.indexOf("RDY") >= 0 || urc.indexOf("POWERED DOWN") >= 0) {
-        Serial.println("[MQTT] ⚠ Modem restart detected!");
+  // Handle modem initialization complete
+  if (urc.indexOf("+QIND: SMS DONE") >= 0) {
+    Serial.println("[MQTT] ✓ Modem fully initialized (+QIND: SMS DONE)");
+    modemReady = true;
+  }
 
-        // Reset state and mark for reconfiguration
-        mqttConnected = false;
-        needsReconfigure = true;
-        reconfigAttempts = 0;  // Reset attempt counter for new modem restart event
-        inCooldown = false;  // Clear cooldown on modem restart - give MQTT a fresh chance
-        cooldownStartTime = 0;
+  // Handle modem restart/reboot
+  // When modem restarts, all configuration is lost (including MQTT)
+  if (urc.indexOf("RDY") >= 0 || urc.indexOf("POWERED DOWN") >= 0) {
+    Serial.println("[MQTT] ⚠ Modem restart detected!");
+
+    // Reset state and mark for reconfiguration
+    mqttConnected = false;
+    needsReconfigure = true;
+    reconfigAttempts = 0;  // Reset attempt counter for new modem restart event
+    inCooldown = false;  // Clear cooldown on modem restart - give MQTT a fresh chance
+    cooldownStartTime = 0;
+
+    // CRITICAL: Mark modem as not ready until it fully initializes
+    // Modem sends RDY immediately but takes 5+ seconds to actually be ready
+    modemReady = false;
+    noteRestart();
+    Serial.println("[MQTT] → Modem marked as not ready (waiting for +QIND: SMS DONE)");
+
+    Serial.println("[MQTT] → MQTT marked for reconfiguration");
+  }
 
-        // CRITICAL: Mark modem as not ready until it fully initializes
-        // Modem sends RDY immediately but takes 5+ seconds to actually be ready
-        modemReady = false;
-        Serial.println("[MQTT] → Modem marked as not ready (waiting for +QIND: SMS DONE)");
+  // Handle MQTT disconnection
+  // +QMTSTAT: <client_idx>,<err_code>
+  if (urc.indexOf("+QMTSTAT") >= 0) {
+    // Error code 2 = connection closed
+    if (urc.indexOf(",2") >= 0 || urc.indexOf(",1") >= 0) {
+      Serial.println("[MQTT] ⚠ Disconnected (URC)");
+      mqttConnected = false;
+    }
+  }
 
-        Serial.println("[MQTT] → MQTT marked for reconfiguration");
+  // Handle incoming messages
+  // +QMTRECV: <client_idx>,<msgID>,"<topic>","<payload>"
+  if (urc.indexOf("+QMTRECV") >= 0) {
+    Serial.println("[MQTT] 📨 Received message: " + urc);
+    // Payload is the last quoted field; hand it to the main queue
+    int end = urc.lastIndexOf('"');
+    int start = (end > 0) ? urc.lastIndexOf('"', end - 1) : -1;
+    if (start >= 0) {
+      String payload = urc.substring(start + 1, end);
+      payload.trim();
+      if (payload.length() > 0) {
+        if (payload.indexOf("SRC=") < 0) payload += ",SRC=MQTT";
+        incomingQueue.enqueue(payload);
       }
+    }
+  }
 
-      // Handle MQTT disconnection
-      // +QMTSTAT: <client_idx>,<err_code>
-      if (urc.indexOf("+QMTSTAT") >= 0) {
-        // Error code 2 = connection closed
-        if (urc.indexOf(",2") >= 0 || urc.indexOf(",1") >= 0) {
-          Serial.println("[MQTT] ⚠ Disconnected (URC)");
-          mqttConnected = false;
-        }
-      }
+  // Handle publish confirmation
+  if (urc.indexOf("+QMTPUB") >= 0) {
+    Serial.println("[MQTT] ✓ Publish confirmed");
+  }
 
-      // Handle incoming messages
-      // +QMTRECV: <client_idx>,<msgID>,"<topic>","<payload>"
-      if (urc.indexOf("+QMTRECV") >= 0) {
-        Serial.println("[MQTT] 📨 Received message: " + urc);
-        // Parse and handle message here
-        // You can add a callback mechanism if needed
-      }
+  // Handle subscription confirmation
+  if (urc.indexOf("+QMTSUB") >= 0) {
+    Serial.println("[MQTT] ✓ Subscription confirmed");
+  }
+}
 
-      // Handle publish confirmation
-      if (urc.indexOf("+QMTPUB") >= 0) {
-        Serial.println("[MQTT] ✓ Publish confirmed");
-      }
+void ModemMQTT::processBackground() {
+  // Advance queued AT commands; URCs come back through handleURC()
+  serviceAT();
+  configStep();
+  feedPublishes();
 
-      // Handle subscription confirmation
-      if (urc.indexOf("+QMTSUB") >= 0) {
-        Serial.println("[MQTT] ✓ Subscription confirmed");
-      }
-    }
-  }
-  
   // Periodic connection check
   if (mqttConnected && (millis() - lastMqttCheck > mqttCheckInterval)) {
     lastMqttCheck = millis();
@@ -384,7 +443,7 @@ void ModemMQTT::processBackground() {
   }
   
   // Auto-reconnect if disconnected (but not during cooldown period)
-  if (!mqttConnected && modemReady && !inCooldown) {
+  if (!mqttConnected && modemReady && !inCooldown && !isConfiguring() && restartSettled()) {
     static unsigned long lastReconnectAttempt = 0;
     if (millis() - lastReconnectAttempt > 60000) {  // Try every 60 seconds
       lastReconnectAttempt = millis();
@@ -399,6 +458,12 @@ bool ModemMQTT::needsReconfiguration() {
     return false;
   }
 
+  // Wait out the modem's restart (+QIND: SMS DONE, then MODEM_RESTART_SETTLE_MS
+  // after RDY) and any configuration already running
+  if (!modemReady || !restartSettled() || isConfiguring()) {
+    return false;
+  }
+
   unsigned long now = millis();
 
   // Check if we're in 1-hour cooldown period
@@ -7,6 +7,26 @@
 #include "ModemBase.h"
 #include "Config.h"
 
+// configure() runs these in order, one AT command each
+enum MqttConfigStage {
+  MQTT_CFG_IDLE,
+  MQTT_CFG_DISC,              // Close whatever the modem still holds
+  MQTT_CFG_CLOSE,
+  MQTT_CFG_VERSION,
+  MQTT_CFG_KEEPALIVE,
+  MQTT_CFG_SESSION,
+  MQTT_CFG_TIMEOUT,
+  MQTT_CFG_OPEN,              // Completes on +QMTOPEN, up to 25 s
+  MQTT_CFG_CONN,              // Completes on +QMTCONN, up to 20 s
+  MQTT_CFG_SUB                // Connected; subscribe to MQTT_TOPIC_COMMANDS
+};
+
+// A publish waiting for a free AT queue slot
+struct MqttPublish {
+  String topic;
+  String payload;
+};
+
 class ModemMQTT : public ModemBase {
 private:
   bool mqttConnected;
@@ -17,17 +37,34 @@ private:
   int reconfigAttempts;  // Track consecutive reconfiguration attempts
   unsigned long cooldownStartTime;  // When MQTT entered cooldown after max failures
   bool inCooldown;  // True when MQTT is in 1-hour cooldown period
+  uint8_t cfgStage;  // MqttConfigStage
+  bool cfgWaiting;  // The stage's command is queued or in flight
+  unsigned long cfgNextAt;  // Stage command not sent before this
+  std::vector<MqttPublish> backlog;
+  uint32_t pubDropped;  // Not connected or backlog full
+  uint32_t pubFailed;  // AT+QMTPUB error or timeout
 
-  bool openMQTTConnection();
-  bool connectMQTTBroker();
+  void configStep();
+  bool openResult(const String &openResp);
+  bool connectResult(const String &connectResp);
+  void feedPublishes();
+  String subscribeCommand(const String &topic);
   String escapeATString(const String &input);  // Escape quotes for AT commands
+  static void onConfigResult(bool ok, const String &resp, void *ctx);
+  static void onPublishResult(bool ok, const String &resp, void *ctx);
+  static void onSubscribeResult(bool ok, const String &resp, void *ctx);
+
+protected:
+  void handleURC(const String &urc);  // Override - MQTT and modem status URCs
 
 public:
   ModemMQTT();
   bool configure();
+  bool isConfiguring();
   bool publish(const String &topic, const String &payload);
   bool subscribe(const String &topic);
   bool isConnected();
+  String publishReport();
   void reconnect();
   void processBackground();  // Override base class method
   bool needsReconfiguration();  // Check if reconfiguration is needed after modem restart
@@ -1,10 +1,13 @@
 // ModemSMS.cpp - SMS communication for Quectel EC200U
 #include "ModemSMS.h"
 
-ModemSMS::ModemSMS() : smsReady(false), needsReconfigure(false), lastSMSCheck(0), smsCheckInterval(10000) {
+ModemSMS::ModemSMS() : smsReady(false), needsReconfigure(false), lastSMSCheck(0), smsCheckInterval(10000), readingIndex(-1), cfgStage(SMS_CFG_IDLE), cfgWaiting(false) {
   pendingMessageIndices.clear();
 }
 
+// Starts the configuration sequence; configStep() sends each command from
+// processBackground() once the previous one's result is in. Returns false if
+// it couldn't start - isReady() turns true when it completes.
 bool ModemSMS::configure() {
   if (!modemReady) {
     Serial.println("[SMS] ❌ Modem not ready for SMS");
@@ -12,68 +15,156 @@ bool ModemSMS::configure() {
     return false;
   }
 
-  Serial.println("[SMS] Configuring...");
-
-  // CRITICAL: Configure Quectel modem to route URCs to UART1 (not USB)
-  // Without this, +CMTI notifications won't be received on the ESP32's UART
-  sendCommand("AT+QURCCFG=\"urcport\",\"uart1\"", 2000);
-  Serial.println("[SMS] ✓ URCs routed to UART1");
-
-  // Configure Ring Indicator for incoming SMS
-  // This enables proper SMS notification signaling
-  sendCommand("AT+QCFG=\"urc/ri/smsincoming\",\"pulse\",120", 2000);
-  Serial.println("[SMS] ✓ SMS RI configured");
-
-  // Configure SMS text mode
-  if (!configureTextMode()) {
-    needsReconfigure = false;  // Clear flag even on failure to prevent infinite loop
+  if (cfgStage != SMS_CFG_IDLE) {
+    Serial.println("[SMS] ⚠ Configuration already in progress");
     return false;
   }
 
-  // Set SMS storage to SIM card
-  String resp = sendCommand("AT+CPMS=\"SM\",\"SM\",\"SM\"", 2000);
-  if (resp.indexOf("OK") < 0) {
-    Serial.println("[SMS] ⚠ Failed to set storage, trying ME");
-    sendCommand("AT+CPMS=\"ME\",\"ME\",\"ME\"", 2000);
-  }
+  Serial.println("[SMS] Configuring...");
+  cfgStage = SMS_CFG_URC_PORT;
+  cfgWaiting = false;
+  configStep();
 
-  // Enable new SMS notification
-  // AT+CNMI=<mode>,<mt>,<bm>,<ds>,<bfr>
-  // mode=2: buffer URCs in TA when link is reserved
-  // mt=1: SMS-DELIVER indications to TE
-  sendCommand("AT+CNMI=2,1,0,0,0", 2000);
+  return true;
+}
 
-  // Set character set to GSM
-  sendCommand("AT+CSCS=\"GSM\"", 2000);
+bool ModemSMS::isConfiguring() {
+  return cfgStage != SMS_CFG_IDLE;
+}
 
-  // Check SMSC address - this is CRITICAL for sending SMS
-  String csca = sendCommand("AT+CSCA?", 2000);
-  Serial.println("[SMS] SMSC Check: " + csca);
-  if (csca.indexOf("ERROR") >= 0 || csca.indexOf("\"\"") >= 0 || csca.indexOf("+CSCA: \"\"") >= 0) {
-    Serial.println("[SMS] ⚠ WARNING: SMSC address not configured!");
-    Serial.println("[SMS] ⚠ SMS sending will fail without SMSC!");
-    Serial.println("[SMS] ℹ Get SMSC from your carrier and set with AT+CSCA=\"+number\"");
-  } else {
-    Serial.println("[SMS] ✓ SMSC configured");
+// needsReconfiguration(), once the modem has settled after a restart
+bool ModemSMS::reconfigureDue() {
+  return needsReconfigure && cfgStage == SMS_CFG_IDLE && modemReady && restartSettled();
+}
+
+void ModemSMS::configStep() {
+  if (cfgStage == SMS_CFG_IDLE || cfgWaiting) return;
+
+  String cmd;
+  switch (cfgStage) {
+    // CRITICAL: Configure Quectel modem to route URCs to UART1 (not USB)
+    // Without this, +CMTI notifications won't be received on the ESP32's UART
+    case SMS_CFG_URC_PORT:
+      cmd = "AT+QURCCFG=\"urcport\",\"uart1\"";
+      break;
+
+    // Configure Ring Indicator for incoming SMS
+    // This enables proper SMS notification signaling
+    case SMS_CFG_RI:
+      cmd = "AT+QCFG=\"urc/ri/smsincoming\",\"pulse\",120";
+      break;
+
+    // Set SMS format to text mode (easier to work with)
+    case SMS_CFG_TEXT_MODE:
+      cmd = "AT+CMGF=1";
+      break;
+
+    // Set SMS storage to SIM card, or the modem's own memory
+    case SMS_CFG_STORAGE_SM:
+      cmd = "AT+CPMS=\"SM\",\"SM\",\"SM\"";
+      break;
+    case SMS_CFG_STORAGE_ME:
+      cmd = "AT+CPMS=\"ME\",\"ME\",\"ME\"";
+      break;
+
+    // Enable new SMS notification
+    // AT+CNMI=<mode>,<mt>,<bm>,<ds>,<bfr>
+    // mode=2: buffer URCs in TA when link is reserved
+    // mt=1: SMS-DELIVER indications to TE
+    case SMS_CFG_NOTIFY:
+      cmd = "AT+CNMI=2,1,0,0,0";
+      break;
+
+    // Set character set to GSM
+    case SMS_CFG_CHARSET:
+      cmd = "AT+CSCS=\"GSM\"";
+      break;
+
+    // Check SMSC address - this is CRITICAL for sending SMS
+    case SMS_CFG_SMSC:
+      cmd = "AT+CSCA?";
+      break;
+
+    default:
+      cfgStage = SMS_CFG_IDLE;
+      return;
+  }
+
+  // A full queue is retried on the next pass
+  if (sendCommandAsync(cmd, 2000, "OK", onConfigResult, this)) {
+    cfgWaiting = true;
   }
+}
 
-  smsReady = true;
-  needsReconfigure = false;  // Clear reconfiguration flag
-  Serial.println("[SMS] ✓ Configuration complete");
+void ModemSMS::onConfigResult(bool ok, const String &resp, void *ctx) {
+  ModemSMS *self = (ModemSMS *)ctx;
+  self->cfgWaiting = false;
+
+  switch (self->cfgStage) {
+    case SMS_CFG_URC_PORT:
+      Serial.println("[SMS] ✓ URCs routed to UART1");
+      self->cfgStage = SMS_CFG_RI;
+      break;
+
+    case SMS_CFG_RI:
+      Serial.println("[SMS] ✓ SMS RI configured");
+      self->cfgStage = SMS_CFG_TEXT_MODE;
+      break;
+
+    case SMS_CFG_TEXT_MODE:
+      if (!ok) {
+        Serial.println("[SMS] ❌ Failed to set text mode");
+        self->needsReconfigure = false;  // Clear flag even on failure to prevent infinite loop
+        self->cfgStage = SMS_CFG_IDLE;
+        return;
+      }
+      Serial.println("[SMS] ✓ Text mode enabled");
+      self->cfgStage = SMS_CFG_STORAGE_SM;
+      break;
 
-  return true;
-}
+    case SMS_CFG_STORAGE_SM:
+      if (ok) {
+        self->cfgStage = SMS_CFG_NOTIFY;
+      } else {
+        Serial.println("[SMS] ⚠ Failed to set storage, trying ME");
+        self->cfgStage = SMS_CFG_STORAGE_ME;
+      }
+      break;
+
+    case SMS_CFG_STORAGE_ME:
+      self->cfgStage = SMS_CFG_NOTIFY;
+      break;
+
+    case SMS_CFG_NOTIFY:
+      self->cfgStage = SMS_CFG_CHARSET;
+      break;
+
+    case SMS_CFG_CHARSET:
+      self->cfgStage = SMS_CFG_SMSC;
+      break;
+
+    case SMS_CFG_SMSC:
+      Serial.println("[SMS] SMSC Check: " + resp);
+      if (!ok || resp.indexOf("\"\"") >= 0) {
+        Serial.println("[SMS] ⚠ WARNING: SMSC address not configured!");
+        Serial.println("[SMS] ⚠ SMS sending will fail without SMSC!");
+        Serial.println("[SMS] ℹ Get SMSC from your carrier and set with AT+CSCA=\"+number\"");
+      } else {
+        Serial.println("[SMS] ✓ SMSC configured");
+      }
 
-bool ModemSMS::configureTextMode() {
-  // Set SMS format to text mode (easier to work with)
-  String resp = sendCommand("AT+CMGF=1", 2000);
-  if (resp.indexOf("OK") >= 0) {
-    Serial.println("[SMS] ✓ Text mode enabled");
-    return true;
-  } else {
-    Serial.println("[SMS] ❌ Failed to set text mode");
-    return false;
+      self->smsReady = true;
+      self->needsReconfigure = false;  // Clear reconfiguration flag
+      self->cfgStage = SMS_CFG_IDLE;
+      Serial.println("[SMS] ✓ Configuration complete");
+      return;
+
+    default:
+      self->cfgStage = SMS_CFG_IDLE;
+      return;
   }
+
+  self->configStep();
 }
 
 bool ModemSMS::isValidPhoneNumber(const String &phoneNumber) {
@@ -133,65 +224,21 @@ bool ModemSMS::sendSMS(const String &phoneNumber, const String &message) {
   Serial.println("[SMS] Sending to: " + phoneNumber);
   Serial.println("[SMS] Message: " + message);
   
-  // Clear buffer
-  clearSerialBuffer();
-  
-  // Start SMS
+  // The engine writes the text at the '>' prompt and ends it with Ctrl+Z;
+  // +CMGS/OK (or +CMS ERROR) comes back to onSendResult() up to 30 s later
   String cmd = "AT+CMGS=\"" + phoneNumber + "\"";
-  SerialAT.println(cmd);
-  Serial.println("[SMS] TX: " + cmd);
-  
-  // Wait for '>' prompt
-  if (!waitForPrompt('>', 5000)) {
-    Serial.println("[SMS] ❌ No prompt received");
-    return false;
-  }
-  
-  // Send message text
-  SerialAT.print(message);
-  delay(100);
-  
-  // Send Ctrl+Z to send SMS
-  SerialAT.write(0x1A);
-  Serial.println("[SMS] Message sent, waiting for response...");
-  
-  // Wait for response
-  unsigned long start = millis();
-  String response = "";
-  bool success = false;
-  bool errorDetected = false;
-
-  while (millis() - start < 30000) {  // 30 second timeout for SMS
-    if (SerialAT.available()) {
-      char c = SerialAT.read();
-      response += c;
-
-      // Check for success
-      if (response.indexOf("+CMGS:") >= 0 && response.indexOf("OK") >= 0) {
-        success = true;
-        break;
-      }
+  return sendCommandAsync(cmd, 30000, "OK", onSendResult, nullptr, message);
+}
 
-      // Check for error - but keep reading to get the full error code
-      if (response.indexOf("ERROR") >= 0) {
-        errorDetected = true;
-        // Wait a bit more to capture the complete error message
-        delay(500);
-        // Read any remaining characters
-        while (SerialAT.available()) {
-          response += (char)SerialAT.read();
-        }
-        break;
-      }
-    }
-    delay(10);
-  }
+void ModemSMS::onSendResult(bool ok, const String &response, void *ctx) {
+  bool success = ok && response.indexOf("+CMGS:") >= 0;
+  bool errorDetected = response.indexOf("ERROR") >= 0;
 
   Serial.println("[SMS] Response: " + response);
 
   if (success) {
     Serial.println("[SMS] ✓ SMS sent successfully");
-    return true;
+    return;
   } else {
     Serial.println("[SMS] ❌ SMS send failed");
 
@@ -266,26 +313,7 @@ bool ModemSMS::sendSMS(const String &phoneNumber, const String &message) {
         Serial.println("[SMS] Error: Generic modem error (check AT command syntax)");
       }
     }
-
-    return false;
-  }
-}
-
-bool ModemSMS::waitForPrompt(char ch, unsigned long timeout) {
-  unsigned long start = millis();
-  
-  while (millis() - start < timeout) {
-    if (SerialAT.available()) {
-      char c = SerialAT.read();
-      Serial.print(c);  // Debug
-      if (c == ch) {
-        return true;
-      }
-    }
-    delay(10);
   }
-  
-  return false;
 }
 
 void ModemSMS::handleNewMessageURC(int index) {
@@ -300,60 +328,78 @@ void ModemSMS::handleNewMessageURC(int index) {
 }
 
 bool ModemSMS::checkNewMessages() {
-  // Messages can be queued even when SMS is not ready (e.g., during reconfiguration)
+  // Messages read from the modem and waiting for takeMessage()
   // Don't check smsReady here - let the caller decide what to do
-  return !pendingMessageIndices.empty();
+  return !readMessages.empty();
 }
 
 int ModemSMS::getUnreadCount() {
-  // Return queue size regardless of SMS status
+  // Queued indices, the one being read and read messages not yet taken
   // Messages are queued even during reconfiguration
-  return pendingMessageIndices.size();
+  return pendingMessageIndices.size() + (readingIndex >= 0 ? 1 : 0) + readMessages.size();
 }
 
-std::vector<int> ModemSMS::getUnreadIndices() {
-  // Return queued messages regardless of SMS status
-  // This allows processing messages as soon as SMS becomes ready
-  // Note: Caller should check smsReady before trying to read messages from modem
-
-  // Return a copy of pending indices and clear the queue
-  std::vector<int> indices = pendingMessageIndices;
-  pendingMessageIndices.clear();
+bool ModemSMS::takeMessage(SMSMessage &sms) {
+  if (readMessages.empty()) {
+    return false;
+  }
 
-  return indices;
+  sms = readMessages.front();
+  readMessages.erase(readMessages.begin());
+  return true;
 }
 
-bool ModemSMS::readSMS(int index, SMSMessage &sms) {
-  if (!smsReady) {
-    return false;
+// Reads queued indices one at a time through the AT engine; the message
+// lands in readMessages from onReadResult()
+void ModemSMS::startRead() {
+  if (!smsReady || needsReconfigure || readingIndex >= 0 || pendingMessageIndices.empty()) {
+    return;
   }
-  
+
+  int index = pendingMessageIndices.front();
   Serial.println("[SMS] Reading message at index: " + String(index));
-  
-  String sender, timestamp;
-  String message = readSMSByIndex(index, sender, timestamp);
-  
-  if (message.length() > 0) {
-    sms.index = index;
-    sms.sender = sender;
-    sms.timestamp = timestamp;
-    sms.message = message;
-    
-    Serial.println("[SMS] ✓ Message read");
-    Serial.println("[SMS] From: " + sender);
-    Serial.println("[SMS] Time: " + timestamp);
-    Serial.println("[SMS] Message: " + message);
-    
-    return true;
+
+  if (!sendCommandAsync("AT+CMGR=" + String(index), 3000, "OK", onReadResult, this)) {
+    return;  // Queue full - retried on the next pass
   }
-  
-  return false;
+  pendingMessageIndices.erase(pendingMessageIndices.begin());
+  readingIndex = index;
 }
 
-String ModemSMS::readSMSByIndex(int index, String &sender, String &timestamp) {
-  String cmd = "AT+CMGR=" + String(index);
-  String resp = sendCommand(cmd, 3000);
+void ModemSMS::onReadResult(bool ok, const String &resp, void *ctx) {
+  ModemSMS *self = (ModemSMS *)ctx;
+  int index = self->readingIndex;
+  self->readingIndex = -1;
+
+  SMSMessage sms;
+  sms.index = index;
+  sms.message = self->parseMessage(resp, sms.sender, sms.timestamp);
 
+  if (sms.message.length() > 0) {
+    Serial.println("[SMS] ✓ Message read");
+    Serial.println("[SMS] From: " + sms.sender);
+    Serial.println("[SMS] Time: " + sms.timestamp);
+    Serial.println("[SMS] Message: " + sms.message);
+
+    self->readMessages.push_back(sms);
+    return;
+  }
+
+  // Failed to read message (likely PDU mode or other error)
+  Serial.println("[SMS] ⚠ Failed to read message at index " + String(index));
+
+  // If reconfiguration is needed, re-queue for retry after reconfiguration
+  if (self->needsReconfigure) {
+    self->requeueMessage(index);
+    Serial.println("[SMS] → Message will be retried after reconfiguration");
+  } else {
+    // Unknown error - still try to delete to avoid infinite loop
+    Serial.println("[SMS] ⚠ Deleting unreadable message");
+    self->deleteSMS(index);
+  }
+}
+
+String ModemSMS::parseMessage(const String &resp, String &sender, String &timestamp) {
   // Parse response
   // TEXT MODE: +CMGR: "REC UNREAD","+1234567890","","21/11/17,10:30:45+00"
   //           Message text here
@@ -425,15 +471,15 @@ String ModemSMS::readSMSByIndex(int index, String &sender, String &timestamp) {
 
 bool ModemSMS::deleteSMS(int index) {
   String cmd = "AT+CMGD=" + String(index);
-  String resp = sendCommand(cmd, 2000);
-  
-  if (resp.indexOf("OK") >= 0) {
+  return sendCommandAsync(cmd, 2000, "OK", onDeleteResult, nullptr);
+}
+
+void ModemSMS::onDeleteResult(bool ok, const String &resp, void *ctx) {
+  if (ok) {
     Serial.println("[SMS] ✓ Message deleted");
-    return true;
+  } else {
+    Serial.println("[SMS] ❌ Failed to delete message");
   }
-  
-  Serial.println("[SMS] ❌ Failed to delete message");
-  return false;
 }
 
 bool ModemSMS::deleteAllSMS() {
@@ -507,27 +553,23 @@ void ModemSMS::printSMSDiagnostics() {
 }
 
 void ModemSMS::processBackground() {
-  // SMS works independently - read URCs directly from SerialAT
+  // Advance queued AT commands; URCs come back through handleURC()
   // Note: This function only runs when ENABLE_SMS=1 (i.e., when ENABLE_MQTT=0)
   // When MQTT is enabled, SMS is disabled and this function is not called
+  serviceAT();
+  configStep();
+  startRead();
+}
 
-  while (SerialAT.available()) {
-    String line = SerialAT.readStringUntil('\n');
-    line.trim();
-
-    if (line.length() > 0) {
-      // Check if it's a URC (not a command response)
-      if (line.startsWith("+") || line.indexOf("RDY") >= 0 ||
-          line.indexOf("POWERED DOWN") >= 0 || line.indexOf("QIND") >= 0) {
-        Serial.println("[SMS] Processing URC: " + line);
-        processURC(line);
-      }
-    }
+// Lines the AT engine didn't match to a command in flight
+void ModemSMS::handleURC(const String &urc) {
+  // Check if it's a URC (not a stray command response)
+  if (!urc.startsWith("+") && urc.indexOf("RDY") < 0 &&
+      urc.indexOf("POWERED DOWN") < 0 && urc.indexOf("QIND") < 0) {
+    return;
   }
-}
+  Serial.println("[SMS] Processing URC: " + urc);
 
-// Helper function to process a single URC
-void ModemSMS::processURC(const String& urc) {
   // Handle modem restart/reboot
   // When modem restarts, all configuration is lost (including text mode)
   if (urc.indexOf("RDY") >= 0 || urc.indexOf("POWERED DOWN") >= 0) {
@@ -536,6 +578,7 @@ void ModemSMS::processURC(const String& urc) {
     // Reset state and mark for reconfiguration
     smsReady = false;
     needsReconfigure = true;
+    noteRestart();
 
     Serial.println("[SMS] → SMS marked for reconfiguration");
   }
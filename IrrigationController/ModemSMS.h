@@ -13,6 +13,19 @@ struct SMSMessage {
   String message;
 };
 
+// configure() runs these in order, one AT command each
+enum SmsConfigStage {
+  SMS_CFG_IDLE,
+  SMS_CFG_URC_PORT,
+  SMS_CFG_RI,
+  SMS_CFG_TEXT_MODE,          // Failure ends configuration
+  SMS_CFG_STORAGE_SM,
+  SMS_CFG_STORAGE_ME,         // Only if SM storage was refused
+  SMS_CFG_NOTIFY,
+  SMS_CFG_CHARSET,
+  SMS_CFG_SMSC
+};
+
 class ModemSMS : public ModemBase {
 private:
   bool smsReady;
@@ -20,22 +33,33 @@ private:
   unsigned long lastSMSCheck;
   unsigned long smsCheckInterval;
   std::vector<int> pendingMessageIndices;  // Queue of unread message indices from URCs
+  int readingIndex;  // AT+CMGR in flight, -1 = none
+  std::vector<SMSMessage> readMessages;  // Read, waiting for takeMessage()
+  SmsConfigStage cfgStage;
+  bool cfgWaiting;  // The stage's command is queued or in flight
 
-  bool waitForPrompt(char ch, unsigned long timeout = 5000);
-  String readSMSByIndex(int index, String &sender, String &timestamp);
-  bool configureTextMode();
+  String parseMessage(const String &resp, String &sender, String &timestamp);
+  void configStep();
+  static void onConfigResult(bool ok, const String &resp, void *ctx);
   bool isValidPhoneNumber(const String &phoneNumber);
   void handleNewMessageURC(int index);  // Handle +CMTI URC
-  void processURC(const String& urc);  // Process a single URC (from buffer or serial)
+  void startRead();
+  static void onReadResult(bool ok, const String &resp, void *ctx);
+  static void onSendResult(bool ok, const String &response, void *ctx);
+  static void onDeleteResult(bool ok, const String &resp, void *ctx);
+
+protected:
+  void handleURC(const String &urc);  // Override - SMS and modem status URCs
 
 public:
   ModemSMS();
   bool configure();
+  bool isConfiguring();
+  bool reconfigureDue();  // Reconfiguration needed and the modem ready for it
   bool sendSMS(const String &phoneNumber, const String &message);
-  bool checkNewMessages();
+  bool checkNewMessages();  // Read messages waiting for takeMessage()
   int getUnreadCount();
-  std::vector<int> getUnreadIndices();  // Get list of unread message indices
-  bool readSMS(int index, SMSMessage &sms);
+  bool takeMessage(SMSMessage &sms);  // Next message read in the background
   bool deleteSMS(int index);
   bool deleteAllSMS();
   void processBackground();  // Override base class method
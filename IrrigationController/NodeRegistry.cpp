@@ -0,0 +1,497 @@
+// NodeRegistry.cpp
+#include "NodeRegistry.h"
+
+NodeRegistry::NodeRegistry() : lastCheck(0), polls(0) {
+  memset(nodes, 0, sizeof(nodes));
+  for (int i = 0; i < LORA_MAX_NODES; i++) {
+    nodes[i].battPct = -1;
+  }
+}
+
+void NodeRegistry::begin() {
+  loraComm.setNodeSeenHandler(onSeen, this);
+  loadAddresses();
+}
+
+void NodeRegistry::resetEntry(int node) {
+  memset(&nodes[node], 0, sizeof(NodeEntry));
+  nodes[node].battPct = -1;
+}
+
+void NodeRegistry::markKnown(int node) {
+  if (node <= 0 || node >= LORA_MAX_NODES) return;
+  NodeEntry &e = nodes[node];
+  if (e.known) return;
+  e.known = true;
+  e.pollIntervalMs = NODE_POLL_QUIET_MS;
+  Serial.printf("[Nodes] Node %d added\n", node);
+}
+
+// Nodes in a schedule are expected even before they've said anything
+void NodeRegistry::seedFromSchedules() {
+  for (auto &sch : schedules) {
+    for (auto &st : sch.seq) markKnown(st.node_id);
+  }
+}
+
+// ========== Passive Updates ==========
+void NodeRegistry::onSeen(uint8_t node, int16_t rssi, int8_t snr, uint8_t via, void *ctx) {
+  NodeRegistry *self = (NodeRegistry *)ctx;
+  self->markKnown(node);
+  NodeEntry &e = self->nodes[node];
+  e.lastSeen = millis();
+  e.rssi = rssi;
+  e.snr = snr;
+  e.via = via;
+  e.uplinks++;
+  e.missedPolls = 0;
+  e.pollIntervalMs = NODE_POLL_QUIET_MS;
+
+  if (e.down) {
+    e.down = false;
+    Serial.printf("[Nodes] ✓ Node %u is back\n", node);
+    publishStatus("EVT|NODE_UP|N=" + String(node));
+  }
+  
+  // First frame on an offered address: the node took it
+  if (e.joinPending) {
+    e.joinPending = false;
+    String hw = hwString(e.hwId);
+    Serial.printf("[Nodes] ✓ Node %u joined (HW=%s)\n", node, hw.c_str());
+    publishStatus("EVT|NODE_JOIN|N=" + String(node) + "|HW=" + hw);
+    self->saveAddresses();
+  }
+}
+
+// "KEY=value" from a STAT payload, "" if absent
+String NodeRegistry::field(const String &msg, const String &key) {
+  int pos = msg.indexOf(key);
+  while (pos > 0 && msg[pos - 1] != '|' && msg[pos - 1] != ',') {
+    pos = msg.indexOf(key, pos + 1);
+  }
+  if (pos < 0) return "";
+  int end = msg.indexOf(',', pos);
+  int pipe = msg.indexOf('|', pos);
+  if (end < 0 || (pipe >= 0 && pipe < end)) end = pipe;
+  return msg.substring(pos + key.length(), end < 0 ? msg.length() : end);
+}
+
+void NodeRegistry::noteStat(int node, const String &msg) {
+  if (node <= 0 || node >= LORA_MAX_NODES) return;
+  markKnown(node);
+  NodeEntry &e = nodes[node];
+
+  String v = field(msg, "BATT=");
+  if (v.length() > 0) e.battPct = (int8_t)constrain(v.toInt(), 0, 100);
+  v = field(msg, "BV=");
+  if (v.length() > 0) e.battMv = (uint16_t)(v.toFloat() * 1000.0f);
+  v = field(msg, "FW=");
+  if (v.length() > 0) {
+    strncpy(e.fw, v.c_str(), sizeof(e.fw) - 1);
+    e.fw[sizeof(e.fw) - 1] = '\0';
+  }
+  for (int i = 1; i <= NODE_MAX_VALVES; i++) {
+    v = field(msg, "V" + String(i) + "=");
+    if (v.length() > 0) noteValve(node, i, v.toInt() != 0 || v.equalsIgnoreCase("OPEN"));
+  }
+}
+
+// valve 1-8; state from STAT, OPEN/VSET/CLOSE ACKs and AUTO_CLOSE
+void NodeRegistry::noteValve(int node, int valve, bool open) {
+  if (node <= 0 || node >= LORA_MAX_NODES || valve < 1 || valve > 8) return;
+  markKnown(node);
+  NodeEntry &e = nodes[node];
+  uint8_t bit = 1 << (valve - 1);
+  e.valvesKnown |= bit;
+  if (open) e.valves |= bit;
+  else e.valves &= ~bit;
+}
+
+// ========== Node Messages ==========
+// STAT, AUTO_CLOSE and JOIN from incomingQueue - the gateway's loop() and
+// the host replayer both hand messages here. False if msg is none of them.
+bool NodeRegistry::handleMessage(const String &msg) {
+  // Handle STAT messages from nodes
+  if (msg.startsWith("STAT|")) {
+    Serial.println("[Queue] ✓✓✓ TELEMETRY ✓✓✓");
+    
+    int nPos = msg.indexOf("N=");
+    if (nPos >= 0) {
+      int comma = msg.indexOf(',', nPos);
+      String nodeIdStr = msg.substring(nPos + 2, comma > 0 ? comma : msg.length());
+      int nodeId = nodeIdStr.toInt();
+      
+      Serial.printf("[Queue] Node %d Telemetry:\n", nodeId);
+      noteStat(nodeId, msg);
+      
+      // Parse battery
+      if (msg.indexOf("BATT=") >= 0) {
+        int battPos = msg.indexOf("BATT=");
+        int battEnd = msg.indexOf(',', battPos);
+        String battStr = msg.substring(battPos + 5, battEnd > 0 ? battEnd : msg.length());
+        Serial.println("[Queue]   Battery: " + battStr + "%");
+        
+        // Publish low battery warning (important event)
+        int battPct = battStr.toInt();
+        if (battPct < 20) {
+          publishStatus("WARN|LOW_BATT|N=" + String(nodeId) + "|BATT=" + battStr);
+          // Send SMS alert for low battery (with rate limiting to avoid spam)
+          sendSMSNotification("WARN: Low battery on Node " + String(nodeId) +
+                              " - " + battStr + "%",
+                              "LOW_BATT_N" + String(nodeId));
+        }
+      }
+      
+      // Parse battery voltage
+      if (msg.indexOf("BV=") >= 0) {
+        int bvPos = msg.indexOf("BV=");
+        int bvEnd = msg.indexOf(',', bvPos);
+        String bvStr = msg.substring(bvPos + 3, bvEnd > 0 ? bvEnd : msg.length());
+        Serial.println("[Queue]   Batt Voltage: " + bvStr + "V");
+      }
+      
+      // Parse solar
+      if (msg.indexOf("SOLV=") >= 0) {
+        int solPos = msg.indexOf("SOLV=");
+        int solEnd = msg.indexOf(',', solPos);
+        String solStr = msg.substring(solPos + 5, solEnd > 0 ? solEnd : msg.length());
+        Serial.println("[Queue]   Solar: " + solStr + "V");
+      }
+      
+      // Parse valve states
+      for (int i = 1; i <= 4; i++) {
+        String vKey = "V" + String(i) + "=";
+        if (msg.indexOf(vKey) >= 0) {
+          int vPos = msg.indexOf(vKey);
+          int vEnd = msg.indexOf(',', vPos);
+          String vStr = msg.substring(vPos + vKey.length(), vEnd > 0 ? vEnd : msg.length());
+          Serial.println("[Queue]   Valve " + String(i) + ": " + vStr);
+        }
+      }
+      
+      // Parse moisture sensors
+      for (int i = 1; i <= 4; i++) {
+        String mKey = "M" + String(i) + "=";
+        if (msg.indexOf(mKey) >= 0) {
+          int mPos = msg.indexOf(mKey);
+          int mEnd = msg.indexOf(',', mPos);
+          String mStr = msg.substring(mPos + mKey.length(), mEnd > 0 ? mEnd : msg.length());
+          Serial.println("[Queue]   Moisture " + String(i) + ": " + mStr + "%");
+        }
+      }
+    }
+    return true;
+  }
+  
+  // Handle AUTO_CLOSE
+  if (msg.startsWith("AUTO_CLOSE|")) {
+    Serial.println("[Queue] ✓✓✓ AUTO_CLOSE ✓✓✓");
+    Serial.println("[Queue] " + msg);
+    
+    // Parse node ID
+    int nPos = msg.indexOf("N=");
+    String nodeStr = "";
+    if (nPos >= 0) {
+      int comma = msg.indexOf(',', nPos);
+      nodeStr = msg.substring(nPos + 2, comma > 0 ? comma : msg.length());
+    }
+    
+    // Valve from "V=", valve 1 for nodes that don't send it
+    int vPos = msg.indexOf(",V=");
+    int valve = (vPos >= 0) ? msg.substring(vPos + 3).toInt() : 1;
+    noteValve(nodeStr.toInt(), valve, false);
+    
+    // Publish auto-close event (important event - keep this)
+    publishStatus("EVT|AUTO_CLOSE|N=" + nodeStr + (vPos >= 0 ? ",V=" + String(valve) : ""));
+    return true;
+  }
+  
+  // New node asking for an address
+  if (msg.startsWith("JOIN|")) {
+    handleJoin(msg);
+    return true;
+  }
+  return false;
+}
+
+// ========== Joining ==========
+bool NodeRegistry::inSchedule(int node) {
+  for (auto &sch : schedules) {
+    for (auto &st : sch.seq) {
+      if (st.node_id == node) return true;
+    }
+  }
+  return false;
+}
+
+// Up to 16 hex digits, 0 if empty or malformed
+uint64_t NodeRegistry::parseHw(const String &hex) {
+  if (hex.length() == 0 || hex.length() > 16) return 0;
+  uint64_t hw = 0;
+  for (size_t i = 0; i < hex.length(); i++) {
+    char c = hex[i];
+    int d = isdigit((unsigned char)c) ? c - '0' : (isxdigit((unsigned char)c) ? (toupper(c) - 'A' + 10) : -1);
+    if (d < 0) return 0;
+    hw = (hw << 4) | (uint64_t)d;
+  }
+  return hw;
+}
+
+String NodeRegistry::hwString(uint64_t hw) {
+  char buf[17];
+  snprintf(buf, sizeof(buf), "%08lX%08lX", (unsigned long)(hw >> 32), (unsigned long)(hw & 0xFFFFFFFFUL));
+  return String(buf);
+}
+
+// Hand-configured addresses (heard or in a schedule) are never offered;
+// a lapsed offer is
+bool NodeRegistry::addressFree(int node, unsigned long now) {
+  if (node <= 0 || node >= LORA_MAX_NODES || node == LORA_GATEWAY_ID) return false;
+  const NodeEntry &e = nodes[node];
+  if (e.joinPending) return now - e.joinOfferedAt >= NODE_JOIN_OFFER_MS;
+  return !e.known && e.hwId == 0 && !inSchedule(node);
+}
+
+// The address hw already has, else the lowest free one in the pool, else
+// that of the joined node silent longest past NODE_JOIN_REUSE_MS; 0 if none
+int NodeRegistry::addressFor(uint64_t hw) {
+  unsigned long now = millis();
+  for (int n = NODE_JOIN_ADDR_MIN; n <= NODE_JOIN_ADDR_MAX; n++) {
+    if (nodes[n].hwId == hw) return n;
+  }
+  for (int n = NODE_JOIN_ADDR_MIN; n <= NODE_JOIN_ADDR_MAX; n++) {
+    if (addressFree(n, now)) return n;
+  }
+  
+  int oldest = 0;
+  unsigned long oldestQuiet = 0;
+  for (int n = NODE_JOIN_ADDR_MIN; n <= NODE_JOIN_ADDR_MAX; n++) {
+    const NodeEntry &e = nodes[n];
+    if (e.hwId == 0 || e.joinPending || inSchedule(n)) continue;
+    unsigned long quiet = e.lastSeen != 0 ? now - e.lastSeen : now;  // Silent since boot
+    if (quiet >= NODE_JOIN_REUSE_MS && quiet > oldestQuiet) {
+      oldest = n;
+      oldestQuiet = quiet;
+    }
+  }
+  if (oldest != 0) {
+    Serial.printf("[Nodes] Address pool full, reusing %d of silent node %s\n",
+                  oldest, hwString(nodes[oldest].hwId).c_str());
+  }
+  return oldest;
+}
+
+// "JOIN|HW=0004A30B001C2F11,VC=2,SEN=M1;M2[,G=<gateway>]" from a node
+// without an address. The answer goes out once on the home channel; a node
+// that misses it sends JOIN again.
+void NodeRegistry::handleJoin(const String &msg) {
+  uint64_t hw = parseHw(field(msg, "HW="));
+  if (hw == 0) {
+    Serial.println("[Nodes] ⚠ JOIN without a valid hardware ID, ignored");
+    return;
+  }
+  String g = field(msg, "G=");
+  if (g.length() > 0 && g.toInt() != LORA_GATEWAY_ID) return;  // Joining another gateway
+  
+  String hwStr = hwString(hw);
+  int n = addressFor(hw);
+  if (n == 0) {
+    Serial.printf("[Nodes] ❌ No free address for %s\n", hwStr.c_str());
+    publishStatus("WARN|JOIN_FULL|HW=" + hwStr);
+    return;
+  }
+  
+  NodeEntry &e = nodes[n];
+  if (e.hwId != hw) {
+    loraComm.resetLink(n);
+    resetEntry(n);
+    e.hwId = hw;
+    e.joinPending = true;
+  }
+  if (e.joinPending) e.joinOfferedAt = millis();
+  
+  uint8_t valves = e.valveCount;
+  String v = field(msg, "VC=");
+  if (v.length() > 0) valves = (uint8_t)constrain(v.toInt(), 0, NODE_MAX_VALVES);
+  String sensors = field(msg, "SEN=");
+  bool changed = valves != e.valveCount || sensors != e.sensors;
+  e.valveCount = valves;
+  strncpy(e.sensors, sensors.c_str(), sizeof(e.sensors) - 1);
+  e.sensors[sizeof(e.sensors) - 1] = '\0';
+  if (changed && !e.joinPending) saveAddresses();
+  
+  char frame[64];
+  int len = snprintf(frame, sizeof(frame), "JACC|HW=%s,N=%d,G=%d", hwStr.c_str(), n, LORA_GATEWAY_ID);
+  if (!loraComm.sendBulk((const uint8_t *)frame, (uint16_t)len, LORA_HOME_CHANNEL,
+                         LORA_SPREADING_FACTOR, TX_OUTPUT_POWER)) {
+    Serial.printf("[Nodes] ⚠ Radio busy, JOIN from %s left for its retry\n", hwStr.c_str());
+    return;
+  }
+  Serial.printf("[Nodes] JOIN %s -> address %d%s\n", hwStr.c_str(), n,
+                e.joinPending ? " (offered)" : "");
+}
+
+// Releases a joined node's address; hand-configured nodes have none to release
+bool NodeRegistry::forget(int node) {
+  if (node <= 0 || node >= LORA_MAX_NODES || nodes[node].hwId == 0) return false;
+  Serial.printf("[Nodes] Node %d (HW=%s) forgotten\n", node, hwString(nodes[node].hwId).c_str());
+  loraComm.resetLink(node);
+  resetEntry(node);
+  saveAddresses();
+  return true;
+}
+
+int NodeRegistry::valveCount(int node) {
+  if (node <= 0 || node >= LORA_MAX_NODES) return 0;
+  return nodes[node].valveCount;
+}
+
+// One line per joined node: "<address>,<hw>,<valves>,<sensors>"
+void NodeRegistry::loadAddresses() {
+  File f = LittleFS.open(NODE_JOIN_PATH, "r");
+  if (!f) return;
+  int count = 0;
+  while (f.available()) {
+    String line = f.readStringUntil('\n');
+    line.trim();
+    int c1 = line.indexOf(',');
+    int c2 = line.indexOf(',', c1 + 1);
+    int c3 = line.indexOf(',', c2 + 1);
+    if (c1 <= 0 || c2 <= c1 || c3 <= c2) continue;
+    int n = line.substring(0, c1).toInt();
+    uint64_t hw = parseHw(line.substring(c1 + 1, c2));
+    if (n <= 0 || n >= LORA_MAX_NODES || n == LORA_GATEWAY_ID || hw == 0) continue;
+    NodeEntry &e = nodes[n];
+    e.hwId = hw;
+    e.valveCount = (uint8_t)constrain(line.substring(c2 + 1, c3).toInt(), 0, NODE_MAX_VALVES);
+    strncpy(e.sensors, line.substring(c3 + 1).c_str(), sizeof(e.sensors) - 1);
+    e.sensors[sizeof(e.sensors) - 1] = '\0';
+    markKnown(n);
+    count++;
+  }
+  f.close();
+  Serial.printf("[Nodes] ✓ %d joined node(s) loaded\n", count);
+}
+
+void NodeRegistry::saveAddresses() {
+  File f = LittleFS.open(NODE_JOIN_PATH, "w");
+  if (!f) {
+    Serial.println("[Nodes] ❌ Cannot write " NODE_JOIN_PATH);
+    return;
+  }
+  for (int n = 1; n < LORA_MAX_NODES; n++) {
+    const NodeEntry &e = nodes[n];
+    if (e.hwId == 0 || e.joinPending) continue;
+    f.printf("%d,%s,%u,%s\n", n, hwString(e.hwId).c_str(), e.valveCount, e.sensors);
+  }
+  f.close();
+}
+
+bool NodeRegistry::isKnown(int node) {
+  return node > 0 && node < LORA_MAX_NODES && nodes[node].known;
+}
+
+bool NodeRegistry::isDown(int node) {
+  return isKnown(node) && nodes[node].down;
+}
+
+// ========== Health Polling ==========
+// Nodes that keep talking are never polled. A quiet one gets a PING; every
+// unanswered PING doubles the wait before the next, up to NODE_POLL_MAX_MS,
+// and NODE_DOWN_POLLS of them mark the node down.
+void NodeRegistry::loop() {
+  unsigned long now = millis();
+  if (now - lastCheck < NODE_POLL_CHECK_MS) return;
+  lastCheck = now;
+  seedFromSchedules();
+
+  // One poll in flight at a time keeps diagnostics off the air budget
+  for (int n = 1; n < LORA_MAX_NODES; n++) {
+    if (nodes[n].pollMid != 0) return;
+  }
+
+  int due = 0;
+  unsigned long dueQuiet = 0;
+  for (int n = 1; n < LORA_MAX_NODES; n++) {
+    NodeEntry &e = nodes[n];
+    if (!e.known) continue;
+    if (loraComm.nodeSleepy(n)) continue;  // Only reachable right after it talks anyway
+    unsigned long ref = e.lastSeen;
+    if (e.polledAt != 0 && (long)(e.polledAt - ref) > 0) ref = e.polledAt;
+    unsigned long quiet = now - ref;
+    if (ref != 0 && quiet < e.pollIntervalMs) continue;
+    if (ref == 0 && e.polledAt == 0) quiet = (unsigned long)-1;  // Never heard
+    if (due == 0 || quiet > dueQuiet) {
+      due = n;
+      dueQuiet = quiet;
+    }
+  }
+  if (due == 0) return;
+
+  NodeEntry &e = nodes[due];
+  e.polledAt = now;
+  e.pollMid = loraComm.sendAsync("PING", due, "", 0, 0, onPollResult, this, LORA_PRIO_DIAG);
+  if (e.pollMid != 0) {
+    polls++;
+    DEBUG_LORA_PRINTLN(String("[Nodes] Polling quiet node ") + due);
+  }
+}
+
+void NodeRegistry::onPollResult(uint32_t mid, int node, LoRaTxnStatus status, void *ctx) {
+  NodeRegistry *self = (NodeRegistry *)ctx;
+  NodeEntry &e = self->nodes[node];
+  if (mid != e.pollMid) return;
+  e.pollMid = 0;
+  if (status == LORA_TXN_ACKED) return;  // onSeen() already reset the backoff
+
+  e.missedPolls++;
+  e.pollIntervalMs = min((uint32_t)NODE_POLL_MAX_MS, e.pollIntervalMs * 2);
+  if (e.missedPolls >= NODE_DOWN_POLLS && !e.down) {
+    e.down = true;
+    Serial.printf("[Nodes] ❌ Node %d not answering, marked down\n", node);
+    publishStatus("WARN|NODE_DOWN|N=" + String(node));
+  }
+}
+
+// ========== Reporting ==========
+// "NODE|N=3|UP|AGE=42|RSSI=-97|SNR=6|BATT=81|BV=3.92|FW=1.4|HW=0004A30B001C2F11|VC=2|V=1000"
+String NodeRegistry::nodeReport(int node) {
+  if (!isKnown(node)) return "NODE|N=" + String(node) + "|UNKNOWN";
+  const NodeEntry &e = nodes[node];
+
+  String out = "NODE|N=" + String(node) + (e.down ? "|DOWN" : e.lastSeen ? "|UP" : "|SILENT");
+  if (e.lastSeen != 0) {
+    out += "|AGE=" + String((millis() - e.lastSeen) / 1000) + "|RSSI=" + String(e.rssi) +
+           "|SNR=" + String(e.snr);
+    if (e.via != 0) out += "|VIA=" + String(e.via);
+  }
+  if (e.battPct >= 0) out += "|BATT=" + String(e.battPct);
+  if (e.battMv > 0) out += "|BV=" + String(e.battMv / 1000.0f, 2);
+  if (e.fw[0] != '\0') out += "|FW=" + String(e.fw);
+  if (e.hwId != 0) out += "|HW=" + hwString(e.hwId);
+  if (e.valveCount > 0) out += "|VC=" + String(e.valveCount);
+  if (e.sensors[0] != '\0') out += "|SEN=" + String(e.sensors);
+  if (e.valvesKnown != 0) {
+    out += "|V=";
+    for (int v = 0; v < NODE_MAX_VALVES; v++) {
+      out += !(e.valvesKnown & (1 << v)) ? "?" : (e.valves & (1 << v)) ? "1" : "0";
+    }
+  }
+  if (e.missedPolls > 0) out += "|MISSED=" + String(e.missedPolls);
+  return out;
+}
+
+// "known=14 up=12 down=1 silent=1 polls=37"
+String NodeRegistry::summary() {
+  int known = 0, up = 0, down = 0, silent = 0;
+  for (int n = 1; n < LORA_MAX_NODES; n++) {
+    const NodeEntry &e = nodes[n];
+    if (!e.known) continue;
+    known++;
+    if (e.down) down++;
+    else if (e.lastSeen == 0) silent++;
+    else up++;
+  }
+  return "known=" + String(known) + " up=" + String(up) + " down=" + String(down) +
+         " silent=" + String(silent) + " polls=" + String(polls);
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+// NodeRegistry.h - Known nodes, liveness and last reported state
+#ifndef NODE_REGISTRY_H
+#define NODE_REGISTRY_H
+
+#include "Config.h"
+#include "LoRaComm.h"
+
+// Forward declarations for main controller functions
+extern void publishStatus(const String &msg);
+extern void sendSMSNotification(const String &message, const String &alertKey);
+
+struct NodeEntry {
+  bool known;                 // Heard from or referenced by a schedule
+  bool down;                  // Reported down, not heard since
+  unsigned long lastSeen;     // millis() of the last frame, 0 = never
+  int16_t rssi;               // Last frame (relay's link if relayed)
+  int8_t snr;
+  uint8_t via;                // Relay of the last frame, 0 = direct
+  int8_t battPct;             // -1 = never reported
+  uint16_t battMv;            // 0 = never reported
+  char fw[12];                // Firmware version from STAT "FW=", "" if unknown
+  uint8_t valves;             // Bit per valve, 1 = open
+  uint8_t valvesKnown;        // Bit per valve with a reported state
+  uint32_t uplinks;
+  uint32_t pollMid;           // PING in flight, 0 = none
+  uint32_t pollIntervalMs;    // Current quiet time before the next PING
+  unsigned long polledAt;
+  uint8_t missedPolls;
+  
+  // Nodes that joined (JOIN), hwId 0 for hand-configured ones
+  uint64_t hwId;
+  bool joinPending;           // Address offered, not used by the node yet
+  unsigned long joinOfferedAt;
+  uint8_t valveCount;         // From JOIN "VC=", 0 = unknown
+  char sensors[16];           // From JOIN "SEN=", e.g. "M1;M2;T"
+};
+
+class NodeRegistry {
+private:
+  NodeEntry nodes[LORA_MAX_NODES];
+  unsigned long lastCheck;
+  uint32_t polls;
+
+  static void onSeen(uint8_t node, int16_t rssi, int8_t snr, uint8_t via, void *ctx);
+  static void onPollResult(uint32_t mid, int node, LoRaTxnStatus status, void *ctx);
+  static String field(const String &msg, const String &key);
+  void markKnown(int node);
+  void seedFromSchedules();
+  void resetEntry(int node);
+  static bool inSchedule(int node);
+  static uint64_t parseHw(const String &hex);
+  static String hwString(uint64_t hw);
+  bool addressFree(int node, unsigned long now);
+  int addressFor(uint64_t hw);
+  void loadAddresses();
+  void saveAddresses();
+
+public:
+  NodeRegistry();
+  void begin();
+  void loop();
+  void noteStat(int node, const String &msg);
+  void noteValve(int node, int valve, bool open);
+  void handleJoin(const String &msg);
+  bool handleMessage(const String &msg);
+  bool forget(int node);
+  int valveCount(int node);
+  bool isKnown(int node);
+  bool isDown(int node);
+  String nodeReport(int node);
+  String summary();
+};
+
+extern NodeRegistry nodeRegistry;
+
+#endif
\ No newline at end of file
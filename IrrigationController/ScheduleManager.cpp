@@ -1,8 +1,12 @@
 // ScheduleManager.cpp
 #include "ScheduleManager.h"
+#include "NodeRegistry.h"
 #include <ArduinoJson.h>
 
-ScheduleManager::ScheduleManager() {}
+ScheduleManager::ScheduleManager() : phase(PHASE_IDLE), phaseStartMillis(0), phaseWaitMs(0),
+                                     pendingOpenMid(0), openCandidate(0), openResult(0), runEnd(0),
+                                     pendingCloseMid(0), closedAhead(false),
+                                     planCount(0), planEpoch(0), lastPlanCheck(0) {}
 
 void ScheduleManager::setPump(bool on) {
   pinMode(PUMP_PIN, OUTPUT);
@@ -14,14 +18,221 @@ void ScheduleManager::setPump(bool on) {
   Serial.printf("[Pump] %s\n", on ? "ON" : "OFF");
 }
 
-bool ScheduleManager::openNode(int node, int idx, uint32_t duration) {
-  Serial.printf("[Schedule] Opening node %d (idx %d, duration %lu ms)\n", node, idx, duration);
-  return loraComm.sendWithAck("OPEN", node, currentScheduleId, idx, duration);
+// Adjacent steps on one node form a run that goes out as one valve plan
+int ScheduleManager::runEndFrom(const std::vector<SeqStep> &steps, int idx) {
+  int end = idx + 1;
+  while (end < (int)steps.size() && end - idx < LORA_VALVE_PLAN_MAX &&
+         steps[end].node_id == steps[idx].node_id &&
+         steps[end].duration_ms / 1000 < UINT16_MAX && steps[idx].duration_ms / 1000 < UINT16_MAX) {
+    end++;
+  }
+  return end;
+}
+
+// A lone valve-1 step is a plain OPEN, which every node understands - unless
+// it follows a run on the same node, whose last valve only a VSET closes. A
+// step too long for a plan's seconds stays an OPEN regardless.
+bool ScheduleManager::isPlainOpen(const std::vector<SeqStep> &steps, int idx) {
+  if (runEndFrom(steps, idx) != idx + 1 || steps[idx].valve_id != 1) return false;
+  if (steps[idx].duration_ms / 1000 >= UINT16_MAX) return true;
+  return idx == 0 || steps[idx - 1].node_id != steps[idx].node_id;
+}
+
+// OPEN/VSET/CLOSE are queued on the LoRa transaction table; results come
+// back through the callbacks below while the phase machine keeps running.
+// A run is one VSET the node works through by itself. The first run opens before
+// the pump lead (leadMs), so its first valve covers it. With startAt the
+// node holds the command until then; it expires if not delivered by then.
+uint32_t ScheduleManager::openRun(const std::vector<SeqStep> &steps, const String &schedId, int idx,
+                                  uint32_t leadMs, LoRaTxnCallback callback, unsigned long startAt) {
+  int end = runEndFrom(steps, idx);
+  int node = steps[idx].node_id;
+  if (isPlainOpen(steps, idx)) {
+    Serial.printf("[Schedule] Opening node %d (idx %d, duration %lu ms)\n",
+                  node, idx, (unsigned long)(steps[idx].duration_ms + leadMs));
+    return loraComm.sendAsync("OPEN", node, schedId, idx, steps[idx].duration_ms + leadMs,
+                              callback, this, LORA_PRIO_SCHEDULE, nullptr, 0, startAt, startAt);
+  }
+  
+  LoRaValveStep plan[LORA_VALVE_PLAN_MAX];
+  uint32_t total = leadMs;
+  String valves;
+  for (int i = idx; i < end; i++) {
+    uint32_t ms = steps[i].duration_ms + ((i == idx) ? leadMs : 0);
+    plan[i - idx].valve = steps[i].valve_id;
+    plan[i - idx].seconds = (uint16_t)min((uint32_t)UINT16_MAX, (ms + 999) / 1000);
+    total += steps[i].duration_ms;
+    valves += (i == idx ? "" : ",") + String(steps[i].valve_id);
+  }
+  uint8_t params[LORA_FRAME_MAX_PARAMS];
+  size_t len = loraValvePlanEncode(params, sizeof(params), plan, (uint8_t)(end - idx));
+  Serial.printf("[Schedule] Opening node %d valves %s (idx %d-%d, duration %lu ms)\n",
+                node, valves.c_str(), idx, end - 1, (unsigned long)total);
+  return loraComm.sendAsync("VSET", node, schedId, idx, total, callback, this,
+                            LORA_PRIO_SCHEDULE, params, (uint8_t)len, startAt, startAt);
 }
 
-bool ScheduleManager::closeNode(int node, int idx) {
+uint32_t ScheduleManager::closeNode(int node, int idx, LoRaPriority prio) {
   Serial.printf("[Schedule] Closing node %d (idx %d)\n", node, idx);
-  return loraComm.sendWithAck("CLOSE", node, currentScheduleId, idx, 0);
+  return loraComm.sendAsync("CLOSE", node, currentScheduleId, idx, 0, onCloseResult, this, prio);
+}
+
+void ScheduleManager::onOpenResult(uint32_t mid, int node, LoRaTxnStatus status, void *ctx) {
+  ScheduleManager *self = (ScheduleManager *)ctx;
+  if (mid != self->pendingOpenMid) return;  // Stale result from a stopped run
+  self->openResult = (status == LORA_TXN_ACKED) ? 1 : -1;
+  if (status == LORA_TXN_ACKED) nodeRegistry.noteValve(node, seq[self->openCandidate].valve_id, true);
+}
+
+// CLOSE shuts every valve on the node
+void ScheduleManager::onCloseResult(uint32_t mid, int node, LoRaTxnStatus status, void *ctx) {
+  ScheduleManager *self = (ScheduleManager *)ctx;
+  if (mid == self->pendingCloseMid) self->pendingCloseMid = 0;
+  if (status == LORA_TXN_ACKED) {
+    for (int v = 1; v <= NODE_MAX_VALVES; v++) nodeRegistry.noteValve(node, v, false);
+  } else if (status == LORA_TXN_TIMEOUT) {
+    Serial.printf("[Schedule] ⚠ Node %d did not confirm CLOSE\n", node);
+  }
+}
+
+void ScheduleManager::onPlanResult(uint32_t mid, int node, LoRaTxnStatus status, void *ctx) {
+  ScheduleManager *self = (ScheduleManager *)ctx;
+  for (int i = 0; i < self->planCount; i++) {
+    PlannedRun &p = self->plans[i];
+    if (p.mid != mid) continue;
+    p.result = (status == LORA_TXN_ACKED) ? 1 : -1;
+    if (p.result > 0) {
+      Serial.printf("✓ Node %d has step %d, starts in %ld s\n", node, p.idx,
+                    (long)(p.startAt - millis()) / 1000);
+    } else {
+      Serial.printf("[Schedule] ⚠ Node %d (sleepy) missed step %d\n", node, p.idx);
+    }
+    return;
+  }
+}
+
+// ========== Sleepy Nodes ==========
+// A sleepy node only hears the gateway right after it sends, so its runs
+// can't be opened on cue. They are mailed ahead with a start time instead,
+// on the timeline the schedule has when every step runs: lead, then each
+// step back to back from epoch.
+void ScheduleManager::planSleepy(const String &schedId, const std::vector<SeqStep> &steps,
+                                 uint32_t leadMs, time_t epoch) {
+  cancelPlans();
+  planSchedId = schedId;
+  planEpoch = epoch;
+  
+  // millis() at epoch
+  unsigned long base = millis() + (unsigned long)((long)(epoch - time(nullptr)) * 1000L);
+  uint32_t offsetMs = leadMs;
+  for (int i = 0; i < (int)steps.size(); ) {
+    int end = runEndFrom(steps, i);
+    if (loraComm.nodeSleepy(steps[i].node_id) && planCount < MAX_SEQUENCE_STEPS) {
+      // The first run opens with the pump, like runPreOpen() does it
+      unsigned long startAt = (i == 0) ? base : base + offsetMs;
+      if ((long)(startAt - millis()) > 0) {
+        PlannedRun &p = plans[planCount++];
+        p.idx = i;
+        p.node = (uint8_t)steps[i].node_id;
+        p.startAt = startAt;
+        p.result = 0;
+        p.mid = openRun(steps, schedId, i, (i == 0) ? leadMs : 0, onPlanResult, startAt);
+        if (p.mid == 0) p.result = -1;
+      }
+    }
+    for (int k = i; k < end; k++) offsetMs += steps[k].duration_ms;
+    i = end;
+  }
+  if (planCount > 0) {
+    Serial.printf("[Schedule] %s: %d sleepy run(s) mailed ahead\n", schedId.c_str(), planCount);
+  }
+}
+
+// Mails the runs of the next enabled schedule due within LORA_SLEEPY_PLAN_AHEAD_MS
+void ScheduleManager::planAhead() {
+  if (millis() - lastPlanCheck < 5000) return;
+  lastPlanCheck = millis();
+  if (scheduleRunning || scheduleLoaded) return;
+  
+  time_t now = time(nullptr);
+  if (now == (time_t)-1) return;
+  const Schedule *next = nullptr;
+  for (auto &sch : schedules) {
+    if (!sch.enabled || sch.next_run_epoch <= now) continue;
+    if ((uint32_t)(sch.next_run_epoch - now) > LORA_SLEEPY_PLAN_AHEAD_MS / 1000) continue;
+    if (next == nullptr || sch.next_run_epoch < next->next_run_epoch) next = &sch;
+  }
+  if (next == nullptr) return;
+  if (next->id == planSchedId && next->next_run_epoch == planEpoch) return;
+  
+  bool sleepy = false;
+  for (auto &st : next->seq) sleepy = sleepy || loraComm.nodeSleepy(st.node_id);
+  if (!sleepy) return;
+  planSleepy(next->id, next->seq, next->pump_on_before_ms, next->next_run_epoch);
+}
+
+// Plan entry for the run starting at idx of the current schedule, -1 if none
+int ScheduleManager::planFor(int idx) {
+  if (planSchedId != currentScheduleId) return -1;
+  for (int i = 0; i < planCount; i++) {
+    if (plans[i].idx == idx) return i;
+  }
+  return -1;
+}
+
+// A CLOSE replaces a run still in the mailbox and cancels an acked one the
+// node is holding
+void ScheduleManager::cancelPlans() {
+  for (int i = 0; i < planCount; i++) {
+    PlannedRun &p = plans[i];
+    if (p.result < 0 || (long)(millis() - p.startAt) >= 0) continue;
+    p.mid = 0;  // The supersede result isn't a missed step
+    Serial.printf("[Schedule] Cancelling planned step %d on node %d\n", p.idx, p.node);
+    loraComm.sendAsync("CLOSE", p.node, planSchedId, p.idx, 0, onCloseResult, this, LORA_PRIO_SCHEDULE);
+  }
+  planCount = 0;
+  planSchedId = "";
+  planEpoch = 0;
+}
+
+// Try seq[openCandidate..] one OPEN at a time.
+// Returns 1 once a node acked (its index is openCandidate), -1 when no
+// candidates are left, 0 while an OPEN is still in flight.
+int ScheduleManager::advanceOpen() {
+  if (pendingOpenMid != 0) {
+    if (openResult == 0) return 0;
+    pendingOpenMid = 0;
+    if (openResult > 0) {
+      Serial.printf("✓ Node %d opened\n", seq[openCandidate].node_id);
+      runEnd = runEndFrom(seq, openCandidate);
+      return 1;
+    }
+    openCandidate = runEndFrom(seq, openCandidate);
+  }
+  
+  while (openCandidate < (int)seq.size()) {
+    int node = seq[openCandidate].node_id;
+    if (loraComm.nodeSleepy(node)) {
+      // Mailed ahead - wait for the mailbox, then go with its outcome
+      int p = planFor(openCandidate);
+      if (p >= 0 && plans[p].result == 0) return 0;
+      if (p >= 0 && plans[p].result > 0) {
+        runEnd = runEndFrom(seq, openCandidate);
+        nodeRegistry.noteValve(node, seq[openCandidate].valve_id, true);
+        return 1;
+      }
+      Serial.printf("[Schedule] Node %d (sleepy) has no plan for idx %d, skipping\n", node, openCandidate);
+      openCandidate = runEndFrom(seq, openCandidate);
+      continue;
+    }
+    Serial.printf("[Schedule] Trying node %d (idx %d)...\n", node, openCandidate);
+    openResult = 0;
+    pendingOpenMid = openRun(seq, currentScheduleId, openCandidate,
+                             (phase == PHASE_PRE_OPEN) ? pumpOnBeforeMs : 0, onOpenResult);
+    if (pendingOpenMid != 0) return 0;
+    openCandidate = runEndFrom(seq, openCandidate);
+  }
+  return -1;
 }
 
 bool ScheduleManager::parseCompact(const String &compact, Schedule &s) {
@@ -65,9 +276,25 @@ bool ScheduleManager::parseCompact(const String &compact, Schedule &s) {
           String pair = (semi == -1) ? seqs.substring(spos) : seqs.substring(spos, semi);
           int colon = pair.indexOf(':');
           if (colon > 0) {
+            // "node:seconds" drives valve 1, "node:valve:seconds" any valve
             SeqStep st;
             st.node_id = pair.substring(0, colon).toInt();
+            st.valve_id = 1;
+            int colon2 = pair.indexOf(':', colon + 1);
+            if (colon2 > 0) {
+              st.valve_id = pair.substring(colon + 1, colon2).toInt();
+              colon = colon2;
+            }
             st.duration_ms = (uint32_t)pair.substring(colon + 1).toInt() * 1000UL;
+            if (st.valve_id < 1 || st.valve_id > NODE_MAX_VALVES) {
+              Serial.printf("❌ Node %d: no valve %d\n", st.node_id, st.valve_id);
+              return false;
+            }
+            int valves = nodeRegistry.valveCount(st.node_id);  // Reported at JOIN
+            if (valves > 0 && st.valve_id > valves) {
+              Serial.printf("❌ Node %d has %d valve(s), no valve %d\n", st.node_id, valves, st.valve_id);
+              return false;
+            }
             s.seq.push_back(st);
           }
           if (semi == -1) break;
@@ -222,28 +449,66 @@ time_t ScheduleManager::computeNextRun(const Schedule &s, time_t now) {
   return 0;
 }
 
+// ========== Phase State Machine ==========
+void ScheduleManager::enterPhase(SchedulePhase next, uint32_t waitMs) {
+  DEBUG_SCH_PRINTLN(String("[Schedule] Phase ") + phaseName(phase) + " -> " + phaseName(next));
+  phase = next;
+  phaseStartMillis = millis();
+  phaseWaitMs = waitMs;
+}
+
+bool ScheduleManager::phaseElapsed() {
+  return millis() - phaseStartMillis >= phaseWaitMs;
+}
+
+const char* ScheduleManager::phaseName(SchedulePhase p) {
+  switch (p) {
+    case PHASE_IDLE:      return "IDLE";
+    case PHASE_PRE_OPEN:  return "PRE_OPEN";
+    case PHASE_PUMP_LEAD: return "PUMP_LEAD";
+    case PHASE_RUNNING:   return "RUNNING";
+    case PHASE_ADVANCING: return "ADVANCING";
+    case PHASE_PUMP_LAG:  return "PUMP_LAG";
+    case PHASE_DONE:      return "DONE";
+  }
+  return "?";
+}
+
+SchedulePhase ScheduleManager::getPhase() {
+  return phase;
+}
+
 void ScheduleManager::startIfDue() {
   if (!scheduleLoaded) return;
   if (scheduleRunning) return;
+  if (phase != PHASE_IDLE) return;
   if (seq.size() == 0) return;
   
   time_t now = time(nullptr);
   if (now == (time_t)-1) return;
   
   Serial.println("[Schedule] Starting execution...");
-  
-  // Find first node that opens successfully
-  int startIndex = -1;
-  for (size_t i = 0; i < seq.size(); ++i) {
-    Serial.printf("[Schedule] Trying node %d (idx %zu)...\n", seq[i].node_id, i);
-    if (openNode(seq[i].node_id, (int)i, seq[i].duration_ms)) {
-      startIndex = (int)i;
-      Serial.printf("✓ Node %d opened\n", seq[i].node_id);
-      break;
-    }
+  // Late plan for a schedule started without one: only the later sleepy runs
+  // can still make it
+  if (planSchedId != currentScheduleId || planEpoch != scheduleStartEpoch) {
+    bool sleepy = false;
+    for (auto &st : seq) sleepy = sleepy || loraComm.nodeSleepy(st.node_id);
+    if (sleepy) planSleepy(currentScheduleId, seq, pumpOnBeforeMs, now);
   }
+  scheduleRunning = true;
+  openCandidate = 0;
+  pendingOpenMid = 0;
+  pendingCloseMid = 0;
+  closedAhead = false;
+  enterPhase(PHASE_PRE_OPEN);
+}
+
+void ScheduleManager::runPreOpen() {
+  // Find first node that opens successfully
+  int found = advanceOpen();
+  if (found == 0) return;
   
-  if (startIndex < 0) {
+  if (found < 0) {
     Serial.println("❌ No node responded, aborting");
 
     // Notify about schedule failure
@@ -253,79 +518,178 @@ void ScheduleManager::startIfDue() {
                         "SCH_START_FAIL");
 
     // Clear the loaded schedule
+    scheduleRunning = false;
     scheduleLoaded = false;
     currentScheduleId = "";
+    enterPhase(PHASE_IDLE);
     return;
   }
   
-  // Close all other nodes
-  for (size_t i = 0; i < seq.size(); ++i) {
+  int startIndex = openCandidate;
+  
+  // Starting on a planned run: its pump lead ends when the node opens
+  int p = planFor(startIndex);
+  if (p >= 0 && (long)(millis() + pumpOnBeforeMs - plans[p].startAt) < 0) return;
+  
+  // Close all other nodes - one group frame per channel/SF where the nodes
+  // support it, unicast CLOSEs for the rest
+  uint8_t nodes[LORA_MAX_NODES];
+  int indices[LORA_MAX_NODES];
+  uint8_t count = 0;
+  for (size_t i = 0; i < seq.size() && count < LORA_MAX_NODES - 1; ++i) {
     if ((int)i == startIndex) continue;
-    closeNode(seq[i].node_id, (int)i);
+    if (seq[i].node_id == seq[startIndex].node_id) continue;
+    if (loraComm.nodeSleepy(seq[i].node_id)) continue;  // Would cancel its plan
+    nodes[count] = (uint8_t)seq[i].node_id;
+    indices[count] = (int)i;
+    count++;
+  }
+  if (count > 0) {
+    Serial.printf("[Schedule] Closing %d other node(s)\n", count);
+    loraComm.sendGroupAsync("CLOSE", nodes, indices, count, currentScheduleId,
+                            onCloseResult, this, LORA_PRIO_SCHEDULE);
   }
   
-  // Turn on pump
+  // Turn on pump - step timing starts once the lead time has elapsed
   setPump(true);
-  // NOTE: This delay blocks the entire system (MQTT, SMS, LoRa processing)
-  // TODO: Refactor to non-blocking state machine for better responsiveness
-  delay(pumpOnBeforeMs);
-  
-  scheduleRunning = true;
   currentStepIndex = startIndex;
-  stepStartMillis = millis();
   
   prefs.putInt("active_index", currentStepIndex);
   prefs.putString("active_schedule", currentScheduleId);
   
-  Serial.println("✓ Schedule started");
+  enterPhase(PHASE_PUMP_LEAD, pumpOnBeforeMs);
 }
 
-void ScheduleManager::runLoop() {
-  if (!scheduleRunning) {
-    startIfDue();
-    return;
+void ScheduleManager::runAdvancing() {
+  SeqStep &step = seq[currentStepIndex];
+  
+  // A plain OPEN to this node wouldn't close the valve its run ends on, and a
+  // CLOSE queued after it would supersede or undo it - close first and wait
+  if (pendingCloseMid != 0) return;
+  if (!closedAhead && pendingOpenMid == 0 && openCandidate < (int)seq.size() &&
+      seq[openCandidate].node_id == step.node_id && isPlainOpen(seq, openCandidate) &&
+      !loraComm.nodeSleepy(step.node_id)) {
+    closedAhead = true;
+    pendingCloseMid = closeNode(step.node_id, currentStepIndex);
+    if (pendingCloseMid != 0) return;
   }
   
-  if (currentStepIndex < 0 || currentStepIndex >= (int)seq.size()) {
-    Serial.println("[Schedule] Invalid step index, stopping");
+  // Find next node
+  int found = advanceOpen();
+  if (found == 0) return;
+  int nextIdx = (found > 0) ? openCandidate : -1;
+  
+  // A planned run starts at its time; keep the current one until then
+  int p = (nextIdx >= 0) ? planFor(nextIdx) : -1;
+  if (p >= 0 && (long)(millis() - plans[p].startAt) < 0) return;
+  
+  // Close current node - unless the next run on it went out as a VSET,
+  // which already closed the valves it doesn't use, or it was closed ahead.
+  // Sleepy nodes close at the end of their plan by themselves.
+  bool sameNode = nextIdx >= 0 && seq[nextIdx].node_id == step.node_id;
+  bool vset = sameNode && !isPlainOpen(seq, nextIdx);
+  if (!vset && !closedAhead && !loraComm.nodeSleepy(step.node_id)) {
+    closeNode(step.node_id, currentStepIndex);
+  }
+  
+  // No CLOSE result will clear the valve this run ended on
+  if (vset && step.valve_id != seq[nextIdx].valve_id) {
+    nodeRegistry.noteValve(step.node_id, step.valve_id, false);
+  }
+  
+  if (nextIdx >= 0) {
+    currentStepIndex = nextIdx;
+    stepStartMillis = (p >= 0) ? plans[p].startAt : millis();
+    prefs.putInt("active_index", currentStepIndex);
+    Serial.printf("✓ Moved to step %d\n", currentStepIndex);
+    enterPhase(PHASE_RUNNING);
+  } else {
+    Serial.println("✓ Schedule complete");
+    enterPhase(PHASE_PUMP_LAG, pumpOffAfterMs);
+  }
+}
+
+void ScheduleManager::finish() {
+  cancelPlans();
+  scheduleRunning = false;
+  currentStepIndex = -1;
+  prefs.putInt("active_index", -1);
+  
+  // Unload so the trigger check can pick the next due schedule instead of
+  // restarting this one straight away
+  scheduleLoaded = false;
+  currentScheduleId = "";
+  
+  enterPhase(PHASE_IDLE);
+}
+
+void ScheduleManager::runLoop() {
+  // Run state cleared externally (e.g. SMS STOP) - make sure the pump is off
+  if (phase != PHASE_IDLE && !scheduleRunning) {
     stop();
     return;
   }
   
-  SeqStep &step = seq[currentStepIndex];
-  
-  // Check if current step is complete
-  if (millis() - stepStartMillis >= step.duration_ms) {
-    Serial.printf("[Schedule] Step %d complete\n", currentStepIndex);
-    
-    // Find next node
-    int nextIdx = -1;
-    for (int cand = currentStepIndex + 1; cand < (int)seq.size(); ++cand) {
-      if (openNode(seq[cand].node_id, cand, seq[cand].duration_ms)) {
-        nextIdx = cand;
-        Serial.printf("✓ Next node %d opened\n", seq[cand].node_id);
-        break;
+  switch (phase) {
+    case PHASE_IDLE:
+      startIfDue();
+      planAhead();
+      return;
+      
+    case PHASE_PRE_OPEN:
+      runPreOpen();
+      return;
+      
+    case PHASE_PUMP_LEAD:
+      if (phaseElapsed()) {
+        stepStartMillis = millis();
+        enterPhase(PHASE_RUNNING);
+        Serial.println("✓ Schedule started");
       }
-    }
-    
-    // Close current node
-    closeNode(step.node_id, currentStepIndex);
-    
-    if (nextIdx >= 0) {
-      currentStepIndex = nextIdx;
-      stepStartMillis = millis();
-      prefs.putInt("active_index", currentStepIndex);
-      Serial.printf("✓ Moved to step %d\n", currentStepIndex);
-    } else {
-      Serial.println("✓ Schedule complete");
-      // NOTE: This delay blocks the entire system (MQTT, SMS, LoRa processing)
-      // TODO: Refactor to non-blocking state machine for better responsiveness
-      delay(pumpOffAfterMs);
-      setPump(false);
-      scheduleRunning = false;
-      currentStepIndex = -1;
-      prefs.putInt("active_index", -1);
-    }
+      break;
+      
+    case PHASE_RUNNING:
+      if (currentStepIndex < 0 || currentStepIndex >= (int)seq.size()) {
+        Serial.println("[Schedule] Invalid step index, stopping");
+        stop();
+        return;
+      }
+      // Check if current step is complete
+      if (millis() - stepStartMillis >= seq[currentStepIndex].duration_ms) {
+        Serial.printf("[Schedule] Step %d complete\n", currentStepIndex);
+        if (currentStepIndex + 1 < runEnd) {
+          // Next valve of the plan - the node switches over by itself
+          SeqStep &done = seq[currentStepIndex];
+          currentStepIndex++;
+          stepStartMillis = millis();
+          nodeRegistry.noteValve(done.node_id, done.valve_id, false);
+          nodeRegistry.noteValve(done.node_id, seq[currentStepIndex].valve_id, true);
+          prefs.putInt("active_index", currentStepIndex);
+          Serial.printf("✓ Node %d on valve %d (step %d)\n", done.node_id,
+                        seq[currentStepIndex].valve_id, currentStepIndex);
+          break;
+        }
+        openCandidate = runEnd;
+        pendingOpenMid = 0;
+        closedAhead = false;
+        enterPhase(PHASE_ADVANCING);
+      }
+      break;
+      
+    case PHASE_ADVANCING:
+      runAdvancing();
+      break;
+      
+    case PHASE_PUMP_LAG:
+      if (phaseElapsed()) {
+        setPump(false);
+        enterPhase(PHASE_DONE);
+      }
+      break;
+      
+    case PHASE_DONE:
+      finish();
+      return;
   }
   
   // Save progress periodically
@@ -338,18 +702,24 @@ void ScheduleManager::runLoop() {
 }
 
 void ScheduleManager::stop() {
+  pendingOpenMid = 0;
+  pendingCloseMid = 0;
+  
+  // Safety class: goes ahead of everything queued and ignores the budget
   if (currentStepIndex >= 0 && currentStepIndex < (int)seq.size()) {
-    closeNode(seq[currentStepIndex].node_id, currentStepIndex);
+    closeNode(seq[currentStepIndex].node_id, currentStepIndex, LORA_PRIO_SAFETY);
   }
+  cancelPlans();
   
   setPump(false);
   scheduleRunning = false;
   currentStepIndex = -1;
   prefs.putInt("active_index", -1);
+  enterPhase(PHASE_IDLE);
   
   Serial.println("✓ Schedule stopped");
 }
 
 bool ScheduleManager::isRunning() {
   return scheduleRunning;
-}
\ No newline at end of file
+}
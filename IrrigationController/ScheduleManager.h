@@ -11,11 +11,68 @@
 extern void publishStatus(const String &msg);
 extern void sendSMSNotification(const String &message, const String &alertKey);
 
+// Execution phases - runLoop() advances these against millis() deadlines
+// instead of delay(), so LoRa/MQTT/SMS/BLE keep running during pump lead/lag
+enum SchedulePhase {
+  PHASE_IDLE,
+  PHASE_PRE_OPEN,    // Open first responsive node, close the others
+  PHASE_PUMP_LEAD,   // Pump on, waiting pumpOnBeforeMs before timing the step
+  PHASE_RUNNING,     // Current step irrigating
+  PHASE_ADVANCING,   // Step complete - open next node, close current
+  PHASE_PUMP_LAG,    // Last node closed, waiting pumpOffAfterMs before pump off
+  PHASE_DONE         // Pump off - clear run state
+};
+
+// Run mailed ahead of time to a sleepy node, which opens at startAt by itself
+struct PlannedRun {
+  int idx;                    // First step of the run
+  uint8_t node;
+  uint32_t mid;
+  unsigned long startAt;      // millis() when the node opens
+  int8_t result;              // 0 = in the mailbox, 1 = acked, -1 = failed
+};
+
 class ScheduleManager {
 private:
+  SchedulePhase phase;
+  unsigned long phaseStartMillis;
+  uint32_t phaseWaitMs;
+  
+  // OPEN currently in flight while looking for the next responsive node
+  uint32_t pendingOpenMid;
+  int openCandidate;
+  int8_t openResult;         // 0 = waiting, 1 = acked, -1 = failed
+  int runEnd;                // One past the last step the open node was sent
+  uint32_t pendingCloseMid;  // CLOSE that must finish before the next OPEN to its node
+  bool closedAhead;          // This advance already closed the current node
+  
+  // Sleepy-node runs of the next (or current) schedule start
+  PlannedRun plans[MAX_SEQUENCE_STEPS];
+  int planCount;
+  String planSchedId;
+  time_t planEpoch;
+  unsigned long lastPlanCheck;
+
   void setPump(bool on);
-  bool openNode(int node, int idx, uint32_t duration);
-  bool closeNode(int node, int idx);
+  static int runEndFrom(const std::vector<SeqStep> &steps, int idx);
+  static bool isPlainOpen(const std::vector<SeqStep> &steps, int idx);
+  uint32_t openRun(const std::vector<SeqStep> &steps, const String &schedId, int idx,
+                   uint32_t leadMs, LoRaTxnCallback callback, unsigned long startAt = 0);
+  uint32_t closeNode(int node, int idx, LoRaPriority prio = LORA_PRIO_SCHEDULE);
+  int advanceOpen();
+  static void onOpenResult(uint32_t mid, int node, LoRaTxnStatus status, void *ctx);
+  static void onCloseResult(uint32_t mid, int node, LoRaTxnStatus status, void *ctx);
+  static void onPlanResult(uint32_t mid, int node, LoRaTxnStatus status, void *ctx);
+  void planAhead();
+  void planSleepy(const String &schedId, const std::vector<SeqStep> &steps, uint32_t leadMs,
+                  time_t epoch);
+  int planFor(int idx);
+  void cancelPlans();
+  void enterPhase(SchedulePhase next, uint32_t waitMs = 0);
+  bool phaseElapsed();
+  void runPreOpen();
+  void runAdvancing();
+  void finish();
 
 public:
   ScheduleManager();
@@ -27,6 +84,8 @@ public:
   void stop();
   time_t computeNextRun(const Schedule &s, time_t now);
   bool isRunning();
+  SchedulePhase getPhase();
+  const char* phaseName(SchedulePhase p);
 };
 
 extern ScheduleManager scheduleMgr;
@@ -74,6 +74,7 @@ bool StorageManager::saveSchedule(const Schedule &s) {
   for (auto &st : s.seq) {
     JsonObject so = arr.createNestedObject();
     so["node_id"] = st.node_id;
+    so["valve_id"] = st.valve_id;
     so["duration_ms"] = st.duration_ms;
   }
   
@@ -130,7 +131,13 @@ Schedule StorageManager::scheduleFromJson(const String &json) {
     for (JsonVariant v : doc["sequence"].as<JsonArray>()) {
       SeqStep st;
       st.node_id = v["node_id"].as<int>();
+      st.valve_id = v["valve_id"] | 1;
       st.duration_ms = v["duration_ms"].as<uint32_t>();
+      if (st.valve_id < 1 || st.valve_id > NODE_MAX_VALVES) {
+        Serial.printf("❌ Node %d: no valve %d\n", st.node_id, st.valve_id);
+        s.id = "";
+        return s;
+      }
       s.seq.push_back(st);
     }
   }
@@ -142,11 +142,26 @@ time_t nextWeekdayOccurrence(time_t now, uint8_t weekday_mask, int hour, int min
 }
 
 // ========== Message ID ==========
+// MIDs are handed out from RAM. NVS only stores the ceiling of the block
+// reserved so far ("msg_counter"), so there is one flash write per
+// MSG_ID_BLOCK_SIZE commands. After a reboot allocation resumes at the
+// stored ceiling, skipping whatever was left of the previous block, so a
+// MID is never reused.
+static uint32_t msgIdNext = 0;
+static uint32_t msgIdCeiling = 0;   // Last MID covered by the NVS reservation
+
 uint32_t getNextMsgId() {
-  uint32_t mid = prefs.getUInt("msg_counter", 0);
-  mid++;
-  prefs.putUInt("msg_counter", mid);
-  return mid;
+  if (msgIdNext == 0 || msgIdNext > msgIdCeiling) {
+    if (msgIdCeiling == 0) {
+      msgIdCeiling = prefs.getUInt("msg_counter", 0);
+    }
+    uint32_t base = msgIdCeiling;
+    if (base > UINT32_MAX - MSG_ID_BLOCK_SIZE) base = 0;  // Wrap, MID 0 stays reserved
+    msgIdNext = base + 1;
+    msgIdCeiling = base + MSG_ID_BLOCK_SIZE;
+    prefs.putUInt("msg_counter", msgIdCeiling);
+  }
+  return msgIdNext++;
 }
 
 // ========== Debugging ==========
@@ -0,0 +1,574 @@
+// LoRaSim.cpp
+#include "LoRaSim.h"
+#include "LoRaComm.h"
+#include "LoRaFrame.h"
+#include <math.h>
+
+static const uint32_t channelPlan[LORA_CHANNEL_COUNT] = LORA_CHANNEL_PLAN;
+
+LoRaSim::LoRaSim() : events(nullptr), nodeCount(0), rng(1), state(LORA_SIM_RADIO_IDLE),
+                     gwChannel(LORA_HOME_CHANNEL), gwSf(LORA_SPREADING_FACTOR), rxSession(0),
+                     gwLen(0), gwAir(-1), recentPos(0), nodes(nullptr), queue(nullptr),
+                     queueCap(0) {
+  memset(air, 0, sizeof(air));
+  memset(&stats, 0, sizeof(stats));
+  memset(recentMids, 0, sizeof(recentMids));
+}
+
+LoRaSim::~LoRaSim() {
+  free(nodes);
+  free(queue);
+}
+
+// xorshift32 - the same seed gives the same node layout and fading
+uint32_t LoRaSim::random32() {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+int LoRaSim::randomRange(int lo, int hi) {
+  return lo + (int)(random32() % (uint32_t)(hi - lo + 1));
+}
+
+// "KEY=value" preceded by '|' or ',' in a text frame, -1 if absent
+static long simField(const char *msg, const char *key) {
+  size_t keyLen = strlen(key);
+  for (const char *p = strstr(msg, key); p != NULL; p = strstr(p + keyLen, key)) {
+    if (p > msg && (p[-1] == '|' || p[-1] == ',')) return atol(p + keyLen);
+  }
+  return -1;
+}
+
+// ========== Network ==========
+// Nodes uniform over the disc; everyone is heard once during the warm-up
+bool LoRaSim::begin(int count, uint32_t rangeMeters, uint32_t seed) {
+  if (count < 1 || count >= LORA_MAX_NODES || rangeMeters < 20) return false;
+  queueCap = count + LORA_SIM_SPARE_EVENTS;
+  nodes = (LoRaSimNode *)calloc(count + 1, sizeof(LoRaSimNode));
+  queue = (LoRaSimEvent *)calloc(queueCap, sizeof(LoRaSimEvent));
+  if (nodes == nullptr || queue == nullptr) return false;
+
+  nodeCount = count;
+  rng = seed != 0 ? seed : 1;
+  unsigned long now = millis();
+  for (int n = 1; n <= count; n++) {
+    LoRaSimNode &node = nodes[n];
+    float u = (float)(random32() % 10000) / 10000.0f;
+    node.distanceM = (uint16_t)max(20.0f, rangeMeters * sqrtf(u));
+    node.shadowDb = (int8_t)randomRange(-LORA_SIM_SHADOW_DB, LORA_SIM_SHADOW_DB);
+    node.channel = n % LORA_CHANNEL_COUNT;
+    node.sf = LORA_SPREADING_FACTOR;
+    node.nextStatAt = now + randomRange(0, LORA_SIM_WARMUP_MS - 1);
+    node.txUntil = now;
+  }
+  return true;
+}
+
+const LoRaSimStats& LoRaSim::getStats() {
+  return stats;
+}
+
+int LoRaSim::getNodeCount() {
+  return nodeCount;
+}
+
+// Earliest queued event or node timer, so the clock can jump there
+unsigned long LoRaSim::nextEventAt(unsigned long now) {
+  unsigned long next = now + LORA_SIM_TIMEOUT_MS;
+  for (int i = 0; i < queueCap; i++) {
+    if (queue[i].used && (long)(queue[i].at - next) < 0) next = queue[i].at;
+  }
+  for (int n = 1; n <= nodeCount; n++) {
+    const LoRaSimNode &node = nodes[n];
+    unsigned long at = node.nextStatAt;
+    if (node.autoCloseAt != 0 && (long)(node.autoCloseAt - at) < 0) at = node.autoCloseAt;
+    if ((long)(node.txUntil - at) > 0) at = node.txUntil;
+    if ((long)(at - next) < 0) next = at;
+  }
+  return (long)(next - now) < 0 ? now : next;
+}
+
+// ========== Event Queue ==========
+LoRaSimEvent* LoRaSim::schedule(uint8_t kind, uint8_t node, unsigned long at) {
+  for (int i = 0; i < queueCap; i++) {
+    if (queue[i].used) continue;
+    LoRaSimEvent &e = queue[i];
+    e.used = true;
+    e.kind = kind;
+    e.node = node;
+    e.at = at;
+    e.len = 0;
+    return &e;
+  }
+  stats.overflows++;
+  return nullptr;
+}
+
+// The node is busy from now until its frame is off the air
+void LoRaSim::scheduleTx(uint8_t node, const uint8_t *data, size_t len, uint8_t channel,
+                         uint8_t sf, unsigned long at) {
+  if (len == 0 || len > LORA_SIM_FRAME_LEN) return;
+  LoRaSimEvent *e = schedule(LORA_SIM_EV_NODE_TX, node, at);
+  if (e == nullptr) return;
+  e->channel = channel;
+  e->sf = sf;
+  e->len = (uint8_t)len;
+  memcpy(e->data, data, len);
+  nodes[node].txUntil = at + LoRaComm::airtimeMs((uint16_t)len, sf);
+}
+
+// Runs every due event in time order, then the nodes' own timers, until
+// nothing more is due now - Radio.IrqProcess()
+void LoRaSim::process() {
+  unsigned long now = millis();
+  do {
+    for (;;) {
+      int next = -1;
+      for (int i = 0; i < queueCap; i++) {
+        if (!queue[i].used || (long)(now - queue[i].at) < 0) continue;
+        if (next < 0 || (long)(queue[i].at - queue[next].at) < 0) next = i;
+      }
+      if (next < 0) break;
+      LoRaSimEvent e = queue[next];
+      queue[next].used = false;  // Free first - handlers schedule follow-ups
+      runEvent(e);
+    }
+  } while (serviceNodes(now));
+}
+
+void LoRaSim::runEvent(LoRaSimEvent &e) {
+  switch (e.kind) {
+    case LORA_SIM_EV_GW_TX_END:
+      gatewayTxEnd(e.at);
+      break;
+
+    case LORA_SIM_EV_CAD_DONE: {
+      setState(LORA_SIM_RADIO_IDLE);
+      bool activity = false;
+      for (int i = 0; i < LORA_SIM_MAX_AIR && !activity; i++) {
+        const LoRaSimAir &a = air[i];
+        activity = a.used && !a.gateway && a.channel == gwChannel && a.sf == gwSf &&
+                   (long)(e.at - a.start) >= 0 && (long)(a.end - e.at) > 0;
+      }
+      if (events->CadDone != nullptr) events->CadDone(activity);
+      break;
+    }
+
+    case LORA_SIM_EV_NODE_TX:
+      nodeTxStart(e);
+      break;
+
+    case LORA_SIM_EV_NODE_TX_END:
+      nodeTxEnd(e);
+      break;
+  }
+}
+
+// STAT and AUTO_CLOSE uplinks, on the home channel at the default SF.
+// Returns whether any node started one.
+bool LoRaSim::serviceNodes(unsigned long now) {
+  bool sent = false;
+  char msg[LORA_SIM_FRAME_LEN];
+  for (int n = 1; n <= nodeCount; n++) {
+    LoRaSimNode &node = nodes[n];
+    if ((long)(now - node.txUntil) < 0) continue;
+
+    if (node.autoCloseAt != 0 && (long)(now - node.autoCloseAt) >= 0) {
+      node.valveOpen = false;
+      node.autoCloseAt = 0;
+      int len = snprintf(msg, sizeof(msg), "AUTO_CLOSE|N=%d,V=1,SEQ=%u,F=B", n, ++node.seq);
+      scheduleTx(n, (const uint8_t *)msg, len, LORA_HOME_CHANNEL, LORA_SPREADING_FACTOR, now);
+      stats.autoCloses++;
+      sent = true;
+      continue;
+    }
+
+    if ((long)(now - node.nextStatAt) >= 0) {
+      int batt = randomRange(40, 100);
+      int mv = 3300 + batt * 9;
+      int len = snprintf(msg, sizeof(msg), "STAT|N=%d,BATT=%d,BV=%d.%02d,V1=%d,SEQ=%u,F=B",
+                         n, batt, mv / 1000, (mv % 1000) / 10, node.valveOpen ? 1 : 0, ++node.seq);
+      scheduleTx(n, (const uint8_t *)msg, len, LORA_HOME_CHANNEL, LORA_SPREADING_FACTOR, now);
+      node.nextStatAt = now + randomRange(LORA_SIM_STAT_MS / 2, LORA_SIM_STAT_MS * 3 / 2);
+      stats.stats++;
+      sent = true;
+    }
+  }
+  return sent;
+}
+
+// ========== Channel Model ==========
+// Returns the air table index, -1 if it's full. Marks what the new frame
+// collides with: a node frame spoils a gateway frame on its channel/SF for
+// the nodes, two node frames on one channel/SF leave only one that's
+// LORA_SIM_CAPTURE_DB louder.
+int LoRaSim::addAir(bool gateway, uint8_t node, uint8_t channel, uint8_t sf, int16_t rssi,
+                    unsigned long start, unsigned long end) {
+  int idx = -1;
+  for (int i = 0; i < LORA_SIM_MAX_AIR && idx < 0; i++) {
+    if (!air[i].used) idx = i;
+  }
+  if (idx < 0) {
+    stats.overflows++;
+    return -1;
+  }
+
+  LoRaSimAir &a = air[idx];
+  a.used = true;
+  a.gateway = gateway;
+  a.node = node;
+  a.channel = channel;
+  a.sf = sf;
+  a.rssi = rssi;
+  a.start = start;
+  a.end = end;
+  a.collided = false;
+  bool listening = state == LORA_SIM_RADIO_RX && channel == gwChannel && sf == gwSf;
+  a.rxSession = (!gateway && listening) ? rxSession : 0;
+
+  for (int i = 0; i < LORA_SIM_MAX_AIR; i++) {
+    LoRaSimAir &o = air[i];
+    if (i == idx || !o.used) continue;
+    if ((long)(o.end - start) <= 0 || (long)(end - o.start) <= 0) continue;
+
+    if (gateway != o.gateway) {
+      if (o.channel == channel && o.sf == sf) (gateway ? a : o).collided = true;
+      continue;
+    }
+    if (gateway || o.channel != channel || o.sf != sf) continue;
+    if (rssi < o.rssi + LORA_SIM_CAPTURE_DB) a.collided = true;
+    if (o.rssi < rssi + LORA_SIM_CAPTURE_DB) o.collided = true;
+  }
+  return idx;
+}
+
+// Same path both ways; fading is drawn per frame
+int16_t LoRaSim::linkRssi(uint8_t node) {
+  const LoRaSimNode &n = nodes[node];
+  float pathLoss = LORA_SIM_PL0_DB + 10.0f * LORA_SIM_PATH_EXP * log10f((float)n.distanceM);
+  return (int16_t)lroundf(TX_OUTPUT_POWER - pathLoss) + n.shadowDb +
+         randomRange(-LORA_SIM_FADE_DB, LORA_SIM_FADE_DB);
+}
+
+// SX126x demodulation floor: -7.5 dB at SF7, 2.5 dB lower per SF step
+int LoRaSim::requiredSnr(uint8_t sf) {
+  return -5 - ((int)sf - 6) * 5 / 2;
+}
+
+void LoRaSim::nodeTxStart(LoRaSimEvent &e) {
+  uint32_t ms = LoRaComm::airtimeMs(e.len, e.sf);
+  stats.nodeFrames++;
+  stats.nodeAirMs += ms;
+
+  int idx = addAir(false, e.node, e.channel, e.sf, linkRssi(e.node), e.at, e.at + ms);
+  if (idx < 0) return;
+  LoRaSimEvent *end = schedule(LORA_SIM_EV_NODE_TX_END, e.node, e.at + ms);
+  if (end == nullptr) {
+    air[idx].used = false;
+    return;
+  }
+  end->air = (uint8_t)idx;
+  end->channel = e.channel;
+  end->sf = e.sf;
+  end->len = e.len;
+  memcpy(end->data, e.data, e.len);
+}
+
+void LoRaSim::nodeTxEnd(LoRaSimEvent &e) {
+  LoRaSimAir a = air[e.air];
+  air[e.air].used = false;
+
+  if (a.rxSession == 0 || a.rxSession != rxSession) {
+    stats.deaf++;
+    return;
+  }
+  if (a.collided) {
+    stats.collisions++;
+    if (events->RxError != nullptr) events->RxError();
+    return;
+  }
+  int snr = a.rssi - LORA_SIM_NOISE_DBM;
+  if (snr < requiredSnr(a.sf)) {
+    stats.weak++;
+    return;
+  }
+  stats.delivered++;
+  if (events->RxDone != nullptr) events->RxDone(e.data, e.len, a.rssi, (int8_t)min(snr, 12));
+}
+
+// ========== Radio Driver ==========
+// A frame is only received by the RX session it started in; leaving RX or
+// retuning ends the session
+void LoRaSim::setState(LoRaSimRadioState next) {
+  if (state == LORA_SIM_RADIO_RX || next == LORA_SIM_RADIO_RX) rxSession++;
+  state = next;
+}
+
+void LoRaSim::init(RadioEvents_t *radioEvents) {
+  events = radioEvents;
+  standby();
+}
+
+void LoRaSim::setChannel(uint32_t freq) {
+  for (uint8_t i = 0; i < LORA_CHANNEL_COUNT; i++) {
+    if (channelPlan[i] != freq || i == gwChannel) continue;
+    gwChannel = i;
+    if (state == LORA_SIM_RADIO_RX) rxSession++;
+  }
+}
+
+void LoRaSim::setSf(uint8_t sf) {
+  if (sf == gwSf) return;
+  gwSf = sf;
+  if (state == LORA_SIM_RADIO_RX) rxSession++;
+}
+
+void LoRaSim::rx() {
+  setState(LORA_SIM_RADIO_RX);
+}
+
+// Sleep, standby and a re-init abort a transmission or CAD in progress:
+// the frame reaches nobody and no TxDone or CadDone follows
+void LoRaSim::standby() {
+  for (int i = 0; i < queueCap; i++) {
+    uint8_t kind = queue[i].kind;
+    if (kind == LORA_SIM_EV_GW_TX_END || kind == LORA_SIM_EV_CAD_DONE) queue[i].used = false;
+  }
+  if (gwAir >= 0) air[gwAir].used = false;
+  gwAir = -1;
+  setState(LORA_SIM_RADIO_IDLE);
+}
+
+void LoRaSim::noteCommandMid(uint32_t mid) {
+  stats.cmdFrames++;
+  for (int i = 0; i < LORA_SIM_MID_HISTORY; i++) {
+    if (recentMids[i] == mid) {
+      stats.retransmissions++;
+      return;
+    }
+  }
+  recentMids[recentPos] = mid;
+  recentPos = (recentPos + 1) % LORA_SIM_MID_HISTORY;
+}
+
+void LoRaSim::send(const uint8_t *frame, uint16_t len) {
+  if (len >= LORA_BUFFER_SIZE) return;  // sendRaw() never passes more
+  unsigned long now = millis();
+  setState(LORA_SIM_RADIO_TX);
+  uint32_t ms = LoRaComm::airtimeMs(len, gwSf);
+  stats.gwFrames++;
+  stats.gwAirMs += ms;
+
+  memcpy(gwFrame, frame, len);
+  gwLen = len;
+  gwAir = addAir(true, 0, gwChannel, gwSf, 0, now, now + ms);
+
+  LoRaFrame f;
+  LoRaGroupFrame g;
+  if (loraFrameIsGroup(frame, len)) {
+    if (loraGroupDecode(frame, len, g)) noteCommandMid(g.mid);
+  } else if (loraFrameIsBinary(frame, len)) {
+    if (loraFrameDecode(frame, len, f) && f.type == LORA_FT_CMD) noteCommandMid(f.mid);
+  } else if (len > 4 && memcmp(frame, "CMD|", 4) == 0) {
+    char msg[LORA_BUFFER_SIZE];
+    memcpy(msg, frame, len);
+    msg[len] = '\0';
+    noteCommandMid((uint32_t)simField(msg, "MID="));
+  }
+
+  schedule(LORA_SIM_EV_GW_TX_END, 0, now + ms);
+}
+
+// CAD takes about two symbols
+void LoRaSim::startCad() {
+  setState(LORA_SIM_RADIO_CAD);
+  uint32_t ms = (((uint32_t)1 << gwSf) * 2) / 125 + 1;
+  schedule(LORA_SIM_EV_CAD_DONE, 0, millis() + ms);
+}
+
+// ========== Nodes ==========
+// The nodes decode the frame once it's complete
+void LoRaSim::gatewayTxEnd(unsigned long at) {
+  setState(LORA_SIM_RADIO_IDLE);
+  if (events->TxDone != nullptr) events->TxDone();
+  if (gwAir < 0) return;
+
+  LoRaSimAir a = air[gwAir];
+  air[gwAir].used = false;
+  gwAir = -1;
+
+  if (loraFrameIsGroup(gwFrame, gwLen)) {
+    nodeGroup(gwFrame, gwLen, a, at);
+  } else if (!loraFrameIsBinary(gwFrame, gwLen) || gwFrame[1] == LORA_FT_CMD) {
+    nodeCommand(gwFrame, gwLen, a, at);
+  }
+}
+
+bool LoRaSim::nodeHears(uint8_t node, const LoRaSimAir &a) {
+  const LoRaSimNode &n = nodes[node];
+  if (n.channel != a.channel || n.sf != a.sf) return false;
+  if (a.collided) return false;
+  if ((long)(n.txUntil - a.start) > 0) return false;  // Was busy transmitting
+  return linkRssi(node) - LORA_SIM_NOISE_DBM >= requiredSnr(a.sf);
+}
+
+// Returns false for a retransmission of the last command, which is only re-acked
+bool LoRaSim::applyOp(uint8_t node, uint32_t mid, uint8_t op, uint32_t durationMs,
+                      unsigned long at) {
+  LoRaSimNode &n = nodes[node];
+  if (mid == n.lastMid) return false;
+  n.lastMid = mid;
+  if (op == LORA_OP_OPEN || op == LORA_OP_VSET) {
+    n.valveOpen = true;
+    n.autoCloseAt = (durationMs > 0) ? at + durationMs : 0;
+    stats.opens++;
+  } else if (op == LORA_OP_CLOSE) {
+    n.valveOpen = false;
+    n.autoCloseAt = 0;
+  }
+  return true;
+}
+
+// Unicast command, binary or "CMD|MID=5|OPEN|N=3,S=sched1,I=0,T=60000"
+void LoRaSim::nodeCommand(const uint8_t *data, uint16_t len, const LoRaSimAir &a,
+                          unsigned long at) {
+  uint8_t ack[LORA_SIM_FRAME_LEN];
+  size_t ackLen = 0;
+  int node;
+  uint32_t mid;
+  uint8_t op;
+  uint32_t durationMs = 0;
+  int newSf = 0;
+  LoRaFrame f;
+
+  if (loraFrameIsBinary(data, len)) {
+    if (!loraFrameDecode(data, len, f) || f.type != LORA_FT_CMD) return;
+    node = f.node;
+    mid = f.mid;
+    op = f.op;
+    durationMs = f.durationMs;
+    if (op == LORA_OP_SETDR && f.paramsLen >= 1) newSf = f.params[0];
+
+    LoRaFrame reply = f;
+    reply.type = LORA_FT_ACK;
+    reply.op = (op == LORA_OP_PING) ? LORA_OP_PONG : op;
+    reply.durationMs = 0;
+    reply.params = nullptr;
+    reply.paramsLen = 0;
+    ackLen = loraFrameEncode(ack, sizeof(ack), reply);
+  } else {
+    char msg[LORA_BUFFER_SIZE];
+    memcpy(msg, data, len);
+    msg[len] = '\0';
+    if (strncmp(msg, "CMD|", 4) != 0) return;
+    const char *typeStart = strchr(msg + 4, '|');
+    const char *typeEnd = typeStart ? strchr(typeStart + 1, '|') : NULL;
+    if (typeEnd == NULL || typeEnd - typeStart - 1 >= LORA_TXN_TYPE_LEN) return;
+    char type[LORA_TXN_TYPE_LEN];
+    memcpy(type, typeStart + 1, typeEnd - typeStart - 1);
+    type[typeEnd - typeStart - 1] = '\0';
+
+    char sched[LORA_TXN_SCHED_LEN] = "";
+    const char *s = strstr(typeEnd, ",S=");
+    if (s != NULL) {
+      s += 3;
+      size_t n = strcspn(s, ",|");
+      if (n >= sizeof(sched)) n = sizeof(sched) - 1;
+      memcpy(sched, s, n);
+      sched[n] = '\0';
+    }
+
+    node = (int)simField(msg, "N=");
+    mid = (uint32_t)simField(msg, "MID=");
+    op = loraOpFromName(type);
+    long t = simField(msg, "T=");
+    if (t > 0) durationMs = (uint32_t)t;
+    if (op == LORA_OP_SETDR) newSf = (int)simField(msg, "SF=");
+
+    int n = snprintf((char *)ack, sizeof(ack), "ACK|MID=%u|%s|N=%d,I=%ld,S=%s|OK",
+                     mid, op == LORA_OP_PING ? "PONG" : type, node, simField(msg, "I="), sched);
+    ackLen = (n > 0 && n < (int)sizeof(ack)) ? (size_t)n : 0;
+  }
+
+  if (node < 1 || node > nodeCount) return;
+  if (!nodeHears((uint8_t)node, a)) {
+    stats.downLost++;
+    return;
+  }
+  stats.downHeard++;
+
+  // The ACK goes out where the gateway is listening; SETDR applies after it
+  LoRaSimNode &n = nodes[node];
+  uint8_t ackSf = n.sf;
+  bool fresh = applyOp((uint8_t)node, mid, op, durationMs, at);
+  scheduleTx((uint8_t)node, ack, ackLen, n.channel, ackSf, at + LORA_SIM_TURNAROUND_MS);
+  if (fresh && newSf >= LORA_ADR_MIN_SF && newSf <= LORA_ADR_MAX_SF) n.sf = (uint8_t)newSf;
+}
+
+// Every addressed node that decodes the frame ACKs in its rank slot
+void LoRaSim::nodeGroup(const uint8_t *data, uint16_t len, const LoRaSimAir &a,
+                        unsigned long at) {
+  LoRaGroupFrame g;
+  if (!loraGroupDecode(data, len, g)) return;
+
+  int rank = 0;
+  for (int i = 0; i < g.bitmapLen * 8; i++) {
+    if (!(g.bitmap[i / 8] & (1 << (i % 8)))) continue;
+    int node = g.base + i;
+    int slot = rank++;
+    if (node < 1 || node > nodeCount) continue;
+    if (!nodeHears((uint8_t)node, a)) {
+      stats.downLost++;
+      continue;
+    }
+    stats.downHeard++;
+    applyOp((uint8_t)node, g.mid, g.op, 0, at);
+
+    LoRaFrame reply;
+    reply.type = LORA_FT_ACK;
+    reply.op = g.op;
+    reply.mid = g.mid;
+    reply.node = (uint8_t)node;
+    reply.schedHash = g.schedHash;
+    reply.step = LORA_FRAME_NO_STEP;
+    reply.durationMs = 0;
+    reply.params = nullptr;
+    reply.paramsLen = 0;
+    uint8_t ack[LORA_SIM_FRAME_LEN];
+    size_t ackLen = loraFrameEncode(ack, sizeof(ack), reply);
+    scheduleTx((uint8_t)node, ack, ackLen, nodes[node].channel, nodes[node].sf,
+               at + LORA_SIM_TURNAROUND_MS + (unsigned long)slot * g.slotMs);
+  }
+}
+
+// ========== Radio Table ==========
+// Stands in for Heltec's SX1262 driver
+static void radioInit(RadioEvents_t *events) { loraSim.init(events); }
+static void radioSetChannel(uint32_t freq) { loraSim.setChannel(freq); }
+static void radioStandby() { loraSim.standby(); }
+static void radioRx(uint32_t timeout) { loraSim.rx(); }
+static void radioStartCad() { loraSim.startCad(); }
+static void radioIrqProcess() { loraSim.process(); }
+static void radioSend(uint8_t *buffer, uint8_t size) { loraSim.send(buffer, size); }
+
+static void radioSetRxConfig(RadioModems_t modem, uint32_t bandwidth, uint32_t datarate,
+                             uint8_t coderate, uint32_t bandwidthAfc, uint16_t preambleLen,
+                             uint16_t symbTimeout, bool fixLen, uint8_t payloadLen, bool crcOn,
+                             bool freqHopOn, uint8_t hopPeriod, bool iqInverted,
+                             bool rxContinuous) {
+  loraSim.setSf((uint8_t)datarate);
+}
+
+static void radioSetTxConfig(RadioModems_t modem, int8_t power, uint32_t fdev,
+                             uint32_t bandwidth, uint32_t datarate, uint8_t coderate,
+                             uint16_t preambleLen, bool fixLen, bool crcOn, bool freqHopOn,
+                             uint8_t hopPeriod, bool iqInverted, uint32_t timeout) {
+  loraSim.setSf((uint8_t)datarate);
+}
+
+const struct Radio_s Radio = {
+  radioInit, radioSetChannel, radioSetRxConfig, radioSetTxConfig, radioSend,
+  radioStandby, radioStandby, radioRx, radioStartCad, radioIrqProcess
+};
\ No newline at end of file
@@ -0,0 +1,184 @@
+// LoRaSim.h - Simulated SX1262 and LoRa network for gateway benchmarking
+//
+// The host build links the gateway's own LoRaComm, ScheduleManager and
+// NodeRegistry against this in place of Heltec's radio driver: Radio.*
+// calls land here, and virtual nodes answer through the same RadioEvents
+// callbacks, delivered from Radio.IrqProcess() like the real interrupts.
+// Time is virtual - main.cpp moves millis() straight to the next event.
+//
+// Model:
+//   - Airtime from LoRaComm::airtimeMs() for the frame length and SF
+//   - Log-distance path loss from a fixed per-node distance, plus fixed
+//     per-node shadowing and per-frame fading; a frame is heard when its
+//     SNR clears the SF's demodulation floor
+//   - Frames overlapping on the same channel/SF collide; at the gateway the
+//     stronger one survives by LORA_SIM_CAPTURE_DB. The gateway only hears
+//     a frame it was in RX for, on that channel/SF, from start to end.
+//   - Nodes listen on the channel/SF the gateway assigned them, ACK unicast
+//     and group commands (group replies in their rank slot), follow SETDR's
+//     SF, send AUTO_CLOSE when an OPEN's duration runs out, and send STAT on
+//     the home channel at random intervals (pure ALOHA, no TDMA slots)
+//   - Nodes are direct and speak binary frames; relays and FUOTA aren't
+//     modelled
+#ifndef LORA_SIM_H
+#define LORA_SIM_H
+
+#include "Config.h"
+#include "LoRaWan_APP.h"
+
+// ========== Model Settings ==========
+#define LORA_SIM_STEP_S 10            // Default valve time per step
+#define LORA_SIM_RANGE_M 5000         // Default radius nodes are spread over
+#define LORA_SIM_WARMUP_MS 60000      // Nodes send a first STAT before the schedule starts
+#define LORA_SIM_STAT_MS 600000       // Mean STAT interval per node
+#define LORA_SIM_TIMEOUT_MS 14400000  // Scenario gives up after 4 h of virtual time
+#define LORA_SIM_TICK_MS 1            // Longest virtual step between gateway loop passes
+#define LORA_SIM_TURNAROUND_MS 30     // Node RX-to-TX turnaround
+#define LORA_SIM_PL0_DB 31.5f         // Path loss at 1 m (865 MHz)
+#define LORA_SIM_PATH_EXP 3.0f        // Log-distance exponent (rural, low antennas)
+#define LORA_SIM_SHADOW_DB 6          // Fixed per-node shadowing, uniform +/-
+#define LORA_SIM_FADE_DB 3            // Per-frame fading, uniform +/-
+#define LORA_SIM_NOISE_DBM -117       // 125 kHz noise floor with a 6 dB noise figure
+#define LORA_SIM_CAPTURE_DB 6         // Stronger frame survives a collision by this margin
+#define LORA_SIM_SPARE_EVENTS 32      // Event slots beyond one per node
+#define LORA_SIM_MAX_AIR 32           // Overlapping transmissions tracked
+#define LORA_SIM_FRAME_LEN 80         // Longest node frame
+#define LORA_SIM_MID_HISTORY 32       // Recent command MIDs, for counting retransmissions
+
+enum LoRaSimEventKind {
+  LORA_SIM_EV_GW_TX_END,      // Gateway frame finished - TxDone, nodes decode it
+  LORA_SIM_EV_CAD_DONE,
+  LORA_SIM_EV_NODE_TX,        // Node starts transmitting data[]
+  LORA_SIM_EV_NODE_TX_END     // Node frame finished - gateway RxDone/RxError
+};
+
+enum LoRaSimRadioState {
+  LORA_SIM_RADIO_IDLE,        // Sleep or standby
+  LORA_SIM_RADIO_RX,
+  LORA_SIM_RADIO_TX,
+  LORA_SIM_RADIO_CAD
+};
+
+struct LoRaSimEvent {
+  bool used;
+  uint8_t kind;
+  uint8_t node;
+  uint8_t air;                // NODE_TX_END: index into the air table
+  uint8_t channel;            // NODE_TX: where to transmit
+  uint8_t sf;
+  uint8_t len;
+  unsigned long at;
+  uint8_t data[LORA_SIM_FRAME_LEN];
+};
+
+// One transmission on air
+struct LoRaSimAir {
+  bool used;
+  bool gateway;
+  uint8_t node;
+  uint8_t channel;
+  uint8_t sf;
+  int16_t rssi;               // At the gateway (node frames)
+  unsigned long start;
+  unsigned long end;
+  bool collided;              // Overlapped by a frame it doesn't survive
+  uint32_t rxSession;         // Gateway RX session the frame began in, 0 = not listening
+};
+
+struct LoRaSimNode {
+  uint16_t distanceM;
+  int8_t shadowDb;
+  uint8_t channel;            // Where it listens and answers
+  uint8_t sf;
+  bool valveOpen;
+  uint16_t seq;               // Uplink sequence number
+  uint32_t lastMid;           // Last command applied (retransmissions are only re-acked)
+  unsigned long nextStatAt;
+  unsigned long autoCloseAt;  // 0 = no OPEN timer running
+  unsigned long txUntil;      // Deaf while its own frame is on air
+};
+
+struct LoRaSimStats {
+  uint32_t gwFrames;
+  uint32_t gwAirMs;
+  uint32_t cmdFrames;         // Unicast and group command frames
+  uint32_t retransmissions;   // Command frames repeating a recent MID
+  uint32_t nodeFrames;
+  uint32_t nodeAirMs;
+  uint32_t delivered;         // Node frames the gateway received
+  uint32_t collisions;        // Node frames lost to overlap
+  uint32_t weak;              // Node frames below the SNR floor
+  uint32_t deaf;              // Node frames the gateway wasn't listening for
+  uint32_t downHeard;         // Command deliveries decoded by their node
+  uint32_t downLost;          // Command deliveries their node missed
+  uint32_t stats;             // STAT uplinks sent
+  uint32_t autoCloses;
+  uint32_t opens;             // Distinct OPENs applied by nodes
+  uint32_t overflows;         // Events or transmissions dropped by full tables
+};
+
+class LoRaSim {
+private:
+  RadioEvents_t *events;
+  int nodeCount;
+  uint32_t rng;
+
+  LoRaSimRadioState state;
+  uint8_t gwChannel;
+  uint8_t gwSf;
+  uint32_t rxSession;         // Bumped whenever the gateway stops listening or retunes
+  uint8_t gwFrame[LORA_BUFFER_SIZE];
+  uint16_t gwLen;
+  int gwAir;
+  uint32_t recentMids[LORA_SIM_MID_HISTORY];
+  uint8_t recentPos;
+
+  LoRaSimNode *nodes;         // nodeCount + 1 entries
+  LoRaSimEvent *queue;        // queueCap entries
+  int queueCap;
+  LoRaSimAir air[LORA_SIM_MAX_AIR];
+  LoRaSimStats stats;
+
+  uint32_t random32();
+  int randomRange(int lo, int hi);
+  LoRaSimEvent* schedule(uint8_t kind, uint8_t node, unsigned long at);
+  void scheduleTx(uint8_t node, const uint8_t *data, size_t len, uint8_t channel, uint8_t sf,
+                  unsigned long at);
+  int addAir(bool gateway, uint8_t node, uint8_t channel, uint8_t sf, int16_t rssi,
+             unsigned long start, unsigned long end);
+  int16_t linkRssi(uint8_t node);
+  static int requiredSnr(uint8_t sf);
+  void setState(LoRaSimRadioState next);
+  void runEvent(LoRaSimEvent &e);
+  void nodeTxStart(LoRaSimEvent &e);
+  void nodeTxEnd(LoRaSimEvent &e);
+  void gatewayTxEnd(unsigned long at);
+  bool nodeHears(uint8_t node, const LoRaSimAir &a);
+  void nodeCommand(const uint8_t *data, uint16_t len, const LoRaSimAir &a, unsigned long at);
+  void nodeGroup(const uint8_t *data, uint16_t len, const LoRaSimAir &a, unsigned long at);
+  bool applyOp(uint8_t node, uint32_t mid, uint8_t op, uint32_t durationMs, unsigned long at);
+  bool serviceNodes(unsigned long now);
+  void noteCommandMid(uint32_t mid);
+
+public:
+  LoRaSim();
+  ~LoRaSim();
+  bool begin(int count, uint32_t rangeMeters, uint32_t seed);
+  unsigned long nextEventAt(unsigned long now);
+  const LoRaSimStats& getStats();
+  int getNodeCount();
+
+  // Radio driver - the Radio table in LoRaSim.cpp calls these
+  void init(RadioEvents_t *radioEvents);
+  void setChannel(uint32_t freq);
+  void setSf(uint8_t sf);
+  void send(const uint8_t *frame, uint16_t len);
+  void rx();
+  void standby();
+  void startCad();
+  void process();
+};
+
+extern LoRaSim loraSim;
+
+#endif
\ No newline at end of file
@@ -0,0 +1,198 @@
+// Arduino.h - Just enough of the Arduino core to build the gateway's LoRa
+// and schedule code on a PC. millis() and time() read the simulator's
+// virtual clock, micros() the host's; Serial output is shown only with -v.
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <map>
+#include <type_traits>
+
+using std::min;
+using std::max;
+
+typedef uint8_t byte;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define Vext 36
+#define IRAM_ATTR
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+// ========== Virtual Clock ==========
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);              // Advances the virtual clock
+void delayMicroseconds(unsigned int us);
+void hostSetMillis(unsigned long ms);
+time_t hostTime(time_t *t);
+#define time(t) hostTime(t)                // Wall clock that follows millis()
+
+// ========== Pins and Randomness ==========
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int value);
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+uint32_t esp_random();
+
+// ========== String ==========
+class String {
+private:
+  std::string s;
+
+public:
+  String() {}
+  String(const char *c) : s(c != nullptr ? c : "") {}
+  String(const std::string &str) : s(str) {}
+  explicit String(char c) : s(1, c) {}
+  explicit String(unsigned char v, unsigned char base = 10) { setNumber(v, base); }
+  explicit String(int v, unsigned char base = 10) { setNumber(v, base); }
+  explicit String(unsigned int v, unsigned char base = 10) { setNumber(v, base); }
+  explicit String(long v, unsigned char base = 10) { setNumber(v, base); }
+  explicit String(unsigned long v, unsigned char base = 10) { setNumber(v, base); }
+  explicit String(long long v, unsigned char base = 10) { setNumber(v, base); }
+  explicit String(unsigned long long v, unsigned char base = 10) { setNumber(v, base); }
+  explicit String(float v, unsigned char decimals = 2) { setFloat(v, decimals); }
+  explicit String(double v, unsigned char decimals = 2) { setFloat(v, decimals); }
+
+  unsigned int length() const { return s.size(); }
+  const char* c_str() const { return s.c_str(); }
+  void reserve(unsigned int size) { s.reserve(size); }
+
+  char charAt(unsigned int i) const { return i < s.size() ? s[i] : 0; }
+  char operator[](unsigned int i) const { return i < s.size() ? s[i] : 0; }
+  char& operator[](unsigned int i) { return s[i]; }
+
+  int indexOf(char c, unsigned int from = 0) const { return found(s.find(c, from)); }
+  int indexOf(const String &str, unsigned int from = 0) const { return found(s.find(str.s, from)); }
+  int lastIndexOf(char c) const { return found(s.rfind(c)); }
+  int lastIndexOf(char c, unsigned int from) const { return found(s.rfind(c, from)); }
+  int lastIndexOf(const String &str) const { return found(s.rfind(str.s)); }
+  String substring(unsigned int from) const { return from >= s.size() ? String() : String(s.substr(from)); }
+  String substring(unsigned int from, unsigned int to) const {
+    if (from > to) std::swap(from, to);
+    if (from >= s.size()) return String();
+    return String(s.substr(from, to - from));
+  }
+
+  bool startsWith(const String &prefix) const { return s.compare(0, prefix.s.size(), prefix.s) == 0; }
+  bool endsWith(const String &suffix) const {
+    return s.size() >= suffix.s.size() && s.compare(s.size() - suffix.s.size(), suffix.s.size(), suffix.s) == 0;
+  }
+  bool equals(const String &o) const { return s == o.s; }
+  bool equalsIgnoreCase(const String &o) const {
+    if (s.size() != o.s.size()) return false;
+    for (size_t i = 0; i < s.size(); i++) {
+      if (tolower((unsigned char)s[i]) != tolower((unsigned char)o.s[i])) return false;
+    }
+    return true;
+  }
+  int compareTo(const String &o) const { return s.compare(o.s); }
+
+  void trim() {
+    size_t b = 0, e = s.size();
+    while (b < e && isspace((unsigned char)s[b])) b++;
+    while (e > b && isspace((unsigned char)s[e - 1])) e--;
+    s = s.substr(b, e - b);
+  }
+  void toUpperCase() { for (auto &c : s) c = toupper((unsigned char)c); }
+  void toLowerCase() { for (auto &c : s) c = tolower((unsigned char)c); }
+  void replace(const String &from, const String &to) {
+    if (from.s.empty()) return;
+    for (size_t p = s.find(from.s); p != std::string::npos; p = s.find(from.s, p + to.s.size())) {
+      s.replace(p, from.s.size(), to.s);
+    }
+  }
+  void remove(unsigned int index) { if (index < s.size()) s.erase(index); }
+  void remove(unsigned int index, unsigned int count) { if (index < s.size()) s.erase(index, count); }
+
+  long toInt() const { return atol(s.c_str()); }
+  float toFloat() const { return (float)atof(s.c_str()); }
+  void getBytes(unsigned char *buf, unsigned int size) const { toCharArray((char *)buf, size); }
+  void toCharArray(char *buf, unsigned int size) const {
+    if (size == 0) return;
+    size_t n = std::min((size_t)size - 1, s.size());
+    memcpy(buf, s.data(), n);
+    buf[n] = '\0';
+  }
+
+  bool concat(const String &o) { s += o.s; return true; }
+  bool concat(const char *c) { s += c; return true; }
+  bool concat(char c) { s += c; return true; }
+  bool concat(const char *c, unsigned int n) { s.append(c, n); return true; }
+  String& operator+=(const String &o) { s += o.s; return *this; }
+  String& operator+=(const char *c) { s += c; return *this; }
+  String& operator+=(char c) { s += c; return *this; }
+  template <typename T, typename std::enable_if<std::is_arithmetic<T>::value, int>::type = 0>
+  String& operator+=(T v) { return *this += String(v); }
+
+  bool operator==(const String &o) const { return s == o.s; }
+  bool operator!=(const String &o) const { return s != o.s; }
+  bool operator==(const char *c) const { return s == c; }
+  bool operator!=(const char *c) const { return s != c; }
+  bool operator<(const String &o) const { return s < o.s; }
+  bool operator>(const String &o) const { return s > o.s; }
+
+private:
+  static int found(size_t pos) { return pos == std::string::npos ? -1 : (int)pos; }
+  template <typename T> void setNumber(T v, unsigned char base) {
+    if (base == 10) {
+      s = std::to_string(v);
+      return;
+    }
+    unsigned long long u = (unsigned long long)v;
+    if (std::is_signed<T>::value && v < 0) u = (unsigned long long)(typename std::make_unsigned<T>::type)v;
+    const char *digits = "0123456789abcdef";
+    do {
+      s.insert(s.begin(), digits[u % base]);
+      u /= base;
+    } while (u > 0);
+  }
+  void setFloat(double v, unsigned char decimals) {
+    char buf[48];
+    snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+    s = buf;
+  }
+};
+
+inline String operator+(const String &a, const String &b) { String r(a); r += b; return r; }
+inline String operator+(const String &a, const char *b) { String r(a); r += b; return r; }
+inline String operator+(const char *a, const String &b) { String r(a); r += b; return r; }
+inline String operator+(const String &a, char b) { String r(a); r += b; return r; }
+template <typename T, typename std::enable_if<std::is_arithmetic<T>::value, int>::type = 0>
+inline String operator+(const String &a, T b) { String r(a); r += b; return r; }
+
+// ========== Serial ==========
+class HardwareSerial {
+public:
+  HardwareSerial(int) {}
+  void begin(unsigned long, int = 0, int = -1, int = -1) {}
+  int available() { return 0; }
+  int read() { return -1; }
+  size_t write(const uint8_t *data, size_t len);
+  size_t print(const String &s) { return write((const uint8_t *)s.c_str(), s.length()); }
+  size_t print(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+  template <typename T> size_t print(T v) { return print(String(v)); }
+  size_t println() { return print("\n"); }
+  template <typename T> size_t println(T v) { return print(v) + println(); }
+  size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+  void flush() {}
+};
+
+extern HardwareSerial Serial;
+extern bool hostVerbose;          // Echo the firmware's Serial output
+
+#endif
\ No newline at end of file
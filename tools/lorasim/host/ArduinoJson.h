@@ -0,0 +1,5 @@
+// ArduinoJson.h - Included by StorageManager.h; the simulator never parses JSON
+#ifndef HOST_ARDUINOJSON_H
+#define HOST_ARDUINOJSON_H
+
+#endif
\ No newline at end of file
@@ -0,0 +1,151 @@
+// Host.cpp - Arduino core on the simulator's virtual clock
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <LoRaWan_APP.h>
+
+HardwareSerial Serial(0);
+FS LittleFS;
+McuClass Mcu;
+bool hostVerbose = false;
+String hostFsRoot;
+
+static unsigned long nowMs = 0;
+static bool lineStart = true;
+static uint32_t rng = 1;
+static const time_t epochAtZero = 1767225600;  // 2026-01-01 00:00 UTC
+
+// ========== Virtual Clock ==========
+unsigned long millis() {
+  return nowMs;
+}
+
+// The host's own clock, so REPLAY times real work
+unsigned long micros() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long)ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+}
+
+void delay(unsigned long ms) {
+  nowMs += ms;
+}
+
+void delayMicroseconds(unsigned int us) {}
+
+void hostSetMillis(unsigned long ms) {
+  nowMs = ms;
+}
+
+#undef time
+time_t hostTime(time_t *t) {
+  time_t now = epochAtZero + (time_t)(nowMs / 1000);
+  if (t != nullptr) *t = now;
+  return now;
+}
+
+// ========== Pins and Randomness ==========
+void pinMode(int pin, int mode) {}
+void digitalWrite(int pin, int value) {}
+
+// xorshift32, so a run repeats exactly for the same seed
+uint32_t esp_random() {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+void randomSeed(unsigned long seed) {
+  rng = seed != 0 ? (uint32_t)seed : 1;
+}
+
+long random(long max) {
+  return max > 0 ? (long)(esp_random() % (uint32_t)max) : 0;
+}
+
+long random(long min, long max) {
+  return max > min ? min + random(max - min) : min;
+}
+
+// ========== Serial ==========
+// Each line gets the virtual time, e.g. "  123.456 [LoRa] TX Done"
+size_t HardwareSerial::write(const uint8_t *data, size_t len) {
+  if (!hostVerbose) return len;
+  for (size_t i = 0; i < len; i++) {
+    if (lineStart) fprintf(stdout, "%9lu.%03lu ", nowMs / 1000, nowMs % 1000);
+    fputc(data[i], stdout);
+    lineStart = data[i] == '\n';
+  }
+  return len;
+}
+
+size_t HardwareSerial::printf(const char *fmt, ...) {
+  char buf[512];
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+  if (n < 0) return 0;
+  return write((const uint8_t *)buf, std::min((size_t)n, sizeof(buf) - 1));
+}
+
+// ========== LittleFS ==========
+static std::string hostPath(const String &path) {
+  return std::string(hostFsRoot.c_str()) + path.c_str();
+}
+
+bool FS::exists(const String &path) {
+  if (hostFsRoot.length() == 0) return false;
+  FILE *f = fopen(hostPath(path).c_str(), "rb");
+  if (f != nullptr) fclose(f);
+  return f != nullptr;
+}
+
+File FS::open(const String &path, const char *mode) {
+  if (hostFsRoot.length() == 0) return File();
+  const char *m = mode[0] == 'w' ? "wb" : (mode[0] == 'a' ? "ab" : "rb");
+  return File(fopen(hostPath(path).c_str(), m));
+}
+
+bool FS::remove(const String &path) {
+  return hostFsRoot.length() > 0 && ::remove(hostPath(path).c_str()) == 0;
+}
+
+int File::read() {
+  uint8_t b;
+  return read(&b, 1) == 1 ? b : -1;
+}
+
+int File::available() {
+  if (fp == nullptr) return 0;
+  long pos = ftell(fp);
+  fseek(fp, 0, SEEK_END);
+  long end = ftell(fp);
+  fseek(fp, pos, SEEK_SET);
+  return (int)(end - pos);
+}
+
+size_t File::size() {
+  if (fp == nullptr) return 0;
+  long pos = ftell(fp);
+  fseek(fp, 0, SEEK_END);
+  long end = ftell(fp);
+  fseek(fp, pos, SEEK_SET);
+  return (size_t)end;
+}
+
+String File::readStringUntil(char end) {
+  String out;
+  for (int c = read(); c >= 0 && c != end; c = read()) out += (char)c;
+  return out;
+}
+
+size_t File::printf(const char *fmt, ...) {
+  char buf[256];
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+  if (n < 0) return 0;
+  return write((const uint8_t *)buf, std::min((size_t)n, sizeof(buf) - 1));
+}
\ No newline at end of file
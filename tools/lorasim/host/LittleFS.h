@@ -0,0 +1,48 @@
+// LittleFS.h - Flash filesystem mapped onto a host directory. With no
+// directory set (hostFsRoot empty) every open fails, as on an unformatted
+// flash.
+#ifndef HOST_LITTLEFS_H
+#define HOST_LITTLEFS_H
+
+#include <Arduino.h>
+
+class File {
+private:
+  FILE *fp;
+
+public:
+  File(FILE *f = nullptr) : fp(f) {}
+  operator bool() const { return fp != nullptr; }
+  size_t write(const uint8_t *data, size_t len) { return fp ? fwrite(data, 1, len, fp) : 0; }
+  size_t write(uint8_t b) { return write(&b, 1); }
+  size_t read(uint8_t *buf, size_t len) { return fp ? fread(buf, 1, len, fp) : 0; }
+  int read();
+  int available();
+  size_t size();
+  bool seek(uint32_t pos) { return fp && fseek(fp, pos, SEEK_SET) == 0; }
+  size_t position() { return fp ? (size_t)ftell(fp) : 0; }
+  String readStringUntil(char end);
+  size_t print(const String &s) { return write((const uint8_t *)s.c_str(), s.length()); }
+  size_t println(const String &s) { return print(s) + write('\n'); }
+  size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+  void flush() { if (fp) fflush(fp); }
+  void close() {
+    if (fp) fclose(fp);
+    fp = nullptr;
+  }
+};
+
+class FS {
+public:
+  bool begin(bool formatOnFail = false) { return true; }
+  bool exists(const String &path);
+  File open(const String &path, const char *mode = "r");
+  bool remove(const String &path);
+  size_t totalBytes() { return 0; }
+  size_t usedBytes() { return 0; }
+};
+
+extern FS LittleFS;
+extern String hostFsRoot;
+
+#endif
\ No newline at end of file
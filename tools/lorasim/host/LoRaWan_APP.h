@@ -0,0 +1,51 @@
+// LoRaWan_APP.h - The part of Heltec's SX1262 driver LoRaComm uses. The
+// simulator implements Radio (LoRaSim.cpp): frames go to virtual nodes and
+// their replies come back through the RadioEvents callbacks from
+// Radio.IrqProcess(), as the real driver delivers its interrupts.
+#ifndef HOST_LORAWAN_APP_H
+#define HOST_LORAWAN_APP_H
+
+#include <Arduino.h>
+
+typedef enum { MODEM_FSK = 0, MODEM_LORA } RadioModems_t;
+
+typedef struct {
+  void (*TxDone)(void);
+  void (*TxTimeout)(void);
+  void (*RxDone)(uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr);
+  void (*RxTimeout)(void);
+  void (*RxError)(void);
+  void (*FhssChangeChannel)(uint8_t currentChannel);
+  void (*CadDone)(bool channelActivityDetected);
+} RadioEvents_t;
+
+struct Radio_s {
+  void (*Init)(RadioEvents_t *events);
+  void (*SetChannel)(uint32_t freq);
+  void (*SetRxConfig)(RadioModems_t modem, uint32_t bandwidth, uint32_t datarate,
+                      uint8_t coderate, uint32_t bandwidthAfc, uint16_t preambleLen,
+                      uint16_t symbTimeout, bool fixLen, uint8_t payloadLen, bool crcOn,
+                      bool freqHopOn, uint8_t hopPeriod, bool iqInverted, bool rxContinuous);
+  void (*SetTxConfig)(RadioModems_t modem, int8_t power, uint32_t fdev, uint32_t bandwidth,
+                      uint32_t datarate, uint8_t coderate, uint16_t preambleLen, bool fixLen,
+                      bool crcOn, bool freqHopOn, uint8_t hopPeriod, bool iqInverted,
+                      uint32_t timeout);
+  void (*Send)(uint8_t *buffer, uint8_t size);
+  void (*Sleep)(void);
+  void (*Standby)(void);
+  void (*Rx)(uint32_t timeout);
+  void (*StartCad)(void);
+  void (*IrqProcess)(void);
+};
+
+extern const struct Radio_s Radio;
+
+struct McuClass {
+  void begin(int board, int clockType) {}
+};
+extern McuClass Mcu;
+
+#define HELTEC_BOARD 0
+#define SLOW_CLK_TPYE 0
+
+#endif
\ No newline at end of file
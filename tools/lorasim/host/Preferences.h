@@ -0,0 +1,37 @@
+// Preferences.h - NVS in memory, empty at start
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+#include <Arduino.h>
+
+class Preferences {
+private:
+  std::map<std::string, std::string> values;
+
+  String get(const char *key, const String &def) {
+    auto it = values.find(key);
+    return it == values.end() ? def : String(it->second);
+  }
+  size_t put(const char *key, const String &v) {
+    values[key] = v.c_str();
+    return v.length();
+  }
+
+public:
+  bool begin(const char *name, bool readOnly = false) { return true; }
+  void end() {}
+  bool isKey(const char *key) { return values.count(key) > 0; }
+  bool remove(const char *key) { return values.erase(key) > 0; }
+  String getString(const char *key, const String &def = String()) { return get(key, def); }
+  size_t putString(const char *key, const String &v) { return put(key, v); }
+  int32_t getInt(const char *key, int32_t def = 0) { return isKey(key) ? get(key, "").toInt() : def; }
+  size_t putInt(const char *key, int32_t v) { return put(key, String((long)v)); }
+  uint32_t getUInt(const char *key, uint32_t def = 0) { return isKey(key) ? strtoul(get(key, "").c_str(), nullptr, 10) : def; }
+  size_t putUInt(const char *key, uint32_t v) { return put(key, String((unsigned long)v)); }
+  uint8_t getUChar(const char *key, uint8_t def = 0) { return (uint8_t)getUInt(key, def); }
+  size_t putUChar(const char *key, uint8_t v) { return putUInt(key, v); }
+  bool getBool(const char *key, bool def = false) { return getUInt(key, def) != 0; }
+  size_t putBool(const char *key, bool v) { return putUInt(key, v); }
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,7 @@
+// heltec.h - Nothing from the board support is needed on the host
+#ifndef HOST_HELTEC_H
+#define HOST_HELTEC_H
+
+#include <Arduino.h>
+
+#endif
\ No newline at end of file
@@ -0,0 +1,272 @@
+// main.cpp - lorasim: the gateway's LoRa and schedule code against a
+// simulated network, on a virtual clock
+//
+//   lorasim <nodes> [-s stepSec] [-r rangeM] [-S seed] [-t tickMs] [-C capture] [-v]
+//   lorasim -R <capture> [-v]
+//
+// Nodes send a first STAT during a warm-up, then one schedule step per node
+// runs through ScheduleManager the way a due schedule would. The clock
+// moves to the simulator's next event, at most tickMs at a time so the
+// gateway's own deadlines are polled as often as its loop() would. A run of
+// hours takes seconds and repeats exactly for the same seed.
+//
+// -C records the run with the gateway's CAPTURE FILE. -R replays a capture: the gateway's CAPTURE FILE output, or a
+// console log holding its "CAP|<hex>" lines. Every frame goes through
+// LoRaComm's RX path and what it queues through NodeRegistry, timed with
+// the host's real clock.
+#include "LoRaSim.h"
+#include "LoRaComm.h"
+#include "MessageQueue.h"
+#include "StorageManager.h"
+#include "ScheduleManager.h"
+#include "NodeRegistry.h"
+#include <unistd.h>
+#include <sys/stat.h>
+
+// ========== Gateway Globals (the .ino's on the device) ==========
+SystemConfig sysConfig;
+std::vector<Schedule> schedules;
+String currentScheduleId = "";
+std::vector<SeqStep> seq;
+int currentStepIndex = -1;
+unsigned long stepStartMillis = 0;
+bool scheduleLoaded = false;
+bool scheduleRunning = false;
+time_t scheduleStartEpoch = 0;
+uint32_t pumpOnBeforeMs = PUMP_ON_LEAD_DEFAULT_MS;
+uint32_t pumpOffAfterMs = PUMP_OFF_DELAY_DEFAULT_MS;
+uint32_t LAST_CLOSE_DELAY_MS = LAST_CLOSE_DELAY_MS_DEFAULT;
+uint32_t DRIFT_THRESHOLD_S = 300;
+uint32_t SYNC_CHECK_INTERVAL_MS = 3600000UL;
+bool ENABLE_SMS_BROADCAST = true;
+
+Preferences prefs;
+MessageQueue incomingQueue;
+StorageManager storage;
+LoRaComm loraComm;
+ScheduleManager scheduleMgr;
+NodeRegistry nodeRegistry;
+LoRaSim loraSim;
+
+static uint32_t statusEvents = 0;
+static uint32_t queueMessages = 0;
+
+void publishStatus(const String &msg) {
+  Serial.println("[Status] " + msg);
+  statusEvents++;
+}
+
+void sendSMSNotification(const String &message, const String &alertKey) {
+  Serial.println("[SMS] Not sent: " + message);
+}
+
+// Schedules come from the scenario, never from JSON or flash
+StorageManager::StorageManager() {}
+
+Schedule StorageManager::scheduleFromJson(const String &json) {
+  return Schedule();
+}
+
+bool StorageManager::saveSchedule(const Schedule &s) {
+  return false;
+}
+
+// ========== Gateway Loop ==========
+// Node messages, as the .ino's loop() hands them on
+static void consumeMessage(const String &msg, void *ctx) {
+  queueMessages++;
+  nodeRegistry.handleMessage(msg);
+}
+
+// The LoRa part of the .ino's loop(): radio events, one queued uplink per
+// pass into the registry, health polling, the schedule phase machine
+static void gatewayLoop() {
+  loraComm.processIncoming();
+  nodeRegistry.loop();
+
+  String msg;
+  if (incomingQueue.dequeue(msg)) consumeMessage(msg, nullptr);
+
+  scheduleMgr.runLoop();
+}
+
+// One step per node, loaded the way the trigger check loads a due schedule
+static void loadSchedule(int nodeCount, uint32_t stepMs) {
+  seq.clear();
+  for (int n = 1; n <= nodeCount; n++) {
+    SeqStep st;
+    st.node_id = (uint8_t)n;
+    st.valve_id = 1;
+    st.duration_ms = stepMs;
+    seq.push_back(st);
+  }
+  currentScheduleId = "SIM";
+  pumpOnBeforeMs = PUMP_ON_LEAD_DEFAULT_MS;
+  pumpOffAfterMs = PUMP_OFF_DELAY_DEFAULT_MS;
+  scheduleStartEpoch = time(nullptr);
+  currentStepIndex = -1;
+  scheduleLoaded = true;
+}
+
+static String report(const char *outcome, unsigned long scheduleStartedAt) {
+  const LoRaSimStats &stats = loraSim.getStats();
+  unsigned long now = millis();
+  int nodeCount = loraSim.getNodeCount();
+
+  String out = String(outcome) + " nodes=" + String(nodeCount) +
+               " opened=" + String(stats.opens) + "/" + String(nodeCount);
+  if (scheduleStartedAt != 0) out += " schedule=" + String((now - scheduleStartedAt) / 1000) + "s";
+  out += " cmds=" + String(stats.cmdFrames) + " retx=" + String(stats.retransmissions) +
+         " down=" + String(stats.downHeard) + "/" + String(stats.downHeard + stats.downLost) +
+         " up=" + String(stats.delivered) + "/" + String(stats.nodeFrames) +
+         " coll=" + String(stats.collisions) + " weak=" + String(stats.weak) +
+         " deaf=" + String(stats.deaf) +
+         " air=" + String(stats.gwAirMs / 1000) + "s/" + String(stats.nodeAirMs / 1000) + "s";
+  if (now > 0) out += " duty=" + String(stats.gwAirMs * 100.0f / now, 1) + "%";
+  out += " queue=" + String(queueMessages) + " status=" + String(statusEvents) +
+         " drops ring=" + String(loraComm.rxDropCount()) +
+         " queue=" + String(incomingQueue.droppedCount()) +
+         " table=" + String(loraComm.tableFullCount()) +
+         " sim=" + String(stats.overflows);
+  return out;
+}
+
+static int usage() {
+  fprintf(stderr, "Usage: lorasim <nodes 1-%d> [-s stepSec] [-r rangeM] [-S seed] "
+                  "[-t tickMs] [-C capture] [-v]\n"
+                  "       lorasim -R <capture> [-v]\n", LORA_MAX_NODES - 1);
+  return 2;
+}
+
+// ========== Capture Replay ==========
+// LittleFS lives in a scratch directory for -C and -R
+static bool scratchFs(char *dir) {
+  if (mkdtemp(dir) == nullptr) {
+    perror("lorasim: mkdtemp");
+    return false;
+  }
+  hostFsRoot = dir;
+  return true;
+}
+
+// Loads the capture into the scratch LittleFS - as is, or through
+// importCapture() line by line - and runs the gateway's REPLAY on it
+static int replay(const char *path) {
+  FILE *in = fopen(path, "rb");
+  if (in == nullptr) {
+    fprintf(stderr, "lorasim: cannot open %s\n", path);
+    return 2;
+  }
+  std::vector<uint8_t> data;
+  uint8_t chunk[4096];
+  for (size_t n; (n = fread(chunk, 1, sizeof(chunk), in)) > 0;) {
+    data.insert(data.end(), chunk, chunk + n);
+  }
+  fclose(in);
+
+  char dir[] = "/tmp/lorasim-XXXXXX";
+  if (!scratchFs(dir)) return 2;
+  loraComm.init();
+  nodeRegistry.begin();
+
+  uint32_t imported = 0, rejected = 0;
+  if (!data.empty() && data[0] == LORA_CAP_MAGIC) {
+    File f = LittleFS.open(LORA_CAPTURE_PATH, "w");
+    f.write(data.data(), data.size());
+    f.close();
+  } else {
+    String text(std::string(data.begin(), data.end()));
+    for (int pos = 0; pos < (int)text.length();) {
+      int end = text.indexOf('\n', pos);
+      if (end < 0) end = text.length();
+      String line = text.substring(pos, end);
+      int cap = line.indexOf("CAP|");
+      if (cap >= 0) {
+        line = line.substring(cap + 4);
+        line.trim();
+        if (loraComm.importCapture(line)) imported++;
+        else rejected++;
+      }
+      pos = end + 1;
+    }
+    printf("imported=%u rejected=%u\n", imported, rejected);
+  }
+
+  String result = loraComm.replayCapture(&incomingQueue, consumeMessage, nullptr);
+  printf("%s status=%u\n", result.c_str(), statusEvents);
+
+  LittleFS.remove(LORA_CAPTURE_PATH);
+  rmdir(dir);
+  return result.startsWith("records=") && !result.startsWith("records=0 ") ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+  uint32_t stepSeconds = LORA_SIM_STEP_S;
+  uint32_t rangeMeters = LORA_SIM_RANGE_M;
+  uint32_t seed = 1;
+  uint32_t tickMs = LORA_SIM_TICK_MS;
+  const char *capture = nullptr;
+  const char *record = nullptr;
+  int opt;
+  while ((opt = getopt(argc, argv, "s:r:S:t:C:R:v")) != -1) {
+    switch (opt) {
+      case 'C': record = optarg; break;
+      case 'R': capture = optarg; break;
+      case 's': stepSeconds = strtoul(optarg, nullptr, 10); break;
+      case 'r': rangeMeters = strtoul(optarg, nullptr, 10); break;
+      case 'S': seed = strtoul(optarg, nullptr, 10); break;
+      case 't': tickMs = strtoul(optarg, nullptr, 10); break;
+      case 'v': hostVerbose = true; break;
+      default: return usage();
+    }
+  }
+  if (capture != nullptr) return optind == argc ? replay(capture) : usage();
+  if (optind != argc - 1 || stepSeconds == 0 || tickMs == 0) return usage();
+  int nodeCount = atoi(argv[optind]);
+
+  randomSeed(seed);
+  if (!loraSim.begin(nodeCount, rangeMeters, seed)) return usage();
+  loraComm.init();
+  nodeRegistry.begin();
+  char dir[] = "/tmp/lorasim-XXXXXX";
+  if (record != nullptr && (!scratchFs(dir) || !loraComm.setCapture(LORA_CAPTURE_FILE))) return 2;
+
+  const char *outcome = "timeout";
+  unsigned long scheduleStartedAt = 0;
+  while (millis() < LORA_SIM_TIMEOUT_MS) {
+    gatewayLoop();
+
+    unsigned long now = millis();
+    if (scheduleStartedAt == 0 && now >= LORA_SIM_WARMUP_MS) {
+      loadSchedule(nodeCount, stepSeconds * 1000UL);
+      scheduleStartedAt = now;
+      Serial.printf("[Sim] Schedule SIM loaded: %d steps\n", nodeCount);
+    } else if (scheduleStartedAt != 0 && !scheduleLoaded && !scheduleRunning &&
+               scheduleMgr.getPhase() == PHASE_IDLE) {
+      outcome = loraSim.getStats().opens > 0 ? "done" : "failed";
+      break;
+    }
+
+    unsigned long next = loraSim.nextEventAt(now);
+    if (next - now > tickMs) next = now + tickMs;
+    hostSetMillis(next > now ? next : now + 1);
+  }
+
+  printf("%s\n", report(outcome, scheduleStartedAt).c_str());
+  if (record != nullptr) {
+    printf("capture %s\n", loraComm.captureReport().c_str());
+    loraComm.setCapture(LORA_CAPTURE_OFF);
+    File f = LittleFS.open(LORA_CAPTURE_PATH, "r");
+    FILE *out = fopen(record, "wb");
+    uint8_t chunk[4096];
+    for (size_t n; f && out != nullptr && (n = f.read(chunk, sizeof(chunk))) > 0;) {
+      fwrite(chunk, 1, n, out);
+    }
+    if (out == nullptr) perror("lorasim: saving the capture");
+    else fclose(out);
+    f.close();
+    LittleFS.remove(LORA_CAPTURE_PATH);
+    rmdir(dir);
+  }
+  return strcmp(outcome, "done") == 0 ? 0 : 1;
+}
\ No newline at end of file